@@ -0,0 +1,76 @@
+# Converts compiled SPIR-V binaries into C++ source with constexpr uint32_t arrays
+# and a table for lookup by name (see src/include/EmbeddedShaders.hpp).
+#
+# Usage: cmake -DSPIRV_FILES=<a.spv,b.spv> -DOUTPUT_FILE=<file.cpp> -P EmbedSpirv.cmake
+# Shader name is SPIR-V file name without extension, e.g. Triangle_vert.
+
+if(NOT SPIRV_FILES OR NOT OUTPUT_FILE)
+    message(FATAL_ERROR "SPIRV_FILES and OUTPUT_FILE should be defined")
+endif()
+
+string(REPLACE "," ";" SPIRV_FILES "${SPIRV_FILES}")
+list(SORT SPIRV_FILES)
+
+# CMake regular expressions have no {n} repetition
+set(WORDS_PER_LINE "")
+foreach(INDEX RANGE 1 8)
+    string(APPEND WORDS_PER_LINE "0x[0-9a-f]+u, ")
+endforeach()
+
+set(ARRAYS "")
+set(TABLE "")
+
+foreach(SPIRV_FILE ${SPIRV_FILES})
+    get_filename_component(SHADER_NAME ${SPIRV_FILE} NAME_WE)
+
+    file(READ ${SPIRV_FILE} HEX_CONTENT HEX)
+    string(LENGTH "${HEX_CONTENT}" HEX_LENGTH)
+    math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+    if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SPIRV_FILE} is not a valid SPIR-V binary")
+    endif()
+
+    # SPIR-V words are little endian: bytes aa bb cc dd form word 0xddccbbaa
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${HEX_CONTENT}")
+    string(REGEX REPLACE "(${WORDS_PER_LINE})" "\\1\n        " WORDS "${WORDS}")
+    string(REPLACE " \n" "\n" WORDS "${WORDS}")
+    string(REGEX REPLACE ",\n        $" "," WORDS "${WORDS}")
+    string(REGEX REPLACE ", $" "," WORDS "${WORDS}")
+
+    if(ARRAYS)
+        string(APPEND ARRAYS "\n")
+    endif()
+    string(APPEND ARRAYS
+        "    constexpr uint32_t ${SHADER_NAME}[] =\n"
+        "    {\n"
+        "        ${WORDS}\n"
+        "    };\n")
+    string(APPEND TABLE "    {\"${SHADER_NAME}\", ${SHADER_NAME}, sizeof(${SHADER_NAME})},\n")
+endforeach()
+
+list(LENGTH SPIRV_FILES SHADERS_COUNT)
+
+set(CONTENT
+"// Generated by cmake/EmbedSpirv.cmake, do not edit.
+#include \"EmbeddedShaders.hpp\"
+
+namespace
+{
+${ARRAYS}}
+
+// sorted by name
+const EmbeddedShader EMBEDDED_SHADERS[] =
+{
+${TABLE}};
+
+const size_t EMBEDDED_SHADERS_COUNT = ${SHADERS_COUNT};
+")
+
+# keep timestamp of unchanged output, so dependent objects are not rebuilt
+if(EXISTS ${OUTPUT_FILE})
+    file(READ ${OUTPUT_FILE} OLD_CONTENT)
+    if(OLD_CONTENT STREQUAL CONTENT)
+        return()
+    endif()
+endif()
+file(WRITE ${OUTPUT_FILE} "${CONTENT}")
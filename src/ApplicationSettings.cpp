@@ -0,0 +1,311 @@
+#include "ApplicationSettings.hpp"
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+    // 60 bytes of vertices per triangle are regenerated and uploaded every frame: 240 MB vertex buffer
+    // (dedicated memory block) and as much CPU memory and staging traffic per frame
+    constexpr uint64_t MAX_STREAMED_TRIANGLES = 4 * 1024 * 1024;
+    constexpr uint64_t MAX_STAGING_RING_MB = 4096;
+    constexpr uint64_t MAX_INSTANCES = 64 * 1024 * 1024;
+    // values buffer is bound whole, maxStorageBufferRange is 32 bit. Device limit is checked by ReductionKernel
+    constexpr uint64_t MAX_COMPUTE_ELEMENTS = 0xFFFFFFFFull / sizeof(uint32_t);
+    // state buffers are bound whole, device limit (maxStorageBufferRange) is checked by ParticleSystem
+    constexpr uint64_t MAX_PARTICLES = 64 * 1024 * 1024;
+
+    BenchmarkMode parse_benchmark(const string& value)
+    {
+        if (value == "instancing")
+        {
+            return BenchmarkMode::Instancing;
+        }
+        if (value == "recording")
+        {
+            return BenchmarkMode::Recording;
+        }
+        if (value == "compute")
+        {
+            return BenchmarkMode::Compute;
+        }
+        if (value == "indirect")
+        {
+            return BenchmarkMode::Indirect;
+        }
+        if (value == "pipelines")
+        {
+            return BenchmarkMode::Pipelines;
+        }
+        throw runtime_error("Unknown benchmark '" + value + "'!");
+    }
+
+    PacingPolicy parse_pacing_policy(const string& value)
+    {
+        if (value == "latency")
+        {
+            return PacingPolicy::LowestLatency;
+        }
+        if (value == "power")
+        {
+            return PacingPolicy::LowestPower;
+        }
+        if (value == "vsync")
+        {
+            return PacingPolicy::Vsync;
+        }
+        throw runtime_error("Unknown pacing policy '" + value + "'!");
+    }
+
+    string next_argument(int argc, char** argv, int& index)
+    {
+        if (index + 1 >= argc)
+        {
+            throw runtime_error(string("Missing value for argument ") + argv[index] + "!");
+        }
+        return argv[++index];
+    }
+
+    uint64_t parse_number(const string& argument, const string& value)
+    {
+        try
+        {
+            // stoull accepts "-1" and wraps it around, counts and sizes are never negative
+            if (value.empty() || !isdigit(static_cast<unsigned char>(value[0])))
+            {
+                throw invalid_argument(value);
+            }
+
+            size_t parsed = 0;
+            auto number = stoull(value, &parsed);
+            if (parsed != value.size())
+            {
+                throw invalid_argument(value);
+            }
+            return number;
+        }
+        catch (const logic_error&)
+        {
+            throw runtime_error("Invalid value '" + value + "' for argument " + argument + "!");
+        }
+    }
+}
+
+ApplicationSettings parse_application_settings(int argc, char** argv)
+{
+    ApplicationSettings settings;
+    bool target_fps_set = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string argument = argv[i];
+
+        if (argument == "--frames-in-flight")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value == 0 || value > MAX_FRAMES_IN_FLIGHT)
+            {
+                throw runtime_error("Frames in flight should be in range [1, " + to_string(MAX_FRAMES_IN_FLIGHT) + "]!");
+            }
+            settings.m_frames_in_flight = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--frames")
+        {
+            settings.m_frame_limit = parse_number(argument, next_argument(argc, argv, i));
+        }
+        else if (argument == "--headless")
+        {
+            settings.m_headless = true;
+        }
+        else if (argument == "--pipeline-cache")
+        {
+            settings.m_pipeline_cache_path = next_argument(argc, argv, i);
+        }
+        else if (argument == "--shader-dir")
+        {
+            settings.m_shader_directory = next_argument(argc, argv, i);
+        }
+        else if (argument == "--hot-reload")
+        {
+            settings.m_hot_reload_directory = next_argument(argc, argv, i);
+        }
+        else if (argument == "--hot-reload-output")
+        {
+            settings.m_hot_reload_output_directory = next_argument(argc, argv, i);
+        }
+        else if (argument == "--stream-triangles")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value > MAX_STREAMED_TRIANGLES)
+            {
+                throw runtime_error("Streamed triangles count should not exceed " + to_string(MAX_STREAMED_TRIANGLES) + "!");
+            }
+            settings.m_streamed_triangles = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--staging-ring-mb")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value == 0 || value > MAX_STAGING_RING_MB)
+            {
+                throw runtime_error("Staging ring size should be in range [1, " + to_string(MAX_STAGING_RING_MB) + "] MB!");
+            }
+            settings.m_staging_ring_size = value * 1024 * 1024;
+        }
+        else if (argument == "--instances")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value > MAX_INSTANCES)
+            {
+                throw runtime_error("Instances count should not exceed " + to_string(MAX_INSTANCES) + "!");
+            }
+            settings.m_instances_count = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--recording-threads")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value > MAX_RECORDING_THREADS)
+            {
+                throw runtime_error("Recording threads should be in range [0, " + to_string(MAX_RECORDING_THREADS) + "]!");
+            }
+            settings.m_recording_threads = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--draws")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value == 0 || value > MAX_INSTANCES)
+            {
+                throw runtime_error("Draws count should be in range [1, " + to_string(MAX_INSTANCES) + "]!");
+            }
+            settings.m_draws_count = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--pacing")
+        {
+            settings.m_pacing_policy = parse_pacing_policy(next_argument(argc, argv, i));
+        }
+        else if (argument == "--target-fps")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            settings.m_target_frame_time_ms = value == 0 ? 0.0 : 1000.0 / static_cast<double>(value);
+            target_fps_set = true;
+        }
+        else if (argument == "--benchmark")
+        {
+            settings.m_benchmark = parse_benchmark(next_argument(argc, argv, i));
+        }
+        else if (argument == "--gpu-trace")
+        {
+            settings.m_gpu_trace_path = next_argument(argc, argv, i);
+        }
+        else if (argument == "--startup-report")
+        {
+            settings.m_startup_report_path = next_argument(argc, argv, i);
+        }
+        else if (argument == "--device")
+        {
+            settings.m_device = next_argument(argc, argv, i);
+        }
+        else if (argument == "--no-transfer-queue")
+        {
+            settings.m_transfer_queue = false;
+        }
+        else if (argument == "--no-async-compute")
+        {
+            settings.m_async_compute = false;
+        }
+        else if (argument == "--compute-elements")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value == 0 || value > MAX_COMPUTE_ELEMENTS)
+            {
+                throw runtime_error("Compute elements should be in range [1, " + to_string(MAX_COMPUTE_ELEMENTS) + "]!");
+            }
+            settings.m_compute_elements = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--gpu-driven")
+        {
+            settings.m_gpu_driven = true;
+        }
+        else if (argument == "--particles")
+        {
+            auto value = parse_number(argument, next_argument(argc, argv, i));
+            if (value > MAX_PARTICLES)
+            {
+                throw runtime_error("Particles count should not exceed " + to_string(MAX_PARTICLES) + "!");
+            }
+            settings.m_particles_count = static_cast<uint32_t>(value);
+        }
+        else if (argument == "--animate")
+        {
+            settings.m_animate = true;
+        }
+        else if (argument == "--post-process")
+        {
+            settings.m_post_process = true;
+        }
+        else if (argument == "--serial-init")
+        {
+            settings.m_parallel_init = false;
+        }
+        else
+        {
+            throw runtime_error("Unknown argument " + argument + "!");
+        }
+    }
+
+    if (settings.m_pacing_policy == PacingPolicy::LowestPower && !target_fps_set)
+    {
+        settings.m_target_frame_time_ms = 1000.0 / DEFAULT_POWER_SAVING_FPS;
+    }
+
+    if (!settings.m_hot_reload_directory.empty() && settings.m_benchmark != BenchmarkMode::None)
+    {
+        throw runtime_error("Shader hot reload is not supported by benchmarks!");
+    }
+
+    if (settings.m_headless && settings.m_frame_limit == 0 && settings.m_benchmark == BenchmarkMode::None)
+    {
+        settings.m_frame_limit = DEFAULT_HEADLESS_FRAME_LIMIT;
+    }
+
+    return settings;
+}
+
+void print_application_usage(const string& program_name)
+{
+    cerr << "Usage: " << program_name << " [options]" << endl
+         << "  --frames-in-flight <1.." << MAX_FRAMES_IN_FLIGHT << ">  frames recorded ahead of GPU (default 2)" << endl
+         << "  --frames <count>               exit after given number of frames (default 0 - until closed)" << endl
+         << "  --headless                     render offscreen without window (default " << DEFAULT_HEADLESS_FRAME_LIMIT << " frames)" << endl
+         << "  --pipeline-cache <path>        pipeline cache file (default pipeline_cache.bin, empty - disabled)" << endl
+         << "  --shader-dir <path>            load <shader name>.spv from directory instead of embedded shaders" << endl
+         << "  --hot-reload <path>            recompile GLSL from directory when saved and reload pipelines using it" << endl
+         << "  --hot-reload-output <path>     directory for recompiled SPIR-V (default " << HOT_RELOAD_SHADER_DIRECTORY << ")" << endl
+         << "  --stream-triangles <count>     upload animated triangles every frame (default 0 - static triangle)" << endl
+         << "  --staging-ring-mb <size>       staging ring buffer size in MB (default 16)" << endl
+         << "  --instances <count>            draw triangle instances with one instanced draw (default 0)" << endl
+         << "  --recording-threads <0.." << MAX_RECORDING_THREADS << ">   record draws into secondary command buffers "
+         << "on given threads (default 0 - inline)" << endl
+         << "  --draws <count>                split the scene into given number of draw calls (default 1)" << endl
+         << "  --pacing <latency|power|vsync> present mode and swapchain length policy (default latency)" << endl
+         << "  --target-fps <fps>             throttle frame start (default 0 - off, " << DEFAULT_POWER_SAVING_FPS
+         << " for power policy)" << endl
+         << "  --benchmark instancing         measure fps for 1k..10M instances, --frames per step (default "
+         << DEFAULT_BENCHMARK_FRAMES << ")" << endl
+         << "  --benchmark recording          measure recording time vs recording threads, --draws (default "
+         << DEFAULT_RECORDING_BENCHMARK_DRAWS << ") one instance draws" << endl
+         << "  --gpu-trace <path>             write GPU scope timestamps as Chrome trace JSON" << endl
+         << "  --startup-report <path>        write CPU time of startup stages as JSON" << endl
+         << "  --serial-init                  run initialization stages one by one on the main thread" << endl
+         << "  --device <name|uuid|index>     use given physical device (default VULKAN_DEVICE or the best scored)" << endl
+         << "  --no-transfer-queue            upload static data through the staging ring on graphics queue" << endl
+         << "  --no-async-compute             submit compute work to graphics queue" << endl
+         << "  --benchmark compute            measure reductions/s and frame time with compute on graphics and async queue" << endl
+         << "  --compute-elements <count>     values summed by one reduction of compute benchmark (default 16M)" << endl
+         << "  --particles <count>            simulate particles on GPU and draw them as points (default 0)" << endl
+         << "  --gpu-driven                   cull draw list with compute shader and draw it with indirect draws" << endl
+         << "  --benchmark indirect           measure recording and frame time of direct and indirect draws for 1k..1M objects" << endl
+         << "  --benchmark pipelines          measure creation of 48 pipeline variants and lookup time, stream them as materials" << endl
+         << "  --animate                      move draws and instances with per frame uniforms and per draw push constants" << endl
+         << "  --post-process                 apply vignette in a second subpass, which reads the scene as input attachment" << endl;
+}
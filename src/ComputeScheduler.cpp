@@ -0,0 +1,121 @@
+#include "ComputeScheduler.hpp"
+#include <limits>
+#include <stdexcept>
+
+void ComputeScheduler::create(VkPhysicalDevice gpu, VkDevice device, VkQueue queue, uint32_t queue_family,
+                              uint32_t frames_count, bool is_async)
+{
+    m_device = device;
+    m_queue = queue;
+    m_queue_family = queue_family;
+    m_is_async = is_async;
+    m_frames.resize(frames_count);
+
+    for (auto& frame : m_frames)
+    {
+        VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family;
+        if (vkCreateCommandPool(m_device, &pool_info, nullptr, &frame.m_command_pool) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create compute command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocate_info.commandPool = frame.m_command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_device, &allocate_info, &frame.m_command_buffer) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to allocate compute command buffer!");
+        }
+
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        if (vkCreateFence(m_device, &fence_info, nullptr, &frame.m_fence) != VK_SUCCESS ||
+            vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.m_semaphore) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create compute synchronization objects!");
+        }
+    }
+    m_profiler.create(gpu, device, queue_family, frames_count);
+}
+
+void ComputeScheduler::destroy()
+{
+    m_profiler.destroy();
+    for (const auto& frame : m_frames)
+    {
+        vkDestroySemaphore(m_device, frame.m_semaphore, nullptr);
+        vkDestroyFence(m_device, frame.m_fence, nullptr);
+        vkDestroyCommandPool(m_device, frame.m_command_pool, nullptr);
+    }
+    m_frames.clear();
+}
+
+VkCommandBuffer ComputeScheduler::begin_frame(uint32_t frame_index, uint64_t frame_number)
+{
+    auto& frame = m_frames[frame_index];
+    if (frame.m_submitted)
+    {
+        vkWaitForFences(m_device, 1, &frame.m_fence, VK_TRUE, numeric_limits<uint64_t>::max());
+        vkResetFences(m_device, 1, &frame.m_fence);
+        frame.m_submitted = false;
+    }
+    m_profiler.begin_frame(frame_index, frame_number);
+    vkResetCommandPool(m_device, frame.m_command_pool, 0);
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(frame.m_command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to begin recording compute command buffer!");
+    }
+    m_profiler.reset_queries(frame.m_command_buffer);
+    return frame.m_command_buffer;
+}
+
+VkSemaphore ComputeScheduler::submit(uint32_t frame_index, bool signal, VkSemaphore wait_semaphore, VkPipelineStageFlags wait_stage)
+{
+    auto& frame = m_frames[frame_index];
+    if (vkEndCommandBuffer(frame.m_command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to record compute command buffer!");
+    }
+
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame.m_command_buffer;
+    if (wait_semaphore != VK_NULL_HANDLE)
+    {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &wait_semaphore;
+        submit_info.pWaitDstStageMask = &wait_stage;
+    }
+    // semaphore of the slot was waited by graphics frame, which used the slot before, so it is unsignaled
+    if (signal)
+    {
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &frame.m_semaphore;
+    }
+
+    if (vkQueueSubmit(m_queue, 1, &submit_info, frame.m_fence) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to submit compute command buffer!");
+    }
+    frame.m_submitted = true;
+    return signal ? frame.m_semaphore : VK_NULL_HANDLE;
+}
+
+void ComputeScheduler::wait_idle()
+{
+    for (auto& frame : m_frames)
+    {
+        if (frame.m_submitted)
+        {
+            vkWaitForFences(m_device, 1, &frame.m_fence, VK_TRUE, numeric_limits<uint64_t>::max());
+            vkResetFences(m_device, 1, &frame.m_fence);
+            frame.m_submitted = false;
+        }
+    }
+}
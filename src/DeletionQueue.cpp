@@ -0,0 +1,28 @@
+#include "DeletionQueue.hpp"
+#include <utility>
+
+void DeletionQueue::push(uint64_t last_use_frame, function<void()> deleter)
+{
+    m_deleters.push_back({last_use_frame, move(deleter)});
+}
+
+void DeletionQueue::retire(uint64_t completed_frame)
+{
+    // frames are pushed in increasing order, so retired deleters are at the front
+    while (!m_deleters.empty() && m_deleters.front().m_frame <= completed_frame)
+    {
+        auto deleter = move(m_deleters.front().m_deleter);
+        m_deleters.pop_front();
+        deleter();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    while (!m_deleters.empty())
+    {
+        auto deleter = move(m_deleters.front().m_deleter);
+        m_deleters.pop_front();
+        deleter();
+    }
+}
@@ -0,0 +1,339 @@
+#include "DescriptorAllocator.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include "utils.hpp"
+
+namespace
+{
+    // descriptors of every type per set in a pool, sets of this application use only a few buffers
+    const VkDescriptorPoolSize POOL_RATIOS[] =
+    {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1}
+    };
+}
+
+void DescriptorPoolAllocator::create(VkDevice device)
+{
+    m_device = device;
+}
+
+void DescriptorPoolAllocator::destroy()
+{
+    for (auto pool : m_used_pools)
+    {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+    for (auto pool : m_free_pools)
+    {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+    m_used_pools.clear();
+    m_free_pools.clear();
+    m_current = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet DescriptorPoolAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (m_current != VK_NULL_HANDLE)
+    {
+        allocate_info.descriptorPool = m_current;
+        VkResult result = vkAllocateDescriptorSets(m_device, &allocate_info, &set);
+        if (result == VK_SUCCESS)
+        {
+            ++m_allocated_sets;
+            return set;
+        }
+        // Vulkan 1.0 drivers without VK_KHR_maintenance1 may report full pool as any error
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL &&
+            result != VK_ERROR_OUT_OF_HOST_MEMORY && result != VK_ERROR_OUT_OF_DEVICE_MEMORY)
+        {
+            throw runtime_error("Failed to allocate descriptor set!");
+        }
+    }
+
+    m_current = take_pool();
+    allocate_info.descriptorPool = m_current;
+    if (vkAllocateDescriptorSets(m_device, &allocate_info, &set) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to allocate descriptor set from a new pool!");
+    }
+    ++m_allocated_sets;
+    return set;
+}
+
+void DescriptorPoolAllocator::reset()
+{
+    for (auto pool : m_used_pools)
+    {
+        vkResetDescriptorPool(m_device, pool, 0);
+        m_free_pools.push_back(pool);
+    }
+    m_used_pools.clear();
+    m_current = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorPoolAllocator::take_pool()
+{
+    VkDescriptorPool pool;
+    if (!m_free_pools.empty())
+    {
+        pool = m_free_pools.back();
+        m_free_pools.pop_back();
+    }
+    else
+    {
+        pool = create_pool(m_next_pool_sets);
+        m_next_pool_sets = min(m_next_pool_sets * 2, MAX_SETS_PER_POOL);
+    }
+    m_used_pools.push_back(pool);
+    return pool;
+}
+
+VkDescriptorPool DescriptorPoolAllocator::create_pool(uint32_t sets_count)
+{
+    vector<VkDescriptorPoolSize> sizes;
+    for (const auto& ratio : POOL_RATIOS)
+    {
+        sizes.push_back({ratio.type, ratio.descriptorCount * sets_count});
+    }
+
+    VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.maxSets = sets_count;
+    pool_info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    pool_info.pPoolSizes = sizes.data();
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(m_device, &pool_info, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create descriptor pool!");
+    }
+    return pool;
+}
+
+bool DescriptorAllocator::LayoutKey::operator==(const LayoutKey& other) const
+{
+    return equal(m_bindings.begin(), m_bindings.end(), other.m_bindings.begin(), other.m_bindings.end(),
+                 [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+                 {
+                     return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+                            a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags &&
+                            a.pImmutableSamplers == b.pImmutableSamplers;
+                 });
+}
+
+size_t DescriptorAllocator::LayoutKeyHash::operator()(const LayoutKey& key) const
+{
+    size_t seed = key.m_bindings.size();
+    for (const auto& binding : key.m_bindings)
+    {
+        hash_combine(seed, binding.binding);
+        hash_combine(seed, binding.descriptorType);
+        hash_combine(seed, binding.descriptorCount);
+        hash_combine(seed, binding.stageFlags);
+    }
+    return seed;
+}
+
+bool DescriptorAllocator::SetKey::operator==(const SetKey& other) const
+{
+    return m_layout == other.m_layout &&
+           equal(m_bindings.begin(), m_bindings.end(), other.m_bindings.begin(), other.m_bindings.end(),
+                 [](const BufferBinding& a, const BufferBinding& b)
+                 {
+                     return a.m_binding == b.m_binding && a.m_type == b.m_type && a.m_info.buffer == b.m_info.buffer &&
+                            a.m_info.offset == b.m_info.offset && a.m_info.range == b.m_info.range;
+                 });
+}
+
+size_t DescriptorAllocator::SetKeyHash::operator()(const SetKey& key) const
+{
+    size_t seed = hash<VkDescriptorSetLayout>()(key.m_layout);
+    for (const auto& binding : key.m_bindings)
+    {
+        hash_combine(seed, binding.m_binding);
+        hash_combine(seed, hash<VkBuffer>()(binding.m_info.buffer));
+        hash_combine(seed, binding.m_info.offset);
+        hash_combine(seed, binding.m_info.range);
+    }
+    return seed;
+}
+
+void DescriptorAllocator::create(VkDevice device, uint32_t frames_count)
+{
+    m_device = device;
+    m_static_pools.create(device);
+    m_frame_pools.resize(frames_count);
+    for (auto& pools : m_frame_pools)
+    {
+        pools.create(device);
+    }
+}
+
+void DescriptorAllocator::destroy()
+{
+    for (auto& pools : m_frame_pools)
+    {
+        pools.destroy();
+    }
+    m_frame_pools.clear();
+    m_static_pools.destroy();
+    m_static_sets.clear();
+    m_recycled_sets.clear();
+
+    for (const auto& [key, layout] : m_layouts)
+    {
+        vkDestroyDescriptorSetLayout(m_device, layout, nullptr);
+    }
+    m_layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorAllocator::layout(vector<VkDescriptorSetLayoutBinding> bindings)
+{
+    sort(bindings.begin(), bindings.end(),
+         [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+    LayoutKey key = {move(bindings)};
+
+    lock_guard<mutex> lock(m_mutex);
+    auto found = m_layouts.find(key);
+    if (found != m_layouts.end())
+    {
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layout_info.bindingCount = static_cast<uint32_t>(key.m_bindings.size());
+    layout_info.pBindings = key.m_bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &layout) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create descriptor set layout!");
+    }
+    m_layouts.emplace(move(key), layout);
+    return layout;
+}
+
+VkDescriptorSet DescriptorAllocator::static_set(VkDescriptorSetLayout layout, const vector<BufferBinding>& bindings)
+{
+    SetKey key = {layout, bindings};
+
+    lock_guard<mutex> lock(m_mutex);
+    auto found = m_static_sets.find(key);
+    if (found != m_static_sets.end())
+    {
+        ++m_static_set_hits;
+        return found->second;
+    }
+
+    VkDescriptorSet set;
+    auto& recycled = m_recycled_sets[layout];
+    if (!recycled.empty())
+    {
+        set = recycled.back();
+        recycled.pop_back();
+    }
+    else
+    {
+        set = m_static_pools.allocate(layout);
+    }
+    write(set, bindings);
+    m_static_sets.emplace(move(key), set);
+    return set;
+}
+
+void DescriptorAllocator::release_buffer(VkBuffer buffer)
+{
+    lock_guard<mutex> lock(m_mutex);
+    for (auto it = m_static_sets.begin(); it != m_static_sets.end();)
+    {
+        bool refers = any_of(it->first.m_bindings.begin(), it->first.m_bindings.end(),
+                             [buffer](const BufferBinding& binding) { return binding.m_info.buffer == buffer; });
+        if (refers)
+        {
+            m_recycled_sets[it->first.m_layout].push_back(it->second);
+            it = m_static_sets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void DescriptorAllocator::begin_frame(uint32_t frame_index)
+{
+    m_current_frame = frame_index;
+    m_frame_pools[frame_index].reset();
+}
+
+VkDescriptorSet DescriptorAllocator::frame_set(VkDescriptorSetLayout layout, const vector<BufferBinding>& bindings)
+{
+    VkDescriptorSet set = m_frame_pools[m_current_frame].allocate(layout);
+    write(set, bindings);
+    return set;
+}
+
+VkDescriptorSet DescriptorAllocator::frame_image_set(VkDescriptorSetLayout layout, const vector<ImageBinding>& bindings)
+{
+    VkDescriptorSet set = m_frame_pools[m_current_frame].allocate(layout);
+    write(set, bindings);
+    return set;
+}
+
+void DescriptorAllocator::write(VkDescriptorSet set, const vector<BufferBinding>& bindings) const
+{
+    vector<VkWriteDescriptorSet> writes(bindings.size());
+    for (size_t i = 0; i < bindings.size(); ++i)
+    {
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = set;
+        writes[i].dstBinding = bindings[i].m_binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = bindings[i].m_type;
+        writes[i].pBufferInfo = &bindings[i].m_info;
+    }
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void DescriptorAllocator::write(VkDescriptorSet set, const vector<ImageBinding>& bindings) const
+{
+    vector<VkWriteDescriptorSet> writes(bindings.size());
+    for (size_t i = 0; i < bindings.size(); ++i)
+    {
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = set;
+        writes[i].dstBinding = bindings[i].m_binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = bindings[i].m_type;
+        writes[i].pImageInfo = &bindings[i].m_info;
+    }
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void DescriptorAllocator::print_statistics(ostream& out) const
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    uint32_t frame_pools = 0;
+    uint64_t frame_sets = 0;
+    for (const auto& pools : m_frame_pools)
+    {
+        frame_pools += pools.pools_count();
+        frame_sets += pools.allocated_sets();
+    }
+
+    out << "Descriptors: " << m_layouts.size() << " set layout(s), "
+        << m_static_sets.size() << " static set(s) (" << m_static_set_hits << " cache hits), "
+        << frame_sets << " per frame set(s) from " << frame_pools << " pool(s)" << endl;
+}
@@ -0,0 +1,467 @@
+#include "DeviceMemoryAllocator.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkDeviceSize align_down(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return value / alignment * alignment;
+    }
+
+    double to_megabytes(VkDeviceSize bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+double MemoryStatistics::fragmentation() const
+{
+    VkDeviceSize free_bytes = m_allocated_bytes - m_used_bytes;
+    if (free_bytes == 0)
+    {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(m_largest_free_range) / static_cast<double>(free_bytes);
+}
+
+void DeviceMemoryAllocator::create(VkPhysicalDevice gpu, VkDevice device, VkDeviceSize block_size)
+{
+    m_device = device;
+    m_block_size = block_size;
+
+    vkGetPhysicalDeviceMemoryProperties(gpu, &m_memory_properties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    m_buffer_image_granularity = max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    m_non_coherent_atom_size = max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+void DeviceMemoryAllocator::destroy()
+{
+    lock_guard<mutex> lock(m_mutex);
+    for (auto& blocks : m_blocks)
+    {
+        for (auto& block : blocks)
+        {
+            if (block->m_mapped != nullptr)
+            {
+                vkUnmapMemory(m_device, block->m_memory);
+            }
+            vkFreeMemory(m_device, block->m_memory, nullptr);
+        }
+        blocks.clear();
+    }
+}
+
+uint32_t DeviceMemoryAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags required,
+                                                 VkMemoryPropertyFlags preferred) const
+{
+    // memory types are sorted by driver from the best performing, so the first match is used
+    for (auto flags : {required | preferred, required})
+    {
+        for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i)
+        {
+            if ((type_filter & (1u << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & flags) == flags)
+            {
+                return i;
+            }
+        }
+    }
+
+    throw runtime_error("Failed to find suitable memory type!");
+}
+
+bool DeviceMemoryAllocator::is_host_coherent(uint32_t memory_type) const
+{
+    return (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceTiling tiling)
+{
+    uint32_t memory_type;
+    switch (usage)
+    {
+    case MemoryUsage::GpuOnly:
+        memory_type = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        break;
+    case MemoryUsage::CpuToGpu:
+        memory_type = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        break;
+    default:
+        memory_type = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        break;
+    }
+
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = max<VkDeviceSize>(requirements.alignment, 1);
+    if (tiling == ResourceTiling::Optimal)
+    {
+        // image owns whole granularity pages, so no linear resource can share a page with it
+        alignment = max(alignment, m_buffer_image_granularity);
+        size = align_up(size, m_buffer_image_granularity);
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+
+    MemoryAllocation allocation;
+    auto block_size = preferred_block_size(memory_type);
+    if (size > block_size / 2)
+    {
+        // big resources get own block, they would leave too much unused space in shared one.
+        // Resource is bound at offset 0, which satisfies any alignment, so TLSF is not needed
+        auto block = create_block(memory_type, size, true);
+        allocation.m_memory = block->m_memory;
+        allocation.m_offset = 0;
+        allocation.m_size = size;
+        allocation.m_mapped = block->m_mapped;
+        allocation.m_memory_type = memory_type;
+        allocation.m_block = block;
+        return allocation;
+    }
+
+    for (auto& block : m_blocks[memory_type])
+    {
+        if (!block->m_dedicated && allocate_from_block(*block, memory_type, size, alignment, allocation))
+        {
+            return allocation;
+        }
+    }
+
+    auto block = create_block(memory_type, block_size);
+    if (!allocate_from_block(*block, memory_type, size, alignment, allocation))
+    {
+        release_block(block, memory_type);
+        throw runtime_error("Failed to sub-allocate device memory!");
+    }
+    return allocation;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (allocation.m_block == nullptr)
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+
+    auto block = static_cast<MemoryBlock*>(allocation.m_block);
+    if (block->m_dedicated)
+    {
+        release_block(block, allocation.m_memory_type);
+        allocation = MemoryAllocation();
+        return;
+    }
+
+    block->m_allocator.free(allocation.m_block_allocation);
+
+    // one empty shared block is kept, so allocate/free pattern does not hit the driver each time
+    const auto& blocks = m_blocks[allocation.m_memory_type];
+    auto shared_blocks_count = count_if(blocks.begin(), blocks.end(),
+                                        [](const unique_ptr<MemoryBlock>& candidate) { return !candidate->m_dedicated; });
+    if (block->m_allocator.empty() && shared_blocks_count > 1)
+    {
+        release_block(block, allocation.m_memory_type);
+    }
+
+    allocation = MemoryAllocation();
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate_for_buffer(VkBuffer buffer, MemoryUsage usage)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+
+    auto allocation = allocate(requirements, usage, ResourceTiling::Linear);
+    if (vkBindBufferMemory(m_device, buffer, allocation.m_memory, allocation.m_offset) != VK_SUCCESS)
+    {
+        free(allocation);
+        throw runtime_error("Failed to bind buffer memory!");
+    }
+    return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate_for_image(VkImage image, MemoryUsage usage, ResourceTiling tiling)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_device, image, &requirements);
+
+    auto allocation = allocate(requirements, usage, tiling);
+    if (vkBindImageMemory(m_device, image, allocation.m_memory, allocation.m_offset) != VK_SUCCESS)
+    {
+        free(allocation);
+        throw runtime_error("Failed to bind image memory!");
+    }
+    return allocation;
+}
+
+GpuBuffer DeviceMemoryAllocator::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memory_usage,
+                                               const vector<uint32_t>& queue_families)
+{
+    GpuBuffer buffer;
+    buffer.m_size = size;
+
+    VkBufferCreateInfo buffer_info = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queue_families.size() > 1)
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+        buffer_info.pQueueFamilyIndices = queue_families.data();
+    }
+
+    if (vkCreateBuffer(m_device, &buffer_info, nullptr, &buffer.m_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create buffer!");
+    }
+
+    try
+    {
+        buffer.m_memory = allocate_for_buffer(buffer.m_buffer, memory_usage);
+    }
+    catch (...)
+    {
+        vkDestroyBuffer(m_device, buffer.m_buffer, nullptr);
+        throw;
+    }
+    return buffer;
+}
+
+void DeviceMemoryAllocator::destroy_buffer(GpuBuffer& buffer)
+{
+    if (buffer.m_buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device, buffer.m_buffer, nullptr);
+        free(buffer.m_memory);
+    }
+    buffer = GpuBuffer();
+}
+
+void DeviceMemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    VkMappedMemoryRange range;
+    if (non_coherent_range(allocation, offset, size, range))
+    {
+        vkFlushMappedMemoryRanges(m_device, 1, &range);
+    }
+}
+
+void DeviceMemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    VkMappedMemoryRange range;
+    if (non_coherent_range(allocation, offset, size, range))
+    {
+        vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+    }
+}
+
+bool DeviceMemoryAllocator::non_coherent_range(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size,
+                                               VkMappedMemoryRange& range) const
+{
+    if (allocation.m_memory == VK_NULL_HANDLE || is_host_coherent(allocation.m_memory_type))
+    {
+        return false;
+    }
+
+    if (size == VK_WHOLE_SIZE)
+    {
+        size = allocation.m_size - offset;
+    }
+
+    // range should be aligned to nonCoherentAtomSize or end at the end of memory
+    VkDeviceSize begin = align_down(allocation.m_offset + offset, m_non_coherent_atom_size);
+    VkDeviceSize end = align_up(allocation.m_offset + offset + size, m_non_coherent_atom_size);
+
+    range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = allocation.m_memory;
+    range.offset = begin;
+    range.size = end - begin;
+    if (allocation.m_block != nullptr)
+    {
+        auto block_size = static_cast<const MemoryBlock*>(allocation.m_block)->m_size;
+        if (end >= block_size)
+        {
+            range.size = VK_WHOLE_SIZE;
+        }
+    }
+    return true;
+}
+
+MemoryStatistics DeviceMemoryAllocator::statistics() const
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    MemoryStatistics statistics;
+    for (const auto& blocks : m_blocks)
+    {
+        for (const auto& block : blocks)
+        {
+            ++statistics.m_blocks_count;
+            if (block->m_dedicated)
+            {
+                ++statistics.m_allocations_count;
+                statistics.m_allocated_bytes += block->m_size;
+                statistics.m_used_bytes += block->m_size;
+                continue;
+            }
+
+            const auto& allocator = block->m_allocator;
+            statistics.m_allocations_count += allocator.allocations_count();
+            statistics.m_free_ranges_count += allocator.free_ranges_count();
+            statistics.m_allocated_bytes += allocator.capacity();
+            statistics.m_used_bytes += allocator.used();
+            statistics.m_largest_free_range = max(statistics.m_largest_free_range, allocator.largest_free_range());
+        }
+    }
+    return statistics;
+}
+
+void DeviceMemoryAllocator::print_statistics(ostream& out) const
+{
+    auto statistics = this->statistics();
+    out << fixed << setprecision(2)
+        << "Device memory: " << statistics.m_blocks_count << " block(s), "
+        << to_megabytes(statistics.m_allocated_bytes) << " MB allocated, "
+        << to_megabytes(statistics.m_used_bytes) << " MB used by " << statistics.m_allocations_count << " allocation(s), "
+        << statistics.m_free_ranges_count << " free range(s), largest free "
+        << to_megabytes(statistics.m_largest_free_range) << " MB, fragmentation "
+        << statistics.fragmentation() * 100.0 << "%" << endl;
+    out << defaultfloat;
+}
+
+DeviceMemoryAllocator::MemoryBlock* DeviceMemoryAllocator::create_block(uint32_t memory_type, VkDeviceSize size, bool dedicated)
+{
+    VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_device, &allocate_info, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to allocate device memory block!");
+    }
+
+    // host visible blocks stay mapped for their whole life, mapping is not free
+    void* mapped = nullptr;
+    if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+        {
+            vkFreeMemory(m_device, memory, nullptr);
+            throw runtime_error("Failed to map device memory block!");
+        }
+    }
+
+    m_blocks[memory_type].push_back(make_unique<MemoryBlock>(memory, size, mapped, dedicated));
+    return m_blocks[memory_type].back().get();
+}
+
+void DeviceMemoryAllocator::release_block(MemoryBlock* block, uint32_t memory_type)
+{
+    if (block->m_mapped != nullptr)
+    {
+        vkUnmapMemory(m_device, block->m_memory);
+    }
+    vkFreeMemory(m_device, block->m_memory, nullptr);
+
+    auto& blocks = m_blocks[memory_type];
+    blocks.erase(find_if(blocks.begin(), blocks.end(),
+                         [block](const unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; }));
+}
+
+bool DeviceMemoryAllocator::allocate_from_block(MemoryBlock& block, uint32_t memory_type, VkDeviceSize size,
+                                                VkDeviceSize alignment, MemoryAllocation& allocation)
+{
+    auto block_allocation = block.m_allocator.allocate(size, alignment);
+    if (block_allocation == TlsfAllocator::INVALID_ALLOCATION)
+    {
+        return false;
+    }
+
+    allocation.m_memory = block.m_memory;
+    allocation.m_offset = block.m_allocator.offset(block_allocation);
+    allocation.m_size = size;
+    allocation.m_mapped = block.m_mapped != nullptr ? static_cast<char*>(block.m_mapped) + allocation.m_offset : nullptr;
+    allocation.m_memory_type = memory_type;
+    allocation.m_block = &block;
+    allocation.m_block_allocation = block_allocation;
+    return true;
+}
+
+VkDeviceSize DeviceMemoryAllocator::preferred_block_size(uint32_t memory_type) const
+{
+    // small heaps (e.g. device local host visible window) should not be taken by one block
+    auto heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[memory_type].heapIndex].size;
+    return min(m_block_size, max<VkDeviceSize>(heap_size / 8, 1));
+}
+
+void LinearArena::create(DeviceMemoryAllocator& allocator, VkDeviceSize frame_capacity, uint32_t frames_count,
+                         VkBufferUsageFlags usage, VkDeviceSize alignment)
+{
+    m_alignment = max<VkDeviceSize>(alignment, 1);
+    m_frame_capacity = align_up(max<VkDeviceSize>(frame_capacity, 1), m_alignment);
+    m_frames_count = max(frames_count, 1u);
+    m_current_frame = 0;
+    m_head = 0;
+    m_peak = 0;
+
+    m_buffer = allocator.create_buffer(m_frame_capacity * m_frames_count, usage, MemoryUsage::CpuToGpu);
+    if (m_buffer.m_memory.m_mapped == nullptr)
+    {
+        allocator.destroy_buffer(m_buffer);
+        throw runtime_error("Linear arena memory is not mapped!");
+    }
+}
+
+void LinearArena::destroy(DeviceMemoryAllocator& allocator)
+{
+    allocator.destroy_buffer(m_buffer);
+}
+
+void LinearArena::begin_frame(uint32_t frame_index)
+{
+    m_peak = peak_used();
+    m_current_frame = frame_index;
+    m_head = 0;
+}
+
+void LinearArena::rewind()
+{
+    m_peak = peak_used();
+    m_head = 0;
+}
+
+bool LinearArena::allocate(VkDeviceSize size, Allocation& allocation)
+{
+    // region starts and sizes are multiples of alignment, so every offset stays aligned
+    VkDeviceSize offset = m_head.fetch_add(align_up(size, m_alignment));
+    if (offset + size > m_frame_capacity)
+    {
+        return false;
+    }
+
+    allocation.m_offset = frame_offset(m_current_frame) + offset;
+    allocation.m_mapped = static_cast<char*>(m_buffer.m_memory.m_mapped) + allocation.m_offset;
+    return true;
+}
+
+void LinearArena::flush(const DeviceMemoryAllocator& allocator, VkDeviceSize begin) const
+{
+    VkDeviceSize end = frame_used();
+    if (end > begin)
+    {
+        allocator.flush(m_buffer.m_memory, frame_offset(m_current_frame) + begin, end - begin);
+    }
+}
@@ -0,0 +1,301 @@
+#include "DeviceSelector.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    // not required, but used when present
+    const vector<const char*> OPTIONAL_EXTENSIONS = {
+        "VK_KHR_draw_indirect_count",
+        "VK_KHR_timeline_semaphore",
+        "VK_EXT_memory_budget",
+        "VK_KHR_synchronization2"
+    };
+
+    string to_lower(string value)
+    {
+        transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+        return value;
+    }
+
+    // UUID is compared without dashes and case
+    string normalize_uuid(const string& value)
+    {
+        string normalized;
+        for (char c : value)
+        {
+            if (c != '-')
+            {
+                normalized += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        return normalized;
+    }
+
+    string version_string(uint32_t version)
+    {
+        return to_string(VK_VERSION_MAJOR(version)) + "." + to_string(VK_VERSION_MINOR(version)) + "." +
+               to_string(VK_VERSION_PATCH(version));
+    }
+
+    string queue_flags_string(VkQueueFlags flags)
+    {
+        string result;
+        if (flags & VK_QUEUE_GRAPHICS_BIT) result += "graphics ";
+        if (flags & VK_QUEUE_COMPUTE_BIT) result += "compute ";
+        if (flags & VK_QUEUE_TRANSFER_BIT) result += "transfer ";
+        if (flags & VK_QUEUE_SPARSE_BINDING_BIT) result += "sparse ";
+        return result;
+    }
+}
+
+const char* physical_device_type_name(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+PhysicalDeviceInfo PhysicalDeviceInfo::query(VkPhysicalDevice device, uint32_t index)
+{
+    PhysicalDeviceInfo info;
+    info.m_device = device;
+    info.m_index = index;
+    vkGetPhysicalDeviceProperties(device, &info.m_properties);
+    vkGetPhysicalDeviceFeatures(device, &info.m_features);
+    vkGetPhysicalDeviceMemoryProperties(device, &info.m_memory);
+
+    uint32_t families_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &families_count, nullptr);
+    info.m_queue_families.resize(families_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &families_count, info.m_queue_families.data());
+
+    uint32_t extensions_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensions_count, nullptr);
+    vector<VkExtensionProperties> extensions(extensions_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensions_count, extensions.data());
+    for (const auto& extension : extensions)
+    {
+        info.m_extensions.insert(extension.extensionName);
+    }
+
+    for (uint32_t i = 0; i < info.m_memory.memoryHeapCount; ++i)
+    {
+        if (info.m_memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            info.m_device_local_bytes += info.m_memory.memoryHeaps[i].size;
+        }
+    }
+    return info;
+}
+
+string PhysicalDeviceInfo::uuid() const
+{
+    ostringstream out;
+    out << hex << setfill('0');
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+    {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+        {
+            out << '-';
+        }
+        out << setw(2) << static_cast<uint32_t>(m_properties.pipelineCacheUUID[i]);
+    }
+    return out.str();
+}
+
+bool PhysicalDeviceInfo::has_dedicated_transfer_family() const
+{
+    return any_of(m_queue_families.begin(), m_queue_families.end(), [](const VkQueueFamilyProperties& family)
+    {
+        return (family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+               !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    });
+}
+
+bool PhysicalDeviceInfo::has_async_compute_family() const
+{
+    return any_of(m_queue_families.begin(), m_queue_families.end(), [](const VkQueueFamilyProperties& family)
+    {
+        return (family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    });
+}
+
+void PhysicalDeviceInfo::print_capabilities(ostream& out) const
+{
+    const auto& limits = m_properties.limits;
+    out << "Device " << m_index << ": " << m_properties.deviceName
+        << " (" << physical_device_type_name(m_properties.deviceType) << ")" << endl
+        << "  vendor/device id:   " << hex << setfill('0') << setw(4) << m_properties.vendorID << ":"
+        << setw(4) << m_properties.deviceID << dec << setfill(' ') << endl
+        << "  uuid:               " << uuid() << endl
+        << "  api version:        " << version_string(m_properties.apiVersion) << ", driver " << m_properties.driverVersion << endl;
+
+    out << "  memory heaps:" << endl;
+    for (uint32_t i = 0; i < m_memory.memoryHeapCount; ++i)
+    {
+        const auto& heap = m_memory.memoryHeaps[i];
+        out << "    " << i << ": " << heap.size / (1024 * 1024) << " MB"
+            << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " device local" : "") << endl;
+    }
+
+    out << "  queue families:" << endl;
+    for (size_t i = 0; i < m_queue_families.size(); ++i)
+    {
+        const auto& family = m_queue_families[i];
+        out << "    " << i << ": " << family.queueCount << " x " << queue_flags_string(family.queueFlags)
+            << "(timestamp bits " << family.timestampValidBits << ")" << endl;
+    }
+
+    out << "  limits:" << endl << left;
+    out << "    " << setw(32) << "maxImageDimension2D" << limits.maxImageDimension2D << endl;
+    out << "    " << setw(32) << "maxPushConstantsSize" << limits.maxPushConstantsSize << endl;
+    out << "    " << setw(32) << "maxBoundDescriptorSets" << limits.maxBoundDescriptorSets << endl;
+    out << "    " << setw(32) << "maxComputeWorkGroupInvocations" << limits.maxComputeWorkGroupInvocations << endl;
+    out << "    " << setw(32) << "maxComputeSharedMemorySize" << limits.maxComputeSharedMemorySize << endl;
+    out << "    " << setw(32) << "maxDrawIndirectCount" << limits.maxDrawIndirectCount << endl;
+    out << "    " << setw(32) << "minUniformBufferOffsetAlignment" << limits.minUniformBufferOffsetAlignment << endl;
+    out << "    " << setw(32) << "nonCoherentAtomSize" << limits.nonCoherentAtomSize << endl;
+    out << "    " << setw(32) << "timestampPeriod" << limits.timestampPeriod << " ns" << endl;
+    out << right;
+
+    out << "  features: multiDrawIndirect " << (m_features.multiDrawIndirect ? "yes" : "no")
+        << ", drawIndirectFirstInstance " << (m_features.drawIndirectFirstInstance ? "yes" : "no") << endl;
+
+    out << "  optional extensions:";
+    for (const auto& extension : OPTIONAL_EXTENSIONS)
+    {
+        out << " " << extension << (m_extensions.count(extension) ? " yes" : " no") << ";";
+    }
+    out << endl << "  " << m_extensions.size() << " extensions supported" << endl;
+}
+
+int64_t DeviceSelector::score(const PhysicalDeviceInfo& info)
+{
+    int64_t score = 0;
+
+    // device type dominates, other criteria only order devices of the same type
+    switch (info.m_properties.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        score += 100000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        score += 50000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        score += 20000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        break;
+    default:
+        score += 10000;
+        break;
+    }
+
+    // 1 point per 64 MB
+    score += static_cast<int64_t>(info.m_device_local_bytes / (64 * 1024 * 1024));
+
+    const auto& limits = info.m_properties.limits;
+    score += limits.maxImageDimension2D / 256;
+    score += limits.maxComputeWorkGroupInvocations / 64;
+    score += limits.maxComputeSharedMemorySize / 1024;
+
+    // separate families let uploads and compute overlap rendering
+    if (info.has_dedicated_transfer_family())
+    {
+        score += 500;
+    }
+    if (info.has_async_compute_family())
+    {
+        score += 500;
+    }
+
+    for (const auto& extension : OPTIONAL_EXTENSIONS)
+    {
+        if (info.m_extensions.count(extension) != 0)
+        {
+            score += 100;
+        }
+    }
+    if (info.m_features.multiDrawIndirect)
+    {
+        score += 100;
+    }
+    return score;
+}
+
+string DeviceSelector::device_override(const string& command_line_value)
+{
+    if (!command_line_value.empty())
+    {
+        return command_line_value;
+    }
+    const char* value = getenv(OVERRIDE_ENVIRONMENT_VARIABLE);
+    return value != nullptr ? value : "";
+}
+
+bool DeviceSelector::matches(const PhysicalDeviceInfo& info, const string& device_override)
+{
+    if (all_of(device_override.begin(), device_override.end(), [](unsigned char c) { return isdigit(c) != 0; }))
+    {
+        return to_string(info.m_index) == device_override;
+    }
+    if (normalize_uuid(info.uuid()) == normalize_uuid(device_override))
+    {
+        return true;
+    }
+    return to_lower(info.m_properties.deviceName).find(to_lower(device_override)) != string::npos;
+}
+
+const PhysicalDeviceInfo& DeviceSelector::select(const vector<PhysicalDeviceInfo>& candidates, const string& device_override)
+{
+    if (candidates.empty())
+    {
+        throw runtime_error("Could not find suitable physical device!");
+    }
+
+    if (!device_override.empty())
+    {
+        auto found = find_if(candidates.begin(), candidates.end(), [&device_override](const PhysicalDeviceInfo& info)
+        {
+            return matches(info, device_override);
+        });
+        if (found == candidates.end())
+        {
+            throw runtime_error("No suitable physical device matches '" + device_override + "'!");
+        }
+        return *found;
+    }
+
+    // the first enumerated device wins a tie
+    return *max_element(candidates.begin(), candidates.end(), [](const PhysicalDeviceInfo& a, const PhysicalDeviceInfo& b)
+    {
+        return score(a) < score(b);
+    });
+}
+
+void DeviceSelector::print_ranking(ostream& out, const vector<PhysicalDeviceInfo>& candidates, const PhysicalDeviceInfo& chosen)
+{
+    out << "Suitable devices:" << endl;
+    for (const auto& info : candidates)
+    {
+        out << (info.m_device == chosen.m_device ? "* " : "  ") << info.m_index << ": " << info.m_properties.deviceName
+            << " (" << physical_device_type_name(info.m_properties.deviceType) << "), score " << score(info)
+            << ", uuid " << info.uuid() << endl;
+    }
+}
@@ -0,0 +1,19 @@
+#include "EmbeddedShaders.hpp"
+#include <algorithm>
+#include <cstring>
+
+const EmbeddedShader* find_embedded_shader(const string& name)
+{
+    auto end = EMBEDDED_SHADERS + EMBEDDED_SHADERS_COUNT;
+    auto found = lower_bound(EMBEDDED_SHADERS, end, name,
+                             [](const EmbeddedShader& shader, const string& value)
+                             {
+                                 return strcmp(shader.m_name, value.c_str()) < 0;
+                             });
+
+    if (found == end || name != found->m_name)
+    {
+        return nullptr;
+    }
+    return found;
+}
@@ -0,0 +1,165 @@
+#include "FramePacer.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    // OS sleep may overshoot, last part of the wait is spent in yield loop
+    constexpr auto SPIN_WAIT_TIME = chrono::microseconds(1000);
+
+    double to_ms(chrono::steady_clock::duration duration)
+    {
+        return chrono::duration<double, milli>(duration).count();
+    }
+
+    bool is_available(VkPresentModeKHR mode, const vector<VkPresentModeKHR>& available_modes)
+    {
+        return find(available_modes.begin(), available_modes.end(), mode) != available_modes.end();
+    }
+}
+
+void FramePacer::create(PacingPolicy policy, double target_frame_time_ms)
+{
+    m_policy = policy;
+    m_target_frame_time = chrono::duration_cast<clock::duration>(chrono::duration<double, milli>(target_frame_time_ms));
+    m_next_frame_start = clock::now();
+}
+
+VkPresentModeKHR FramePacer::choose_present_mode(PacingPolicy policy, const vector<VkPresentModeKHR>& available_modes)
+{
+    if (policy == PacingPolicy::LowestLatency)
+    {
+        // mailbox shows the newest frame without tearing, immediate does not wait for vblank at all
+        for (auto mode : {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR})
+        {
+            if (is_available(mode, available_modes))
+            {
+                return mode;
+            }
+        }
+    }
+
+    // FIFO is always supported. Power policy relies on its blocking to idle CPU and GPU between vblanks
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t FramePacer::choose_images_count(PacingPolicy policy, VkPresentModeKHR present_mode,
+                                         const VkSurfaceCapabilitiesKHR& capabilities)
+{
+    uint32_t images_count = capabilities.minImageCount;
+    switch (policy)
+    {
+    case PacingPolicy::LowestLatency:
+        // mailbox needs a spare image to replace queued one, immediate needs no queue at all
+        images_count = present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? max(capabilities.minImageCount + 1, 3u)
+                                                                   : capabilities.minImageCount;
+        break;
+    case PacingPolicy::LowestPower:
+        // shortest queue, CPU blocks early instead of rendering frames ahead
+        images_count = max(capabilities.minImageCount, 2u);
+        break;
+    case PacingPolicy::Vsync:
+        // one extra image keeps GPU busy while another one waits for vblank
+        images_count = capabilities.minImageCount + 1;
+        break;
+    }
+
+    if (capabilities.maxImageCount > 0)
+    {
+        images_count = min(images_count, capabilities.maxImageCount);
+    }
+    return images_count;
+}
+
+void FramePacer::begin_frame()
+{
+    auto now = clock::now();
+    if (m_target_frame_time > clock::duration::zero())
+    {
+        if (now < m_next_frame_start)
+        {
+            if (m_next_frame_start - now > SPIN_WAIT_TIME)
+            {
+                this_thread::sleep_until(m_next_frame_start - SPIN_WAIT_TIME);
+            }
+            while (clock::now() < m_next_frame_start)
+            {
+                this_thread::yield();
+            }
+            m_throttle_waits.add_frame(to_ms(clock::now() - now));
+            now = clock::now();
+        }
+
+        // late frame starts a new schedule, so missed slots are not caught up with a burst of frames
+        m_next_frame_start = max(m_next_frame_start + m_target_frame_time, now);
+    }
+
+    m_frame_start = now;
+    m_input_time = now;
+}
+
+void FramePacer::input_sampled()
+{
+    m_input_time = clock::now();
+}
+
+void FramePacer::end_frame()
+{
+    auto now = clock::now();
+    m_cpu_frame_times.add_frame(to_ms(now - m_frame_start));
+    m_input_to_present.add_frame(to_ms(now - m_input_time));
+}
+
+void FramePacer::add_gpu_frame_time(double frame_time_ms)
+{
+    m_gpu_frame_times.add_frame(frame_time_ms);
+}
+
+void FramePacer::reset()
+{
+    m_cpu_frame_times.reset();
+    m_gpu_frame_times.reset();
+    m_input_to_present.reset();
+    m_throttle_waits.reset();
+}
+
+void FramePacer::print_report(ostream& out) const
+{
+    out << "Pacing policy: " << pacing_policy_name(m_policy);
+    if (m_target_frame_time > clock::duration::zero())
+    {
+        out << ", target frame time " << to_ms(m_target_frame_time) << " ms, throttled "
+            << m_throttle_waits.frames_count() << " frame(s)";
+    }
+    out << endl;
+
+    m_cpu_frame_times.print_report(out, "CPU frame times (without throttling)");
+    if (m_gpu_frame_times.frames_count() > 0)
+    {
+        m_gpu_frame_times.print_report(out, "GPU frame times");
+    }
+    m_input_to_present.print_report(out, "Input to present times");
+}
+
+const char* pacing_policy_name(PacingPolicy policy)
+{
+    switch (policy)
+    {
+    case PacingPolicy::LowestLatency: return "lowest latency";
+    case PacingPolicy::LowestPower:   return "lowest power";
+    case PacingPolicy::Vsync:         return "vsync";
+    }
+    return "unknown";
+}
+
+const char* present_mode_name(VkPresentModeKHR present_mode)
+{
+    switch (present_mode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default:                               return "unknown";
+    }
+}
@@ -0,0 +1,75 @@
+#include "FrameStatistics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+void FrameStatistics::add_frame(double frame_time_ms)
+{
+    if (m_frame_times_ms.size() < MAX_SAMPLES)
+    {
+        m_frame_times_ms.push_back(frame_time_ms);
+    }
+    else
+    {
+        m_frame_times_ms[m_next_sample] = frame_time_ms;
+        m_next_sample = (m_next_sample + 1) % MAX_SAMPLES;
+    }
+    ++m_frames_count;
+    m_total_ms += frame_time_ms;
+}
+
+void FrameStatistics::reset()
+{
+    m_frame_times_ms.clear();
+    m_next_sample = 0;
+    m_frames_count = 0;
+    m_total_ms = 0.0;
+}
+
+double FrameStatistics::average_ms() const
+{
+    if (m_frames_count == 0)
+    {
+        return 0.0;
+    }
+    return m_total_ms / static_cast<double>(m_frames_count);
+}
+
+double FrameStatistics::percentile_ms(double percentile) const
+{
+    if (m_frame_times_ms.empty())
+    {
+        return 0.0;
+    }
+
+    // copy keeps samples in submission order
+    vector<double> samples = m_frame_times_ms;
+    auto index = rank_index(samples.size(), percentile);
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+size_t FrameStatistics::rank_index(size_t samples_count, double percentile)
+{
+    // nearest-rank percentile
+    auto rank = static_cast<size_t>(ceil(percentile / 100.0 * static_cast<double>(samples_count)));
+    return min(max(rank, static_cast<size_t>(1)), samples_count) - 1;
+}
+
+void FrameStatistics::print_report(ostream& out, const string& title) const
+{
+    auto average = average_ms();
+    // one sorted copy for all percentiles
+    vector<double> sorted = m_frame_times_ms;
+    sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double value) { return sorted.empty() ? 0.0 : sorted[rank_index(sorted.size(), value)]; };
+
+    out << fixed << setprecision(3)
+        << title << ":" << endl
+        << "  frames:  " << frames_count() << endl
+        << "  average: " << average << " ms (" << (average > 0.0 ? 1000.0 / average : 0.0) << " fps)" << endl
+        << "  p50:     " << percentile(50.0) << " ms" << endl
+        << "  p95:     " << percentile(95.0) << " ms" << endl
+        << "  p99:     " << percentile(99.0) << " ms" << endl;
+    out << defaultfloat;
+}
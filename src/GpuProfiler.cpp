@@ -0,0 +1,218 @@
+#include "GpuProfiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include "utils.hpp"
+
+void GpuProfiler::RollingStatistics::add(double sample)
+{
+    if (m_samples.size() < ROLLING_WINDOW)
+    {
+        m_samples.push_back(sample);
+    }
+    else
+    {
+        m_samples[m_next] = sample;
+    }
+    m_next = (m_next + 1) % ROLLING_WINDOW;
+    ++m_total_count;
+}
+
+void GpuProfiler::create(VkPhysicalDevice gpu, VkDevice device, uint32_t queue_family,
+                         uint32_t frames_count, uint32_t max_scopes)
+{
+    m_device = device;
+    m_max_scopes = max_scopes;
+
+    uint32_t families_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &families_count, nullptr);
+    vector<VkQueueFamilyProperties> families(families_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &families_count, families.data());
+
+    uint32_t valid_bits = queue_family < families_count ? families[queue_family].timestampValidBits : 0;
+    if (valid_bits == 0)
+    {
+        cout << "GPU profiler is disabled: queue family does not support timestamps" << endl;
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    m_timestamp_period_ns = static_cast<double>(properties.limits.timestampPeriod);
+    m_timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = 2 * m_max_scopes;
+
+    m_frames.resize(frames_count);
+    for (auto& frame : m_frames)
+    {
+        if (vkCreateQueryPool(m_device, &pool_info, nullptr, &frame.m_pool) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create timestamp query pool!");
+        }
+        frame.m_scope_names.reserve(m_max_scopes);
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    for (auto& frame : m_frames)
+    {
+        vkDestroyQueryPool(m_device, frame.m_pool, nullptr);
+    }
+    m_frames.clear();
+}
+
+bool GpuProfiler::begin_frame(uint32_t frame_index, uint64_t frame_number)
+{
+    if (!is_enabled())
+    {
+        return false;
+    }
+
+    m_recording_frame = frame_index;
+    auto& frame = m_frames[frame_index];
+
+    uint32_t scopes_count = static_cast<uint32_t>(frame.m_scope_names.size());
+    bool has_results = false;
+    if (scopes_count > 0)
+    {
+        vector<uint64_t> timestamps(2 * scopes_count);
+        // frame fence is signaled, so VK_NOT_READY means a scope was not ended
+        VkResult result = vkGetQueryPoolResults(m_device, frame.m_pool, 0, 2 * scopes_count,
+                                                timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS)
+        {
+            uint64_t frame_begin = UINT64_MAX;
+            uint64_t frame_end = 0;
+            for (uint32_t i = 0; i < scopes_count; ++i)
+            {
+                uint64_t begin = timestamps[2 * i] & m_timestamp_mask;
+                uint64_t end = timestamps[2 * i + 1] & m_timestamp_mask;
+                if (!m_has_time_origin)
+                {
+                    m_time_origin = begin;
+                    m_has_time_origin = true;
+                }
+                frame_begin = min(frame_begin, begin);
+                frame_end = max(frame_end, end);
+
+                double duration_ns = static_cast<double>(end >= begin ? end - begin : 0) * m_timestamp_period_ns;
+                m_statistics[frame.m_scope_names[i]].add(duration_ns / 1e6);
+
+                if (m_trace.size() < MAX_TRACE_EVENTS && begin >= m_time_origin)
+                {
+                    double start_us = static_cast<double>(begin - m_time_origin) * m_timestamp_period_ns / 1e3;
+                    m_trace.push_back({frame.m_scope_names[i], frame.m_frame_number, start_us, duration_ns / 1e3});
+                }
+            }
+            m_last_frame_time_ms = static_cast<double>(frame_end - frame_begin) * m_timestamp_period_ns / 1e6;
+            has_results = true;
+        }
+    }
+
+    frame.m_scope_names.clear();
+    frame.m_frame_number = frame_number;
+    return has_results;
+}
+
+void GpuProfiler::reset_queries(VkCommandBuffer command_buffer)
+{
+    if (!is_enabled())
+    {
+        return;
+    }
+    vkCmdResetQueryPool(command_buffer, m_frames[m_recording_frame].m_pool, 0, 2 * m_max_scopes);
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer command_buffer, const string& name, VkPipelineStageFlagBits stage)
+{
+    if (!is_enabled())
+    {
+        return INVALID_SCOPE;
+    }
+
+    auto& frame = m_frames[m_recording_frame];
+    uint32_t scope;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (frame.m_scope_names.size() >= m_max_scopes)
+        {
+            ++m_overflows_count;
+            return INVALID_SCOPE;
+        }
+        scope = static_cast<uint32_t>(frame.m_scope_names.size());
+        frame.m_scope_names.push_back(name);
+    }
+
+    vkCmdWriteTimestamp(command_buffer, stage, frame.m_pool, 2 * scope);
+    return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer command_buffer, uint32_t scope, VkPipelineStageFlagBits stage)
+{
+    if (scope == INVALID_SCOPE)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(command_buffer, stage, m_frames[m_recording_frame].m_pool, 2 * scope + 1);
+}
+
+void GpuProfiler::print_report(ostream& out, const string& title) const
+{
+    if (!is_enabled() || m_statistics.empty())
+    {
+        return;
+    }
+
+    out << fixed << setprecision(3)
+        << title << " (last " << ROLLING_WINDOW << " samples, ms):" << endl;
+    for (const auto& [name, statistics] : m_statistics)
+    {
+        vector<double> sorted = statistics.m_samples;
+        sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (double sample : sorted)
+        {
+            sum += sample;
+        }
+        size_t p99 = min(sorted.size() - 1, sorted.size() * 99 / 100);
+
+        out << "  " << left << setw(20) << name << right
+            << " min " << sorted.front()
+            << "  avg " << sum / static_cast<double>(sorted.size())
+            << "  p99 " << sorted[p99]
+            << "  (" << statistics.m_total_count << " samples)" << endl;
+    }
+    if (m_overflows_count > 0)
+    {
+        out << "  " << m_overflows_count << " scopes were dropped, more than " << m_max_scopes << " per frame" << endl;
+    }
+    out << defaultfloat;
+}
+
+void GpuProfiler::write_chrome_trace(const string& path) const
+{
+    ofstream file(path);
+    if (!file)
+    {
+        throw runtime_error("Failed to open GPU trace file " + path + "!");
+    }
+
+    file << fixed << setprecision(3) << "{\"traceEvents\":[" << endl;
+    for (size_t i = 0; i < m_trace.size(); ++i)
+    {
+        const auto& event = m_trace[i];
+        file << "{\"name\":\"" << escape_json(event.m_name) << "\",\"cat\":\"gpu\",\"ph\":\"X\""
+             << ",\"ts\":" << event.m_start_us << ",\"dur\":" << event.m_duration_us
+             << ",\"pid\":0,\"tid\":0,\"args\":{\"frame\":" << event.m_frame_number << "}}"
+             << (i + 1 < m_trace.size() ? "," : "") << endl;
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}" << endl;
+}
@@ -6,44 +6,207 @@
 #include <cstring>
 #include <set>
 #include <algorithm>
-#include "utils.hpp"
-
-HelloTriangleApplication::HelloTriangleApplication()
-    : m_gpu(nullptr)
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include "EmbeddedShaders.hpp"
+#include "MappedFile.hpp"
+
+// compiler of the build, set by CMake
+#ifndef GLSLANG_VALIDATOR_PATH
+#define GLSLANG_VALIDATOR_PATH "glslangValidator"
+#endif
+
+HelloTriangleApplication::HelloTriangleApplication(const ApplicationSettings& settings)
+    : m_settings(settings)
+    , m_window(nullptr)
+    , m_gpu(nullptr)
+    , m_transfer_queue(VK_NULL_HANDLE)
+    , m_compute_queue(VK_NULL_HANDLE)
+    , m_frame_uniforms_offset(0)
+    , m_surface(VK_NULL_HANDLE)
+    , m_swapchain_dirty(false)
+    , m_swapchain_recreations(0)
+    , m_material_pipelines(nullptr)
+    , m_async_materials(false)
+    , m_pipeline(nullptr)
+    , m_instanced_pipeline(nullptr)
+    , m_particle_pipeline(nullptr)
+    , m_post_set_layout(VK_NULL_HANDLE)
+    , m_post_pipeline_layout(VK_NULL_HANDLE)
+    , m_post_pipeline(nullptr)
+    , m_index_count(0)
+    , m_instance_stream_offsets()
+    , m_instances_count(0)
+    , m_mesh_radius(0.0f)
+    , m_gpu_driven(settings.m_gpu_driven)
+    , m_multi_draw_indirect(false)
+    , m_draw_indirect_first_instance(false)
+    , m_max_draw_indirect_count(1)
+    , m_reduction_kernel(nullptr)
+    , m_reduction_fill_pending(false)
+    , m_max_recording_threads(0)
+    , m_recording_threads(0)
+    , m_current_frame(0)
+    , m_frame_counter(0)
 {
 }
 
 void HelloTriangleApplication::run()
 {
-    init_window();
-    init_vulkan();
+    m_startup_timings.measure("initialization", [this]() { init_vulkan(); });
+
+    m_startup_timings.print_report(cout, "Startup");
+    if (!m_settings.m_startup_report_path.empty())
+    {
+        m_startup_timings.write_json(m_settings.m_startup_report_path);
+    }
+    // pipelines and shaders created at runtime would grow the log for the whole run
+    m_startup_timings.stop();
+
     execute_main_loop();
     cleanup();
 }
 
-void HelloTriangleApplication::init_window()
+void HelloTriangleApplication::init_window_system()
 {
+    if (m_settings.m_headless)
+    {
+        return;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+}
+
+void HelloTriangleApplication::init_window()
+{
+    if (m_settings.m_headless)
+    {
+        return;
+    }
+
     m_window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulcan", nullptr, nullptr);
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetFramebufferSizeCallback(m_window, framebuffer_resize_callback);
 }
 
 void HelloTriangleApplication::init_vulkan()
 {
-    create_VK_instance();
+    m_frame_pacer.create(m_settings.m_pacing_policy, m_settings.m_target_frame_time_ms);
+
+    /**
+      * Window system calls (glfwInit, window creation, framebuffer size used by swapchain)
+      * stay on the main thread. Staging ring is not thread safe, so its users
+      * (offscreen targets, geometry) are chained by dependencies.
+      **/
+    TaskGraph graph;
+    auto window_system = graph.add_main_thread("init_window_system", [this]() { init_window_system(); });
+    auto window = graph.add_main_thread("init_window", [this]() { init_window(); }, {window_system});
+    auto instance = graph.add("create_VK_instance", [this]() { create_VK_instance(); }, {window_system});
     if (ENABLE_VALIDATION_LAYERS)
     {
-        init_setup_callback();
+        graph.add("init_setup_callback", [this]() { init_setup_callback(); }, {instance});
+    }
+    auto surface = graph.add("create_KHR_surface", [this]()
+    {
+        if (!m_settings.m_headless)
+        {
+            create_KHR_surface();
+        }
+    }, {instance, window});
+    auto gpu = graph.add("pick_graphic_card", [this]() { pick_graphic_card(); }, {surface});
+    auto device = graph.add("create_logical_device", [this]() { create_logical_device(); }, {gpu});
+    auto allocator = graph.add("memory allocator", [this]() { m_memory_allocator.create(m_gpu, m_device); }, {device});
+    auto pipeline_cache = graph.add("pipeline cache", [this]()
+    {
+        m_pipeline_cache.create(m_gpu, m_device, m_settings.m_pipeline_cache_path);
+        // modules are loaded before pipeline tasks, workers of background compilation may load more
+        m_pipelines.create(m_device, m_pipeline_cache.handle(), [this](const string& name) { return shader_module(name); });
+    }, {device});
+    auto shaders = graph.add("load_shader_modules", [this]() { load_shader_modules(); }, {device});
+    auto descriptors = graph.add("descriptor allocator", [this]()
+    {
+        m_descriptors.create(m_device, m_settings.m_frames_in_flight);
+    }, {device});
+    auto uniform_ring = graph.add("uniform ring", [this]()
+    {
+        m_uniform_ring.create(m_gpu, m_descriptors, m_memory_allocator, m_settings.m_frames_in_flight,
+                              VK_SHADER_STAGE_VERTEX_BIT, sizeof(FrameUniforms));
+    }, {allocator, descriptors});
+    auto staging_ring = graph.add("staging ring", [this]()
+    {
+        m_staging_ring.create(m_device, m_memory_allocator, m_graphical_queue, m_queue_families.m_graphics_family.value(),
+                              m_settings.m_frames_in_flight, m_settings.m_staging_ring_size);
+        if (m_queue_families.m_transfer_family.has_value())
+        {
+            m_upload_service = make_unique<UploadService>();
+            m_upload_service->create(m_device, m_memory_allocator, m_transfer_queue,
+                                     m_queue_families.m_transfer_family.value(),
+                                     m_queue_families.m_graphics_family.value());
+        }
+    }, {allocator});
+    auto swapchain = graph.add_main_thread("create_swap_chain", [this]()
+    {
+        if (m_settings.m_headless)
+        {
+            create_offscreen_targets();
+        }
+        else
+        {
+            create_swap_chain();
+        }
+    }, {staging_ring});
+    auto image_views = graph.add("create_image_views", [this]() { create_image_views(); }, {swapchain});
+    auto render_graph = graph.add("create_render_graph", [this]() { create_render_graph(); }, {swapchain});
+    auto frame_resources = graph.add("create_frame_resources", [this]()
+    {
+        create_frame_resources();
+        m_gpu_profiler.create(m_gpu, m_device, m_queue_families.m_graphics_family.value(),
+                              static_cast<uint32_t>(m_frames.size()));
+        create_compute_scheduler(m_settings.m_async_compute);
+    }, {swapchain});
+    auto particles = graph.add("create_particle_system", [this]() { create_particle_system(); },
+                               {frame_resources, pipeline_cache, shaders, descriptors});
+    graph.add("create_render_targets", [this]() { create_render_targets(); }, {image_views, render_graph});
+    auto geometry = graph.add("create_geometry_buffers", [this]()
+    {
+        create_geometry_buffers();
+        if (m_settings.m_instances_count > 0)
+        {
+            create_instance_buffer(m_settings.m_instances_count);
+        }
+        build_draw_list(max(m_settings.m_draws_count, 1u));
+    }, {swapchain});
+    auto indirect_draws = graph.add("create_indirect_draw_list", [this]() { create_indirect_draw_list(); },
+                                    {geometry, pipeline_cache, shaders, descriptors});
+    auto graphics_pipeline = graph.add("create_graphics_pipeline", [this]() { create_graphics_pipeline(); },
+                                       {render_graph, pipeline_cache, shaders, particles, uniform_ring});
+    // all modules are loaded by load_shader_modules, so pipeline tasks only read the map
+    graph.add("destroy_shader_modules", [this]() { destroy_shader_modules(); }, {graphics_pipeline, indirect_draws});
+
+    // pool lives only during initialization, recording threads are created later if needed
+    unique_ptr<ThreadPool> pool;
+    if (m_settings.m_parallel_init)
+    {
+        pool = make_unique<ThreadPool>();
+    }
+    graph.run(pool.get(), &m_startup_timings);
+
+    m_render_graph.print_report(cout);
+    m_memory_allocator.print_statistics(cout);
+
+    if (!m_settings.m_hot_reload_directory.empty())
+    {
+        m_hot_shader_directory = m_settings.m_hot_reload_output_directory.empty() ? HOT_RELOAD_SHADER_DIRECTORY
+                                                                                  : m_settings.m_hot_reload_output_directory;
+        m_shader_watcher = make_unique<ShaderWatcher>();
+        m_shader_watcher->start(m_settings.m_hot_reload_directory, m_hot_shader_directory, GLSLANG_VALIDATOR_PATH);
+        cout << "Hot reload: watching " << m_settings.m_hot_reload_directory << ", SPIR-V goes to "
+             << m_hot_shader_directory << endl;
     }
-    create_KHR_surface();
-    pick_graphic_card();
-    create_logical_device();
-    create_swap_chain();
-    create_image_views();
-    create_render_pass();
-    create_graphics_pipeline();
-    create_framebuffers();
 }
 
 void HelloTriangleApplication::init_setup_callback()
@@ -75,19 +238,21 @@ void HelloTriangleApplication::pick_graphic_card()
     }
     vector<VkPhysicalDevice> devices(devices_count);
     vkEnumeratePhysicalDevices(m_instance, &devices_count, devices.data());
-    for (const auto& device : devices)
+
+    vector<PhysicalDeviceInfo> candidates;
+    for (uint32_t i = 0; i < devices_count; ++i)
     {
-        if ( check_device_suitability( device ) )
+        if ( check_device_suitability( devices[i] ) )
         {
-            m_gpu = device;
-            break;
+            candidates.push_back(PhysicalDeviceInfo::query(devices[i], i));
         }
     }
 
-    if (m_gpu == nullptr)
-    {
-        throw std::runtime_error("Could not find suitable physical device!");
-    }
+    const auto& chosen = DeviceSelector::select(candidates, DeviceSelector::device_override(m_settings.m_device));
+    m_gpu = chosen.m_device;
+
+    DeviceSelector::print_ranking(cout, candidates, chosen);
+    chosen.print_capabilities(cout);
 }
 
 HelloTriangleApplication::QueueFamilyIndex HelloTriangleApplication::find_queue_families(VkPhysicalDevice device)
@@ -103,8 +268,9 @@ HelloTriangleApplication::QueueFamilyIndex HelloTriangleApplication::find_queue_
 
     for (size_t i = 0; i < queue_families.size(); ++i)
     {
-        VkBool32 present_support = false;
-        if (vkGetPhysicalDeviceSurfaceSupportKHR(device, static_cast<uint32_t>(i), m_surface, &present_support) != VK_SUCCESS)
+        VkBool32 present_support = m_settings.m_headless; // nothing is presented in headless mode
+        if (!m_settings.m_headless &&
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, static_cast<uint32_t>(i), m_surface, &present_support) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to check for surface compatability!");
         }
@@ -122,6 +288,30 @@ HelloTriangleApplication::QueueFamilyIndex HelloTriangleApplication::find_queue_
         }
     }
 
+    // transfer only family is usually backed by copy engines, which run concurrently with graphics
+    for (size_t i = 0; i < queue_families.size(); ++i)
+    {
+        if (queue_families[i].queueCount > 0 &&
+            (queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queue_families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            indices.m_transfer_family = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+
+    // compute only family runs dispatches concurrently with graphics work
+    for (size_t i = 0; i < queue_families.size(); ++i)
+    {
+        if (queue_families[i].queueCount > 0 &&
+            (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.m_compute_family = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+
     return indices;
 }
 
@@ -170,14 +360,7 @@ VkSurfaceFormatKHR HelloTriangleApplication::choose_swap_surface_format(const ve
 
 VkPresentModeKHR HelloTriangleApplication::choose_swapchain_present_mode(const vector<VkPresentModeKHR> &available_presend_modes)
 {
-    for (const auto& mode : available_presend_modes)
-    {
-        if ((mode == VK_PRESENT_MODE_MAILBOX_KHR) || (mode == VK_PRESENT_MODE_IMMEDIATE_KHR))
-        {
-            return mode;
-        }
-    }
-    return VK_PRESENT_MODE_FIFO_KHR;
+    return FramePacer::choose_present_mode(m_settings.m_pacing_policy, available_presend_modes);
 }
 
 VkExtent2D HelloTriangleApplication::choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities)
@@ -188,7 +371,11 @@ VkExtent2D HelloTriangleApplication::choose_swapchain_extent(const VkSurfaceCapa
     }
     else
     {
-        VkExtent2D actual_extent = {WINDOW_WIDTH, WINDOW_HEIGHT};
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(m_window, &width, &height);
+
+        VkExtent2D actual_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
         actual_extent.width = max(capabilities.minImageExtent.width, min(capabilities.maxImageExtent.width, actual_extent.width));
         actual_extent.height = max(capabilities.minImageExtent.height, min(capabilities.maxImageExtent.height, actual_extent.height));
 
@@ -196,15 +383,85 @@ VkExtent2D HelloTriangleApplication::choose_swapchain_extent(const VkSurfaceCapa
     }
 }
 
-VkShaderModule HelloTriangleApplication::create_shader_module(const string& path)
+void HelloTriangleApplication::load_shader_modules()
+{
+    shader_module("Triangle_vert");
+    shader_module("Triangle_frag");
+    if (is_instancing_enabled())
+    {
+        shader_module("Instanced_vert");
+    }
+    if (is_gpu_driven_enabled())
+    {
+        shader_module("Cull_comp");
+    }
+    if (m_settings.m_particles_count > 0)
+    {
+        shader_module("Particle_vert");
+        shader_module("Particles_comp");
+    }
+    if (m_settings.m_post_process)
+    {
+        shader_module("Post_vert");
+        shader_module("Post_frag");
+    }
+}
+
+VkShaderModule HelloTriangleApplication::shader_module(const string& name)
+{
+    lock_guard<mutex> lock(m_shader_modules_mutex);
+    auto found = m_shader_modules.find(name);
+    if (found == m_shader_modules.end())
+    {
+        found = m_shader_modules.emplace(name, create_shader_module(name)).first;
+    }
+    return found->second;
+}
+
+void HelloTriangleApplication::destroy_shader_modules()
+{
+    lock_guard<mutex> lock(m_shader_modules_mutex);
+    for (const auto& [name, module] : m_shader_modules)
+    {
+        vkDestroyShaderModule(m_device, module, nullptr);
+    }
+    m_shader_modules.clear();
+}
+
+VkShaderModule HelloTriangleApplication::create_shader_module(const string& name)
+{
+    ScopedTimer timer(m_startup_timings, "shader module " + name);
+
+    // recompiled by hot reload (m_shader_modules_mutex is held by caller)
+    const string& directory = m_hot_shaders.count(name) > 0 ? m_hot_shader_directory : m_settings.m_shader_directory;
+    if (!directory.empty())
+    {
+        // driver consumes mapped pages directly, mapping is page aligned as SPIR-V words require
+        MappedFile file(directory + "/" + name + ".spv");
+        if (file.empty() || file.size() % sizeof(uint32_t) != 0)
+        {
+            throw runtime_error("Shader " + name + " is not a valid SPIR-V file!");
+        }
+        return create_shader_module(file.as<uint32_t>(), file.size());
+    }
+
+    // SPIR-V is linked into binary, no file reading or copying here
+    auto shader = find_embedded_shader(name);
+    if (shader == nullptr)
+    {
+        throw runtime_error("Shader " + name + " is not embedded into binary!");
+    }
+    return create_shader_module(shader->m_code, shader->m_size);
+}
+
+VkShaderModule HelloTriangleApplication::create_shader_module(const uint32_t* code, size_t size)
 {
     VkShaderModule module;
 
-    auto shader = read_file(path);
     VkShaderModuleCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = shader.size();
-    create_info.pCode = reinterpret_cast<const uint32_t*>(shader.data());
+    create_info.codeSize = size;
+    create_info.pCode = code;
 
     if (vkCreateShaderModule(m_device,&create_info,nullptr, &module) != VK_SUCCESS)
     {
@@ -216,6 +473,14 @@ VkShaderModule HelloTriangleApplication::create_shader_module(const string& path
 void HelloTriangleApplication::create_logical_device()
 {
     auto family_indeces = find_queue_families(m_gpu);
+    if (!m_settings.m_transfer_queue)
+    {
+        family_indeces.m_transfer_family.reset();
+    }
+    if (!m_settings.m_async_compute)
+    {
+        family_indeces.m_compute_family.reset();
+    }
 
     vector<VkDeviceQueueCreateInfo> queue_create_infos;
     set<uint32_t> unique_queue_families =
@@ -223,6 +488,14 @@ void HelloTriangleApplication::create_logical_device()
         family_indeces.m_graphics_family.value(),
         family_indeces.m_present_family.value()
     };
+    if (family_indeces.m_transfer_family.has_value())
+    {
+        unique_queue_families.insert(family_indeces.m_transfer_family.value());
+    }
+    if (family_indeces.m_compute_family.has_value())
+    {
+        unique_queue_families.insert(family_indeces.m_compute_family.value());
+    }
 
     float queue_priority = 1.0f;
     for (uint32_t queue_family : unique_queue_families)
@@ -235,15 +508,24 @@ void HelloTriangleApplication::create_logical_device()
         queue_create_infos.push_back(create_info);
     }
 
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(m_gpu, &supported_features);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_gpu, &properties);
+
     VkPhysicalDeviceFeatures device_features = {};
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    // culled commands of instanced draws start from the first instance of their object
+    device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+    auto device_extensions = get_required_device_extensions();
 
     VkDeviceCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     create_info.pQueueCreateInfos = queue_create_infos.data();
-    create_info.queueCreateInfoCount = 1;
+    create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
     create_info.pEnabledFeatures = &device_features;
-    create_info.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENCIONS.size());
-    create_info.ppEnabledExtensionNames = DEVICE_EXTENCIONS.data();
+    create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+    create_info.ppEnabledExtensionNames = device_extensions.data();
 
     if (ENABLE_VALIDATION_LAYERS)
     {
@@ -255,26 +537,43 @@ void HelloTriangleApplication::create_logical_device()
         create_info.enabledLayerCount = 0;
     }
 
+    ScopedTimer timer(m_startup_timings, "vkCreateDevice");
     if (vkCreateDevice(m_gpu, &create_info, nullptr, &m_device) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create logical device!");
     }
 
+    m_queue_families = family_indeces;
+    m_multi_draw_indirect = supported_features.multiDrawIndirect == VK_TRUE;
+    m_max_draw_indirect_count = m_multi_draw_indirect ? properties.limits.maxDrawIndirectCount : 1;
+    m_draw_indirect_first_instance = supported_features.drawIndirectFirstInstance == VK_TRUE;
     vkGetDeviceQueue(m_device, family_indeces.m_graphics_family.value(), 0, &m_graphical_queue);
     vkGetDeviceQueue(m_device, family_indeces.m_present_family.value(), 0, &m_present_queue);
+    if (family_indeces.m_transfer_family.has_value())
+    {
+        vkGetDeviceQueue(m_device, family_indeces.m_transfer_family.value(), 0, &m_transfer_queue);
+        cout << "Static data is uploaded on transfer queue family " << family_indeces.m_transfer_family.value() << endl;
+    }
+    if (family_indeces.m_compute_family.has_value())
+    {
+        vkGetDeviceQueue(m_device, family_indeces.m_compute_family.value(), 0, &m_compute_queue);
+        cout << "Async compute queue family " << family_indeces.m_compute_family.value() << endl;
+    }
 }
 
-void HelloTriangleApplication::create_swap_chain()
+void HelloTriangleApplication::create_swap_chain(VkSwapchainKHR old_swapchain)
 {
     SwapChainSupportDetails swap_chain_support = query_swapchain_support(m_gpu);
     VkSurfaceFormatKHR surface_format = choose_swap_surface_format(swap_chain_support.m_formats);
     VkPresentModeKHR presend_mode = choose_swapchain_present_mode(swap_chain_support.m_present_modes);
     VkExtent2D extent = choose_swapchain_extent(swap_chain_support.m_capabilities);
 
-    uint32_t queue_length = swap_chain_support.m_capabilities.minImageCount + 1;
-    if (swap_chain_support.m_capabilities.maxImageCount > 0 && queue_length > swap_chain_support.m_capabilities.maxImageCount)
+    uint32_t queue_length = FramePacer::choose_images_count(m_settings.m_pacing_policy, presend_mode,
+                                                            swap_chain_support.m_capabilities);
+    if (old_swapchain == VK_NULL_HANDLE)
     {
-        queue_length = swap_chain_support.m_capabilities.maxImageCount;
+        cout << "Swapchain: " << present_mode_name(presend_mode) << " present mode, " << queue_length
+             << " image(s), " << pacing_policy_name(m_settings.m_pacing_policy) << " pacing" << endl;
     }
 
     VkSwapchainCreateInfoKHR create_info = {};
@@ -311,7 +610,7 @@ void HelloTriangleApplication::create_swap_chain()
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = presend_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = nullptr;
+    create_info.oldSwapchain = old_swapchain; // lets driver reuse resources of the retired swapchain
 
     if (vkCreateSwapchainKHR(m_device, &create_info, nullptr, &m_swapchain) != VK_SUCCESS)
     {
@@ -327,6 +626,101 @@ void HelloTriangleApplication::create_swap_chain()
     vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchain_images_count, m_sch_images.data());
 }
 
+bool HelloTriangleApplication::recreate_swapchain()
+{
+    // minimized window has zero extent, there is nothing to render into until it is restored
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    while ((width == 0 || height == 0) && !glfwWindowShouldClose(m_window))
+    {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(m_window, &width, &height);
+    }
+    if (width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    /**
+      * Frames in flight and presentation engine may still use old objects, so they
+      * are destroyed when those frames retire instead of waiting for device idle.
+      * Render passes and pipelines do not depend on extent (viewport and scissor are
+      * dynamic state), so only extent dependent objects are created again.
+      **/
+    VkSwapchainKHR old_swapchain = m_swapchain;
+    vector<VkImageView> old_image_views;
+    vector<VkSemaphore> old_semaphores;
+    old_image_views.swap(m_sch_image_views);
+    auto release_targets = m_render_graph.release_targets(m_memory_allocator);
+    old_semaphores.swap(m_render_finished);
+    VkFormat old_format = m_sch_image_format;
+
+    create_swap_chain(old_swapchain);
+    if (m_sch_image_format != old_format)
+    {
+        throw runtime_error("Swapchain format is changed on recreation!");
+    }
+    create_image_views();
+    create_render_targets();
+    create_swapchain_semaphores();
+    m_images_in_flight.assign(m_sch_images.size(), VK_NULL_HANDLE);
+
+    VkDevice device = m_device;
+    m_deletion_queue.push(m_frame_counter, [device, old_swapchain, old_image_views, release_targets, old_semaphores]()
+    {
+        release_targets();
+        for (const auto& image_view : old_image_views)
+        {
+            vkDestroyImageView(device, image_view, nullptr);
+        }
+        for (const auto& semaphore : old_semaphores)
+        {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        vkDestroySwapchainKHR(device, old_swapchain, nullptr);
+    });
+
+    m_swapchain_dirty = false;
+    ++m_swapchain_recreations;
+    return true;
+}
+
+void HelloTriangleApplication::create_offscreen_targets()
+{
+    /**
+      * Headless replacement of the swapchain: one color image per frame in flight,
+      * so frames never wait for each other's render target. Images are left in
+      * TRANSFER_SRC layout by the render pass, ready to be read back.
+      **/
+    m_sch_image_format = VK_FORMAT_B8G8R8A8_UNORM;
+    m_sch_extent = {WINDOW_WIDTH, WINDOW_HEIGHT};
+    m_sch_images.resize(m_settings.m_frames_in_flight);
+    m_offscreen_memory.resize(m_settings.m_frames_in_flight);
+
+    for (size_t i = 0; i < m_sch_images.size(); ++i)
+    {
+        VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = m_sch_image_format;
+        image_info.extent = {m_sch_extent.width, m_sch_extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(m_device, &image_info, nullptr, &m_sch_images[i]) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create offscreen image!");
+        }
+
+        m_offscreen_memory[i] = m_memory_allocator.allocate_for_image(m_sch_images[i], MemoryUsage::GpuOnly);
+    }
+}
+
 void HelloTriangleApplication::create_image_views()
 {
     m_sch_image_views.resize(m_sch_images.size());
@@ -360,307 +754,1574 @@ void HelloTriangleApplication::create_image_views()
 
 void HelloTriangleApplication::create_graphics_pipeline()
 {
-    auto vert_module = create_shader_module("shaders/Triangle_vert.spv");
-    auto frag_module = create_shader_module("shaders/Triangle_frag.spv");
-
-    VkPipelineShaderStageCreateInfo shader_stages[2] = {};
-    VkPipelineShaderStageCreateInfo* vertex_shader_info = &(shader_stages[0]);
-    VkPipelineShaderStageCreateInfo* fragment_shader_info = &(shader_stages[1]);
-
-    vertex_shader_info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_shader_info->stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_info->module = vert_module;
-    vertex_shader_info->pName = "main";
-
-    fragment_shader_info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragment_shader_info->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_shader_info->module = frag_module;
-    fragment_shader_info->pName = "main";
-
-    VkPipelineVertexInputStateCreateInfo vertext_input_info = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertext_input_info.vertexBindingDescriptionCount = 0;
-    vertext_input_info.pVertexBindingDescriptions = nullptr;
-    vertext_input_info.vertexAttributeDescriptionCount = 0;
-    vertext_input_info.pVertexAttributeDescriptions = nullptr;
-
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
-    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly_info.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) m_sch_extent.width;
-    viewport.height = (float) m_sch_extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 0.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0,0};
-    scissor.extent = m_sch_extent;
-
-    VkPipelineViewportStateCreateInfo viewport_state = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
-    viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
-    viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-    rasterizer.depthBiasClamp = 0.0f; // Optional
-    rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-    VkPipelineMultisampleStateCreateInfo multisampling = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading = 1.0f; // Optional
-    multisampling.pSampleMask = nullptr; // Optional
-    multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-    multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
-    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment.blendEnable = VK_FALSE;
-    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-    VkPipelineColorBlendStateCreateInfo color_blending = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
-    color_blending.logicOpEnable = VK_FALSE;
-    color_blending.logicOp = VK_LOGIC_OP_COPY; // Optional
-    color_blending.attachmentCount = 1;
-    color_blending.pAttachments = &color_blend_attachment;
-    color_blending.blendConstants[0] = 0.0f; // Optional
-    color_blending.blendConstants[1] = 0.0f; // Optional
-    color_blending.blendConstants[2] = 0.0f; // Optional
-    color_blending.blendConstants[3] = 0.0f; // Optional
-
-    VkDynamicState dynamic_states[] =
-    {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_LINE_WIDTH
-    };
-
-    VkPipelineDynamicStateCreateInfo dynamic_state_info = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
-    dynamic_state_info.dynamicStateCount = 2;
-    dynamic_state_info.pDynamicStates = dynamic_states;
-
+    // set 0 - per frame uniforms, addressed with dynamic offset; push constants - per draw data
+    VkDescriptorSetLayout set_layout = m_uniform_ring.set_layout();
+    VkPushConstantRange push_constants = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants)};
     VkPipelineLayoutCreateInfo pipeline_layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    pipeline_layout_info.setLayoutCount = 0; // Optional
-    pipeline_layout_info.pSetLayouts = nullptr; // Optional
-    pipeline_layout_info.pushConstantRangeCount = 0; // Optional
-    pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constants;
 
     if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
     {
         throw runtime_error("failed to create pipeline layout!");
     }
 
-    VkGraphicsPipelineCreateInfo pipeline_info = {};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = shader_stages;
-    pipeline_info.pVertexInputState = &vertext_input_info;
-    pipeline_info.pInputAssemblyState = &input_assembly_info;
-    pipeline_info.pViewportState = &viewport_state;
-    pipeline_info.pRasterizationState = &rasterizer;
-    pipeline_info.pMultisampleState = &multisampling;
-    pipeline_info.pDepthStencilState = nullptr; // Optional
-    pipeline_info.pColorBlendState = &color_blending;
-    pipeline_info.pDynamicState = nullptr; // Optional
-    pipeline_info.layout = m_pipeline_layout;
-    pipeline_info.renderPass = m_render_pass;
-    pipeline_info.subpass = 0;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
-    pipeline_info.basePipelineIndex = -1; // Optional
-    /**
-      * you could specify another pipeline, and switch with existing as you wish.
-      * use basePipelineHandle or basePipelineIndex. flags should be set to
-      * VK_PIPELINE_CREATE_DERIVATIVE_BIT
-      **/
+    m_pipeline = create_pipeline(scene_pipeline_description(false));
 
-    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline) != VK_SUCCESS)
+    if (m_settings.m_post_process)
     {
-        throw runtime_error("Failed to create ppeline!");
-    }
-
-    vkDestroyShaderModule(m_device, vert_module, nullptr);
-    vkDestroyShaderModule(m_device, frag_module, nullptr);
-}
-
-void HelloTriangleApplication::create_render_pass()
-{
-    VkAttachmentDescription attachment_description = {};
-    attachment_description.format = m_sch_image_format;
-    attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment_description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference attachment_ref = {};
-    attachment_ref.attachment = 0;
-    attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        // fullscreen triangle is generated from vertex index, scene color is read with subpassLoad
+        m_post_set_layout = m_descriptors.layout({{0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}});
+        VkPipelineLayoutCreateInfo post_layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        post_layout_info.setLayoutCount = 1;
+        post_layout_info.pSetLayouts = &m_post_set_layout;
+        if (vkCreatePipelineLayout(m_device, &post_layout_info, nullptr, &m_post_pipeline_layout) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create post process pipeline layout!");
+        }
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &attachment_ref;
+        auto post_description = pipeline_description("Post_vert", "Post_frag", "post_process");
+        post_description.m_layout = m_post_pipeline_layout;
+        m_post_pipeline = create_pipeline(post_description);
+    }
 
-    VkRenderPassCreateInfo render_pass_info = {};
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &attachment_description;
-    render_pass_info.subpassCount = 1;
-    render_pass_info.pSubpasses = &subpass;
+    if (m_particles != nullptr)
+    {
+        auto particle_attributes = ParticleSystem::attribute_descriptions();
+        auto particle_description = pipeline_description("Particle_vert", "Triangle_frag");
+        particle_description.m_bindings = {ParticleSystem::binding_description()};
+        particle_description.m_attributes.assign(particle_attributes.begin(), particle_attributes.end());
+        particle_description.m_topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        m_particle_pipeline = create_pipeline(particle_description);
+    }
 
-    if (vkCreateRenderPass(m_device, &render_pass_info, nullptr, &m_render_pass) != VK_SUCCESS)
+    if (!is_instancing_enabled())
     {
-        throw runtime_error("failed to create render pass!");
+        return;
     }
+
+    m_instanced_pipeline = create_pipeline(scene_pipeline_description(true));
 }
 
-void HelloTriangleApplication::create_framebuffers()
+PipelineDescription HelloTriangleApplication::pipeline_description(const string& vertex_shader, const string& fragment_shader,
+                                                                   const string& pass) const
 {
-    m_sch_framebuffers.resize(m_sch_image_views.size());
-    for (int i = 0; i < m_sch_image_views.size(); ++i)
-    {
-        VkFramebufferCreateInfo create_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-        create_info.renderPass = m_render_pass;
-        create_info.attachmentCount = 1;
-        create_info.pAttachments = &(m_sch_image_views[i]);
-        create_info.width = m_sch_extent.width;
-        create_info.height = m_sch_extent.height;
-        create_info.layers = 1;
+    PipelineDescription description;
+    description.m_vertex_shader = vertex_shader;
+    description.m_fragment_shader = fragment_shader;
+    description.m_layout = m_pipeline_layout;
+    description.m_render_pass = m_render_graph.render_pass(pass);
+    description.m_subpass = m_render_graph.subpass(pass);
+    return description;
+}
 
-        if (vkCreateFramebuffer(m_device, &create_info, nullptr,&(m_sch_framebuffers[i]) ) != VK_SUCCESS)
+PipelineDescription HelloTriangleApplication::scene_pipeline_description(bool instanced) const
+{
+    auto attribute_descriptions = Vertex::attribute_descriptions();
+    auto description = pipeline_description(instanced ? "Instanced_vert" : "Triangle_vert", "Triangle_frag");
+    description.m_bindings = {Vertex::binding_description()};
+    description.m_attributes.assign(attribute_descriptions.begin(), attribute_descriptions.end());
+    if (instanced)
+    {
+        // per vertex binding followed by per instance streams
+        for (const auto& binding : InstanceArrays::binding_descriptions())
+        {
+            description.m_bindings.push_back(binding);
+        }
+        for (const auto& attribute : InstanceArrays::attribute_descriptions())
         {
-            throw runtime_error("Failed to create framebuffer!");
+            description.m_attributes.push_back(attribute);
         }
     }
+    return description;
 }
 
-void HelloTriangleApplication::execute_main_loop()
+const PipelineRegistry::Slot* HelloTriangleApplication::create_pipeline(const PipelineDescription& description)
 {
-    while (!glfwWindowShouldClose(m_window))
+    const PipelineRegistry::Slot* pipeline;
+    auto creation_start = chrono::steady_clock::now();
     {
-        glfwPollEvents();
+        ScopedTimer timer(m_startup_timings, "vkCreateGraphicsPipelines " + description.m_vertex_shader);
+        pipeline = &m_pipelines.slot(description);
     }
+    auto creation_time = chrono::duration<double, milli>(chrono::steady_clock::now() - creation_start).count();
+    cout << "Graphics pipeline " << description.m_vertex_shader << " created in " << creation_time << " ms ("
+         << (m_pipeline_cache.is_warm() ? "warm" : "cold") << " pipeline cache)" << endl;
+    return pipeline;
 }
 
-void HelloTriangleApplication::cleanup()
+VkPipeline HelloTriangleApplication::create_compute_pipeline(const string& shader, VkPipelineLayout layout)
 {
-    for (const auto& framebuffer : m_sch_framebuffers)
+    VkComputePipelineCreateInfo pipeline_info = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader_module(shader);
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout;
+
+    VkPipeline pipeline;
+    ScopedTimer timer(m_startup_timings, "vkCreateComputePipelines " + shader);
+    if (vkCreateComputePipelines(m_device, m_pipeline_cache.handle(), 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
     {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+        throw runtime_error("Failed to create compute pipeline!");
     }
-    vkDestroyPipeline(m_device, m_pipeline,nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
-    vkDestroyRenderPass(m_device, m_render_pass, nullptr);
-    for (const auto& image_view : m_sch_image_views)
+    return pipeline;
+}
+
+void HelloTriangleApplication::create_compute_scheduler(bool async)
+{
+    bool is_async = async && m_queue_families.m_compute_family.has_value();
+    if (is_async)
     {
-        vkDestroyImageView(m_device, image_view, nullptr);
+        m_compute_scheduler.create(m_gpu, m_device, m_compute_queue, m_queue_families.m_compute_family.value(),
+                                   static_cast<uint32_t>(m_frames.size()), true);
     }
-    vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
-    vkDestroyDevice(m_device, nullptr);
-    if (ENABLE_VALIDATION_LAYERS)
+    else
     {
-        destroy_debug_utils_messenger_EXT(m_instance, m_callback, nullptr);
+        m_compute_scheduler.create(m_gpu, m_device, m_graphical_queue, m_queue_families.m_graphics_family.value(),
+                                   static_cast<uint32_t>(m_frames.size()), false);
     }
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
-    vkDestroyInstance(m_instance, nullptr);
-
-    glfwDestroyWindow(m_window);
-    glfwTerminate();
 }
 
-void HelloTriangleApplication::create_VK_instance()
+void HelloTriangleApplication::create_render_graph()
 {
-    if (ENABLE_VALIDATION_LAYERS && !check_validation_layers_support())
-    {
-        throw runtime_error("validation layers requested, but not available!");
-    }
-
-    VkApplicationInfo app_info = {};
-    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    app_info.pApplicationName = "Hello Triangle";
-    app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.pEngineName = "No Engine";
-    app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
-
-    VkInstanceCreateInfo create_info = {};
-    create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    create_info.pApplicationInfo = &app_info;
-
-    auto extensions = get_required_extensions();
-    create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-    create_info.ppEnabledExtensionNames = extensions.data();
+    VkClearValue clear_color = {};
+    clear_color.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    m_render_graph.import_attachment("swapchain", m_sch_image_format,
+                                     m_settings.m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                           : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                     clear_color);
 
-    if (ENABLE_VALIDATION_LAYERS) 
+    /**
+      * With post process scene is drawn into an intermediate attachment, which post process
+      * reads at the same pixel. Both passes are subpasses of one render pass, so the scene
+      * color never leaves tile memory on tilers.
+      **/
+    string scene_target = "swapchain";
+    if (m_settings.m_post_process)
     {
-        create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
-        create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+        scene_target = "scene_color";
+        m_render_graph.add_attachment(scene_target, m_sch_image_format, false, clear_color);
     }
-    else 
+    m_render_graph.add_pass({"scene", {scene_target}, "", {}, {},
+                             [this](VkCommandBuffer command_buffer, uint32_t image_index)
+                             {
+                                 record_scene(command_buffer, image_index);
+                             }});
+    if (m_settings.m_post_process)
     {
-        create_info.enabledLayerCount = 0;
+        m_render_graph.add_pass({"post_process", {"swapchain"}, "", {scene_target}, {},
+                                 [this](VkCommandBuffer command_buffer, uint32_t)
+                                 {
+                                     record_post_process(command_buffer);
+                                 }});
     }
-
-    auto result = vkCreateInstance(&create_info, nullptr, &m_instance);
-
-    if (result != VK_SUCCESS)
-        throw runtime_error("Failed to create Instance! Stupid...\n");
+    m_render_graph.compile(m_device);
 }
 
-bool HelloTriangleApplication::check_validation_layers_support()
+void HelloTriangleApplication::create_render_targets()
 {
-    uint32_t layers_count;
-    vkEnumerateInstanceLayerProperties(&layers_count, nullptr);
+    m_render_graph.create_targets(m_memory_allocator, m_sch_extent, {{"swapchain", m_sch_image_views}});
+}
 
-    vector<VkLayerProperties> available_layers(layers_count);
+void HelloTriangleApplication::create_frame_resources()
+{
+    m_recording_threads = m_settings.m_recording_threads;
+    m_max_recording_threads = m_settings.m_benchmark == BenchmarkMode::Recording
+                            ? min(ThreadPool::hardware_threads(), MAX_RECORDING_THREADS)
+                            : m_recording_threads;
+    if (m_max_recording_threads > 1)
+    {
+        // main thread records too
+        m_thread_pool = make_unique<ThreadPool>(m_max_recording_threads - 1);
+    }
 
-    vkEnumerateInstanceLayerProperties(&layers_count, available_layers.data());
+    m_frames.resize(m_settings.m_frames_in_flight);
 
-    for (const char* layer_name : VALIDATION_LAYERS) {
-        bool layer_found = false;
+    for (auto& frame : m_frames)
+    {
+        VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = m_queue_families.m_graphics_family.value();
 
-        for (const auto& layer_properties : available_layers) {
-            if (strcmp(layer_name, layer_properties.layerName) == 0) {
-                layer_found = true;
-                break;
-            }
+        if (vkCreateCommandPool(m_device, &pool_info, nullptr, &frame.m_command_pool) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create command pool!");
         }
 
-        if (!layer_found) {
-            return false;
+        VkCommandBufferAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocate_info.commandPool = frame.m_command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(m_device, &allocate_info, &frame.m_command_buffer) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to allocate command buffer!");
         }
-    }
 
-    return true;
-}
+        VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // first wait on the frame should not block
 
-bool HelloTriangleApplication::check_device_suitability(VkPhysicalDevice device)
-{
-    auto indeces = find_queue_families(device);
+        if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &frame.m_image_available) != VK_SUCCESS ||
+            vkCreateFence(m_device, &fence_info, nullptr, &frame.m_in_flight_fence) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create frame synchronization objects!");
+        }
 
-    bool extension_supported = check_device_extensions_support(device);
+        frame.m_worker_pools.resize(m_max_recording_threads);
+        frame.m_secondary_buffers.resize(m_max_recording_threads);
+        for (uint32_t worker = 0; worker < m_max_recording_threads; ++worker)
+        {
+            if (vkCreateCommandPool(m_device, &pool_info, nullptr, &frame.m_worker_pools[worker]) != VK_SUCCESS)
+            {
+                throw runtime_error("Failed to create command pool!");
+            }
+
+            allocate_info.commandPool = frame.m_worker_pools[worker];
+            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (vkAllocateCommandBuffers(m_device, &allocate_info, &frame.m_secondary_buffers[worker]) != VK_SUCCESS)
+            {
+                throw runtime_error("Failed to allocate command buffer!");
+            }
+        }
+    }
+
+    create_swapchain_semaphores();
+    m_images_in_flight.assign(m_sch_images.size(), VK_NULL_HANDLE);
+}
+
+void HelloTriangleApplication::create_swapchain_semaphores()
+{
+    /**
+      * Render finished semaphore is waited by presentation engine, which gives no
+      * signal when it is done with it. Keep one per swapchain image, as image
+      * can't be acquired again until its previous present is finished.
+      **/
+    m_render_finished.resize(m_settings.m_headless ? 0 : m_sch_images.size());
+    for (auto& semaphore : m_render_finished)
+    {
+        VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &semaphore) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create frame synchronization objects!");
+        }
+    }
+}
+
+void HelloTriangleApplication::create_geometry_buffers()
+{
+    vector<Vertex> vertices;
+    vector<uint32_t> indices;
+
+    if (m_settings.m_streamed_triangles == 0)
+    {
+        vertices =
+        {
+            {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+        };
+        indices = {0, 1, 2};
+        for (const auto& vertex : vertices)
+        {
+            m_mesh_radius = max(m_mesh_radius, sqrt(vertex.m_position.x * vertex.m_position.x +
+                                                    vertex.m_position.y * vertex.m_position.y));
+        }
+    }
+    else
+    {
+        // vertices are generated and uploaded every frame, indices stay the same
+        m_streamed_vertices.resize(static_cast<size_t>(m_settings.m_streamed_triangles) * 3);
+        m_mesh_radius = sqrt(2.0f); // triangles move over the whole viewport
+
+        indices.resize(m_streamed_vertices.size());
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            indices[i] = static_cast<uint32_t>(i);
+        }
+    }
+
+    VkDeviceSize vertex_buffer_size = sizeof(Vertex) * max(vertices.size(), m_streamed_vertices.size());
+    VkDeviceSize index_buffer_size = sizeof(uint32_t) * indices.size();
+
+    m_vertex_buffer = m_memory_allocator.create_buffer(vertex_buffer_size,
+                                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                       MemoryUsage::GpuOnly);
+    m_index_buffer = m_memory_allocator.create_buffer(index_buffer_size,
+                                                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                      MemoryUsage::GpuOnly);
+    m_index_count = static_cast<uint32_t>(indices.size());
+
+    // copies are done before the first frame uses the buffers
+    if (!vertices.empty())
+    {
+        upload_static_data(m_vertex_buffer.m_buffer, 0, vertices.data(), vertex_buffer_size);
+    }
+    upload_static_data(m_index_buffer.m_buffer, 0, indices.data(), index_buffer_size);
+}
+
+void HelloTriangleApplication::upload_static_data(VkBuffer destination, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+    if (m_upload_service != nullptr)
+    {
+        m_upload_service->upload(destination, offset, data, size);
+    }
+    else
+    {
+        m_staging_ring.upload(destination, offset, data, size);
+    }
+}
+
+void HelloTriangleApplication::update_streamed_geometry()
+{
+    // spinning triangles on a grid, which covers the whole viewport
+    auto triangles_count = static_cast<uint32_t>(m_streamed_vertices.size() / 3);
+    auto grid_size = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(triangles_count))));
+    float cell_size = 2.0f / static_cast<float>(grid_size);
+    float radius = cell_size * 0.45f;
+    float time = static_cast<float>(m_frame_counter) * 0.02f;
+
+    for (uint32_t i = 0; i < triangles_count; ++i)
+    {
+        glm::vec2 center = {-1.0f + cell_size * (static_cast<float>(i % grid_size) + 0.5f),
+                            -1.0f + cell_size * (static_cast<float>(i / grid_size) + 0.5f)};
+        float angle = time + static_cast<float>(i) * 0.1f;
+
+        for (uint32_t corner = 0; corner < 3; ++corner)
+        {
+            float corner_angle = angle + static_cast<float>(corner) * 2.0943951f; // 2 * pi / 3
+            Vertex& vertex = m_streamed_vertices[i * 3 + corner];
+            vertex.m_position = center + radius * glm::vec2(cos(corner_angle), sin(corner_angle));
+            vertex.m_color = {corner == 0 ? 1.0f : 0.0f, corner == 1 ? 1.0f : 0.0f, corner == 2 ? 1.0f : 0.0f};
+        }
+    }
+
+    m_staging_ring.upload(m_vertex_buffer.m_buffer, 0, m_streamed_vertices.data(),
+                          sizeof(Vertex) * m_streamed_vertices.size());
+}
+
+void HelloTriangleApplication::create_instance_buffer(uint32_t instances_count, float extent)
+{
+    // previous instance buffer should not be used by GPU anymore
+    m_memory_allocator.destroy_buffer(m_instance_buffer);
+
+    InstanceArrays instances;
+    instances.resize(instances_count);
+
+    // one instance per grid cell, whole grid covers the viewport (scaled by extent)
+    auto grid_size = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(instances_count))));
+    float cell_size = 2.0f * extent / static_cast<float>(grid_size);
+
+    for (uint32_t i = 0; i < instances_count; ++i)
+    {
+        instances.m_offsets[i] = {-extent + cell_size * (static_cast<float>(i % grid_size) + 0.5f),
+                                  -extent + cell_size * (static_cast<float>(i / grid_size) + 0.5f)};
+        instances.m_scales[i] = cell_size;
+
+        // bright pseudo random color, alpha in the highest byte
+        uint32_t hash = i * 2654435761u;
+        instances.m_colors[i] = hash | 0xFF404040u;
+    }
+
+    m_instance_buffer = m_memory_allocator.create_buffer(instances.total_bytes(),
+                                                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                         MemoryUsage::GpuOnly);
+    m_instance_stream_offsets = instances.stream_offsets();
+    m_instances_count = instances_count;
+
+    upload_static_data(m_instance_buffer.m_buffer, m_instance_stream_offsets[0],
+                       instances.m_offsets.data(), sizeof(glm::vec2) * instances_count);
+    upload_static_data(m_instance_buffer.m_buffer, m_instance_stream_offsets[1],
+                       instances.m_scales.data(), sizeof(float) * instances_count);
+    upload_static_data(m_instance_buffer.m_buffer, m_instance_stream_offsets[2],
+                       instances.m_colors.data(), sizeof(uint32_t) * instances_count);
+
+    if (is_gpu_driven_enabled())
+    {
+        m_instance_arrays = move(instances);
+    }
+}
+
+void HelloTriangleApplication::create_particle_system()
+{
+    if (m_settings.m_particles_count == 0)
+    {
+        return;
+    }
+
+    // compute queue may be switched between graphics and async family (compute benchmark)
+    vector<uint32_t> queue_families = {m_queue_families.m_graphics_family.value()};
+    if (m_queue_families.m_compute_family.has_value())
+    {
+        queue_families.push_back(m_queue_families.m_compute_family.value());
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_gpu, &properties);
+
+    m_particles = make_unique<ParticleSystem>();
+    m_particles->create(m_device, m_descriptors, m_memory_allocator, m_settings.m_particles_count,
+                        static_cast<uint32_t>(m_frames.size()), queue_families, properties.limits);
+    m_particles->set_simulation_pipeline(create_compute_pipeline("Particles_comp", m_particles->simulation_layout()));
+}
+
+bool HelloTriangleApplication::is_gpu_driven_enabled() const
+{
+    return m_settings.m_gpu_driven || m_settings.m_benchmark == BenchmarkMode::Indirect;
+}
+
+void HelloTriangleApplication::create_indirect_draw_list()
+{
+    if (!is_gpu_driven_enabled())
+    {
+        return;
+    }
+    // instance attributes of an object start at its first instance, indirect commands can't say it without the feature
+    if (is_instancing_enabled() && !m_draw_indirect_first_instance)
+    {
+        cout << "GPU driven drawing of instances needs drawIndirectFirstInstance, draw list is recorded directly" << endl;
+        return;
+    }
+
+    m_indirect_draws = make_unique<IndirectDrawList>();
+    m_indirect_draws->create(m_device, m_descriptors);
+    m_indirect_draws->set_pipeline(create_compute_pipeline("Cull_comp", m_indirect_draws->pipeline_layout()));
+    update_indirect_objects();
+    cout << "GPU driven drawing, " << (m_multi_draw_indirect ? "one multi draw indirect call"
+                                                             : "one indirect call per object (no multiDrawIndirect)") << endl;
+}
+
+void HelloTriangleApplication::update_indirect_objects()
+{
+    vector<IndirectDrawList::Object> objects(m_draw_list.size());
+    for (size_t i = 0; i < m_draw_list.size(); ++i)
+    {
+        const auto& draw = m_draw_list[i];
+
+        // bounding box of all instances of the draw, mesh without instances stays around the origin
+        glm::vec2 low = {-m_mesh_radius, -m_mesh_radius};
+        glm::vec2 high = {m_mesh_radius, m_mesh_radius};
+        if (m_instances_count > 0)
+        {
+            low = {numeric_limits<float>::max(), numeric_limits<float>::max()};
+            high = {numeric_limits<float>::lowest(), numeric_limits<float>::lowest()};
+            for (uint32_t instance = draw.m_first_instance; instance < draw.m_first_instance + draw.m_instances_count; ++instance)
+            {
+                const auto& offset = m_instance_arrays.m_offsets[instance];
+                float radius = m_mesh_radius * m_instance_arrays.m_scales[instance];
+                low = {min(low.x, offset.x - radius), min(low.y, offset.y - radius)};
+                high = {max(high.x, offset.x + radius), max(high.y, offset.y + radius)};
+            }
+        }
+
+        // circle around the box, animated vertices move up to the amplitude away from it
+        float animation = m_settings.m_animate ? ANIMATION_AMPLITUDE : 0.0f;
+        objects[i] = {draw.m_index_count, draw.m_first_index, draw.m_first_instance, draw.m_instances_count,
+                      {(low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f},
+                      0.5f * sqrt((high.x - low.x) * (high.x - low.x) + (high.y - low.y) * (high.y - low.y)) + animation,
+                      0.0f};
+    }
+
+    VkBuffer objects_buffer = m_indirect_draws->resize(m_memory_allocator, static_cast<uint32_t>(objects.size()));
+    upload_static_data(objects_buffer, 0, objects.data(), sizeof(IndirectDrawList::Object) * objects.size());
+}
+
+bool HelloTriangleApplication::is_instancing_enabled() const
+{
+    return m_settings.m_instances_count > 0 || m_settings.m_benchmark != BenchmarkMode::None;
+}
+
+void HelloTriangleApplication::build_draw_list(uint32_t draws_count)
+{
+    // draws split instances if there are any, triangles of the mesh otherwise
+    uint32_t units_count = m_instances_count > 0 ? m_instances_count : m_index_count / 3;
+
+    m_draw_list.clear();
+    m_draw_list.reserve(draws_count);
+    for (uint32_t i = 0; i < draws_count; ++i)
+    {
+        auto first = static_cast<uint32_t>(static_cast<uint64_t>(units_count) * i / draws_count);
+        auto end = static_cast<uint32_t>(static_cast<uint64_t>(units_count) * (i + 1) / draws_count);
+        if (first == end)
+        {
+            // more draws than units - units are drawn again
+            first = i % units_count;
+            end = first + 1;
+        }
+
+        if (m_instances_count > 0)
+        {
+            m_draw_list.push_back({0, m_index_count, first, end - first});
+        }
+        else
+        {
+            m_draw_list.push_back({first * 3, (end - first) * 3, 0, 1});
+        }
+    }
+
+    if (m_indirect_draws != nullptr)
+    {
+        update_indirect_objects();
+    }
+}
+
+void HelloTriangleApplication::execute_main_loop()
+{
+    if (m_settings.m_benchmark == BenchmarkMode::Instancing)
+    {
+        run_instancing_benchmark();
+        vkDeviceWaitIdle(m_device);
+    }
+    else if (m_settings.m_benchmark == BenchmarkMode::Recording)
+    {
+        run_recording_benchmark();
+        vkDeviceWaitIdle(m_device);
+    }
+    else if (m_settings.m_benchmark == BenchmarkMode::Compute)
+    {
+        run_compute_benchmark();
+        vkDeviceWaitIdle(m_device);
+    }
+    else if (m_settings.m_benchmark == BenchmarkMode::Indirect)
+    {
+        run_indirect_benchmark();
+        vkDeviceWaitIdle(m_device);
+    }
+    else if (m_settings.m_benchmark == BenchmarkMode::Pipelines)
+    {
+        run_pipeline_benchmark();
+    }
+    else
+    {
+        render_frames(m_settings.m_frame_limit, m_frame_statistics);
+        vkDeviceWaitIdle(m_device);
+
+        m_frame_statistics.print_report(cout, string(m_settings.m_headless ? "Headless frame" : "Frame") + " times, " +
+                                              to_string(m_settings.m_frames_in_flight) + " frame(s) in flight");
+        m_recording_statistics.print_report(cout, "Command recording times, " + to_string(m_draw_list.size()) + " draw(s), " +
+                                                  (m_recording_threads == 0 ? string("inline")
+                                                                            : to_string(m_recording_threads) + " thread(s)"));
+        m_frame_pacer.print_report(cout);
+    }
+    m_gpu_profiler.print_report(cout);
+    m_compute_scheduler.profiler().print_report(cout, m_compute_scheduler.is_async() ? "Async compute GPU scopes"
+                                                                                     : "Compute GPU scopes");
+    if (!m_settings.m_gpu_trace_path.empty())
+    {
+        m_gpu_profiler.write_chrome_trace(m_settings.m_gpu_trace_path);
+    }
+    m_staging_ring.print_statistics(cout);
+    if (m_upload_service != nullptr)
+    {
+        m_upload_service->print_statistics(cout);
+    }
+    m_descriptors.print_statistics(cout);
+    m_uniform_ring.print_statistics(cout);
+    m_pipelines.print_statistics(cout);
+    if (m_shader_watcher != nullptr)
+    {
+        cout << "Hot reload: " << m_shader_watcher->compiled_count() << " shader(s) recompiled, "
+             << m_shader_watcher->failed_count() << " failed" << endl;
+    }
+    if (m_swapchain_recreations > 0)
+    {
+        cout << "Swapchain recreated " << m_swapchain_recreations << " time(s)" << endl;
+    }
+}
+
+void HelloTriangleApplication::run_recording_benchmark()
+{
+    uint32_t draws_count = m_settings.m_draws_count != 0 ? m_settings.m_draws_count : DEFAULT_RECORDING_BENCHMARK_DRAWS;
+    uint64_t frames_per_step = m_settings.m_frame_limit != 0 ? m_settings.m_frame_limit : DEFAULT_BENCHMARK_FRAMES;
+    uint64_t warmup_frames = m_settings.m_frames_in_flight + 2;
+
+    // one instance per draw call, so GPU work is small and CPU recording dominates
+    vkDeviceWaitIdle(m_device);
+    create_instance_buffer(draws_count);
+    build_draw_list(draws_count);
+
+    // 0 - inline recording into primary command buffer
+    vector<uint32_t> threads_counts = {0};
+    for (uint32_t threads = 1; threads < m_max_recording_threads; threads *= 2)
+    {
+        threads_counts.push_back(threads);
+    }
+    threads_counts.push_back(m_max_recording_threads);
+
+    cout << "Recording benchmark, " << draws_count << " draws, " << frames_per_step << " frames per step:" << endl
+         << setw(10) << "threads" << setw(16) << "record avg ms" << setw(16) << "record p99 ms"
+         << setw(16) << "frame avg ms" << setw(12) << "speedup" << endl;
+
+    double inline_recording_ms = 0.0;
+    for (auto threads : threads_counts)
+    {
+        m_recording_threads = threads;
+
+        FrameStatistics warmup_statistics;
+        FrameStatistics statistics;
+        if (!render_frames(warmup_frames, warmup_statistics))
+        {
+            break;
+        }
+        m_recording_statistics.reset();
+        if (!render_frames(frames_per_step, statistics))
+        {
+            break;
+        }
+
+        double recording_ms = m_recording_statistics.average_ms();
+        if (threads == 0)
+        {
+            inline_recording_ms = recording_ms;
+        }
+
+        cout << fixed << setprecision(3)
+             << setw(10) << (threads == 0 ? string("inline") : to_string(threads))
+             << setw(16) << recording_ms << setw(16) << m_recording_statistics.percentile_ms(99.0)
+             << setw(16) << statistics.average_ms()
+             << setw(11) << (recording_ms > 0.0 ? inline_recording_ms / recording_ms : 0.0) << "x" << endl;
+        cout << defaultfloat;
+    }
+}
+
+void HelloTriangleApplication::run_compute_benchmark()
+{
+    uint64_t frames_per_step = m_settings.m_frame_limit != 0 ? m_settings.m_frame_limit : DEFAULT_BENCHMARK_FRAMES;
+    uint64_t warmup_frames = m_settings.m_frames_in_flight + 2;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_gpu, &properties);
+
+    ReductionKernel kernel;
+    kernel.create(m_device, m_descriptors, m_memory_allocator, m_settings.m_compute_elements, properties.limits);
+    kernel.set_pipeline(create_compute_pipeline("Reduce_comp", kernel.pipeline_layout()));
+    destroy_shader_modules();
+
+    // "none" - frame time without compute work
+    vector<string> steps = {"none", "graphics"};
+    if (m_queue_families.m_compute_family.has_value())
+    {
+        steps.push_back("async");
+    }
+
+    cout << "Compute benchmark, " << m_settings.m_compute_elements << " values, "
+         << COMPUTE_BENCHMARK_REDUCTIONS_PER_FRAME << " reductions per frame, " << frames_per_step << " frames per step"
+         << (m_queue_families.m_compute_family.has_value() ? "" : ", no async compute queue") << ":" << endl
+         << setw(12) << "compute" << setw(14) << "frame avg ms" << setw(14) << "p99 ms"
+         << setw(16) << "reductions/s" << setw(10) << "GB/s" << setw(10) << "result" << endl;
+
+    for (const auto& step : steps)
+    {
+        // buffers are used by one queue family at a time, values are generated again on the new queue
+        vkDeviceWaitIdle(m_device);
+        m_compute_scheduler.destroy();
+        create_compute_scheduler(step == "async");
+        m_reduction_kernel = step == "none" ? nullptr : &kernel;
+        m_reduction_fill_pending = true;
+
+        FrameStatistics warmup_statistics;
+        FrameStatistics statistics;
+        if (!render_frames(warmup_frames, warmup_statistics))
+        {
+            break;
+        }
+        auto start = chrono::steady_clock::now();
+        bool completed = render_frames(frames_per_step, statistics);
+        m_compute_scheduler.wait_idle();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!completed)
+        {
+            break;
+        }
+
+        double reductions_per_second = 0.0;
+        string result = "-";
+        if (m_reduction_kernel != nullptr)
+        {
+            reductions_per_second = frames_per_step * COMPUTE_BENCHMARK_REDUCTIONS_PER_FRAME / seconds;
+            result = kernel.read_result(m_memory_allocator) == kernel.expected_result() ? "ok" : "WRONG";
+        }
+
+        cout << fixed << setprecision(3)
+             << setw(12) << step << setw(14) << statistics.average_ms() << setw(14) << statistics.percentile_ms(99.0)
+             << setprecision(1) << setw(16) << reductions_per_second
+             << setprecision(2) << setw(10) << reductions_per_second * static_cast<double>(kernel.bytes_per_reduction()) / 1e9
+             << setw(10) << result << endl;
+        cout << defaultfloat;
+    }
+
+    vkDeviceWaitIdle(m_device);
+    m_compute_scheduler.wait_idle();
+    m_reduction_kernel = nullptr;
+    kernel.destroy(m_descriptors, m_memory_allocator);
+}
+
+void HelloTriangleApplication::run_indirect_benchmark()
+{
+    if (m_indirect_draws == nullptr)
+    {
+        cout << "Indirect benchmark is skipped, device does not support drawIndirectFirstInstance" << endl;
+        return;
+    }
+
+    const uint32_t objects_counts[] = {1000, 10000, 100000, 1000000};
+    uint64_t frames_per_step = m_settings.m_frame_limit != 0 ? m_settings.m_frame_limit : DEFAULT_BENCHMARK_FRAMES;
+    uint64_t warmup_frames = m_settings.m_frames_in_flight + 2;
+
+    // objects cover 4 times the viewport, so about 3/4 of them are culled by indirect path
+    constexpr float OBJECTS_EXTENT = 2.0f;
+
+    cout << "Indirect benchmark, one instance per object, " << frames_per_step << " frames per step, "
+         << (m_multi_draw_indirect ? "multi draw indirect" : "one indirect draw per object") << ":" << endl
+         << setw(10) << "objects" << setw(18) << "direct record ms" << setw(20) << "indirect record ms"
+         << setw(18) << "direct frame ms" << setw(20) << "indirect frame ms" << setw(12) << "speedup" << endl;
+
+    for (auto objects_count : objects_counts)
+    {
+        vkDeviceWaitIdle(m_device);
+        create_instance_buffer(objects_count, OBJECTS_EXTENT);
+        build_draw_list(objects_count);
+
+        double recording_ms[2] = {};
+        double frame_ms[2] = {};
+        bool completed = true;
+        for (int indirect = 0; indirect < 2 && completed; ++indirect)
+        {
+            m_gpu_driven = indirect != 0;
+
+            FrameStatistics warmup_statistics;
+            FrameStatistics statistics;
+            completed = render_frames(warmup_frames, warmup_statistics);
+            m_recording_statistics.reset();
+            completed = completed && render_frames(frames_per_step, statistics);
+
+            recording_ms[indirect] = m_recording_statistics.average_ms();
+            frame_ms[indirect] = statistics.average_ms();
+        }
+        if (!completed)
+        {
+            break;
+        }
+
+        cout << fixed << setprecision(3)
+             << setw(10) << objects_count << setw(18) << recording_ms[0] << setw(20) << recording_ms[1]
+             << setw(18) << frame_ms[0] << setw(20) << frame_ms[1]
+             << setw(11) << (recording_ms[1] > 0.0 ? recording_ms[0] / recording_ms[1] : 0.0) << "x" << endl;
+        cout << defaultfloat;
+    }
+    m_gpu_driven = m_settings.m_gpu_driven;
+}
+
+bool HelloTriangleApplication::render_frames(uint64_t frames_count, FrameStatistics& statistics)
+{
+    using clock = chrono::steady_clock;
+
+    // frames_count == 0 - until window is closed
+    auto previous_frame_end = clock::now();
+    for (uint64_t frame = 0; frames_count == 0 || frame < frames_count; ++frame)
+    {
+        if (!m_settings.m_headless && glfwWindowShouldClose(m_window))
+        {
+            return false;
+        }
+
+        m_frame_pacer.begin_frame();
+        if (!m_settings.m_headless)
+        {
+            glfwPollEvents();
+            m_frame_pacer.input_sampled();
+        }
+        draw_frame();
+        m_frame_pacer.end_frame();
+
+        auto frame_end = clock::now();
+        statistics.add_frame(chrono::duration<double, milli>(frame_end - previous_frame_end).count());
+        previous_frame_end = frame_end;
+    }
+    return true;
+}
+
+void HelloTriangleApplication::run_pipeline_benchmark()
+{
+    const VkPrimitiveTopology topologies[] = {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+                                              VK_PRIMITIVE_TOPOLOGY_LINE_LIST, VK_PRIMITIVE_TOPOLOGY_POINT_LIST};
+    const VkCullModeFlags cull_modes[] = {VK_CULL_MODE_NONE, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_BIT};
+    const VkFrontFace front_faces[] = {VK_FRONT_FACE_CLOCKWISE, VK_FRONT_FACE_COUNTER_CLOCKWISE};
+    constexpr uint32_t LOOKUP_ROUNDS = 10000;
+    constexpr uint64_t FRAMES_PER_MATERIAL = 4;
+
+    // variants of the scene pipeline, which differ only in fixed function state
+    auto scene_description = scene_pipeline_description(m_instances_count > 0);
+    vector<PipelineDescription> variants;
+    for (auto topology : topologies)
+    {
+        for (auto cull_mode : cull_modes)
+        {
+            for (auto front_face : front_faces)
+            {
+                for (int blending = 0; blending < 2; ++blending)
+                {
+                    variants.push_back(scene_description);
+                    variants.back().m_topology = topology;
+                    variants.back().m_cull_mode = cull_mode;
+                    variants.back().m_front_face = front_face;
+                    variants.back().m_alpha_blending = blending != 0;
+                }
+            }
+        }
+    }
+
+    // without pipeline cache, so every variant is compiled
+    cout << "Pipeline benchmark, " << variants.size() << " variants of one shader pair, no pipeline cache:" << endl
+         << setw(14) << "pipelines" << setw(12) << "created" << setw(14) << "creation ms"
+         << setw(16) << "ms per pipeline" << setw(14) << "lookup ns" << endl;
+    for (int derivatives = 0; derivatives < 2; ++derivatives)
+    {
+        PipelineRegistry registry;
+        registry.create(m_device, VK_NULL_HANDLE, [this](const string& name) { return shader_module(name); },
+                        derivatives != 0);
+        for (const auto& variant : variants)
+        {
+            registry.get(variant);
+        }
+        auto statistics = registry.statistics();
+
+        auto lookup_start = chrono::steady_clock::now();
+        for (uint32_t round = 0; round < LOOKUP_ROUNDS; ++round)
+        {
+            for (const auto& variant : variants)
+            {
+                registry.get(variant);
+            }
+        }
+        auto lookup_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - lookup_start).count() /
+                         (static_cast<double>(LOOKUP_ROUNDS) * variants.size());
+        registry.destroy();
+
+        cout << fixed << setprecision(3)
+             << setw(14) << (derivatives != 0 ? "derivatives" : "independent") << setw(12) << statistics.m_created
+             << setw(14) << statistics.m_creation_ms
+             << setw(16) << statistics.m_creation_ms / max(statistics.m_created, 1u)
+             << setw(14) << lookup_ns << endl;
+        cout << defaultfloat;
+    }
+
+    /**
+      * Every few frames a new material shows up. Created on the render thread it stalls
+      * the frame, compiled in background it costs nothing, the scene pipeline is drawn
+      * until the material is ready.
+      **/
+    cout << "Material streaming, new variant every " << FRAMES_PER_MATERIAL << " frames:" << endl
+         << setw(14) << "compilation" << setw(14) << "average ms" << setw(12) << "99% ms" << setw(12) << "max ms"
+         << setw(16) << "fallback draws" << setw(14) << "latency ms" << setw(16) << "max queue depth" << endl;
+    for (int async = 0; async < 2; ++async)
+    {
+        PipelineRegistry registry;
+        registry.create(m_device, VK_NULL_HANDLE, [this](const string& name) { return shader_module(name); });
+        m_material_pipelines = &registry;
+        m_async_materials = async != 0;
+
+        FrameStatistics statistics;
+        bool completed = true;
+        for (size_t i = 0; i < variants.size() && completed; ++i)
+        {
+            m_material = variants[i];
+            completed = render_frames(FRAMES_PER_MATERIAL, statistics);
+        }
+        vkDeviceWaitIdle(m_device);
+        m_material_pipelines = nullptr;
+        auto registry_statistics = registry.statistics();
+        registry.destroy();
+        if (!completed)
+        {
+            break;
+        }
+
+        cout << fixed << setprecision(3)
+             << setw(14) << (async != 0 ? "background" : "render thread") << setw(14) << statistics.average_ms()
+             << setw(12) << statistics.percentile_ms(99.0) << setw(12) << statistics.percentile_ms(100.0)
+             << setw(16) << registry_statistics.m_fallbacks
+             << setw(14) << registry_statistics.m_latency_ms / max(registry_statistics.m_async_compiles, 1u)
+             << setw(16) << registry_statistics.m_max_queue_depth << endl;
+        cout << defaultfloat;
+    }
+    m_async_materials = false;
+    destroy_shader_modules();
+}
+
+void HelloTriangleApplication::run_instancing_benchmark()
+{
+    const uint32_t instance_counts[] = {1000, 10000, 100000, 1000000, 10000000};
+    uint64_t frames_per_step = m_settings.m_frame_limit != 0 ? m_settings.m_frame_limit : DEFAULT_BENCHMARK_FRAMES;
+
+    // first frames of every step upload instance data and fill the frame queue
+    uint64_t warmup_frames = m_settings.m_frames_in_flight + 2;
+
+    cout << "Instancing benchmark, " << frames_per_step << " frames per step:" << endl
+         << setw(12) << "instances" << setw(12) << "avg ms" << setw(12) << "p99 ms"
+         << setw(12) << "fps" << setw(18) << "instances/s" << endl;
+
+    for (auto instances_count : instance_counts)
+    {
+        vkDeviceWaitIdle(m_device);
+        try
+        {
+            create_instance_buffer(instances_count);
+        }
+        catch (const runtime_error& error)
+        {
+            // 10M instances take 160 MB of device local memory, small devices stop at the previous step
+            cout << setw(12) << instances_count << "  skipped, " << error.what() << endl;
+            break;
+        }
+        build_draw_list(max(m_settings.m_draws_count, 1u));
+
+        FrameStatistics warmup_statistics;
+        FrameStatistics statistics;
+        if (!render_frames(warmup_frames, warmup_statistics) || !render_frames(frames_per_step, statistics))
+        {
+            break;
+        }
+
+        double fps = statistics.average_ms() > 0.0 ? 1000.0 / statistics.average_ms() : 0.0;
+        cout << fixed << setprecision(3)
+             << setw(12) << instances_count << setw(12) << statistics.average_ms() << setw(12) << statistics.percentile_ms(99.0)
+             << setw(12) << fps << setw(18) << setprecision(0) << fps * instances_count << endl;
+        cout << defaultfloat;
+    }
+}
+
+void HelloTriangleApplication::draw_frame()
+{
+    FrameResources& frame = m_frames[m_current_frame];
+
+    // waits until GPU is done with the frame, which used these resources m_frames.size() frames ago
+    vkWaitForFences(m_device, 1, &frame.m_in_flight_fence, VK_TRUE, numeric_limits<uint64_t>::max());
+    m_staging_ring.begin_frame(m_current_frame);
+    m_descriptors.begin_frame(m_current_frame);
+    m_uniform_ring.begin_frame(m_current_frame);
+    // results of the frame, which used this slot before, are ready as its fence is signaled
+    if (m_gpu_profiler.begin_frame(m_current_frame, m_frame_counter))
+    {
+        m_frame_pacer.add_gpu_frame_time(m_gpu_profiler.last_frame_time_ms());
+    }
+
+    // frames are completed in submission order, so everything up to the previous user of this frame slot is done
+    if (m_frame_counter >= m_frames.size())
+    {
+        m_deletion_queue.retire(m_frame_counter - m_frames.size());
+    }
+    update_hot_reload();
+
+    if (m_swapchain_dirty && !recreate_swapchain())
+    {
+        return;
+    }
+
+    // offscreen render target is owned by the frame, so there is nothing to acquire
+    uint32_t image_index = m_current_frame;
+    if (!m_settings.m_headless)
+    {
+        auto result = vkAcquireNextImageKHR(m_device, m_swapchain, numeric_limits<uint64_t>::max(),
+                                            frame.m_image_available, VK_NULL_HANDLE, &image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // nothing is signaled, frame is skipped and swapchain is recreated before the next one
+            m_swapchain_dirty = true;
+            return;
+        }
+        if (result == VK_SUBOPTIMAL_KHR)
+        {
+            // image is acquired and semaphore will be signaled, so the frame is still rendered and presented
+            m_swapchain_dirty = true;
+        }
+        else if (result != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to acquire swapchain image!");
+        }
+    }
+
+    // with more frames in flight than swapchain images, acquired image may still be rendered by another frame
+    if (m_images_in_flight[image_index] != VK_NULL_HANDLE && m_images_in_flight[image_index] != frame.m_in_flight_fence)
+    {
+        vkWaitForFences(m_device, 1, &m_images_in_flight[image_index], VK_TRUE, numeric_limits<uint64_t>::max());
+    }
+    m_images_in_flight[image_index] = frame.m_in_flight_fence;
+
+    vkResetFences(m_device, 1, &frame.m_in_flight_fence);
+    vkResetCommandPool(m_device, frame.m_command_pool, 0);
+    m_wait_semaphores.clear();
+    m_wait_stages.clear();
+    if (!m_settings.m_headless)
+    {
+        m_wait_semaphores.push_back(frame.m_image_available);
+        m_wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    submit_compute_work();
+    if (!m_streamed_vertices.empty())
+    {
+        update_streamed_geometry();
+    }
+
+    auto recording_start = chrono::steady_clock::now();
+    record_command_buffer(frame, image_index);
+    m_recording_statistics.add_frame(chrono::duration<double, milli>(chrono::steady_clock::now() - recording_start).count());
+    m_uniform_ring.end_frame(m_memory_allocator);
+
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame.m_command_buffer;
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(m_wait_semaphores.size());
+    submit_info.pWaitSemaphores = m_wait_semaphores.data();
+    submit_info.pWaitDstStageMask = m_wait_stages.data();
+    if (!m_settings.m_headless)
+    {
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &m_render_finished[image_index];
+    }
+
+    if (vkQueueSubmit(m_graphical_queue, 1, &submit_info, frame.m_in_flight_fence) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to submit draw command buffer!");
+    }
+    m_staging_ring.end_frame();
+    if (m_upload_service != nullptr)
+    {
+        m_upload_service->end_frame(frame.m_in_flight_fence);
+    }
+
+    if (!m_settings.m_headless)
+    {
+        present_image(image_index);
+    }
+
+    m_current_frame = (m_current_frame + 1) % static_cast<uint32_t>(m_frames.size());
+    ++m_frame_counter;
+}
+
+void HelloTriangleApplication::update_hot_reload()
+{
+    if (m_shader_watcher == nullptr)
+    {
+        return;
+    }
+
+    // frames in flight may still draw with replaced pipelines, they are destroyed once those frames retire
+    VkDevice device = m_device;
+    uint64_t last_use_frame = m_frame_counter;
+    auto swapped = m_pipelines.swap_rebuilt([this, device, last_use_frame](VkPipeline pipeline)
+    {
+        m_deletion_queue.push(last_use_frame, [device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+    });
+    if (swapped > 0)
+    {
+        cout << "Hot reload: " << swapped << " pipeline(s) replaced" << endl;
+    }
+
+    // modules are used by workers until the rebuild is done, newer changes wait for it
+    if (m_pipelines.is_rebuilding())
+    {
+        return;
+    }
+    destroy_shader_modules();
+
+    auto changed = m_shader_watcher->take_compiled();
+    if (changed.empty())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(m_shader_modules_mutex);
+        m_hot_shaders.insert(changed.begin(), changed.end());
+    }
+    m_pipelines.rebuild(changed);
+}
+
+void HelloTriangleApplication::submit_compute_work()
+{
+    if (m_reduction_kernel == nullptr && m_particles == nullptr)
+    {
+        return;
+    }
+
+    VkCommandBuffer command_buffer = m_compute_scheduler.begin_frame(m_current_frame, m_frame_counter);
+    GpuProfiler& profiler = m_compute_scheduler.profiler();
+    if (m_reduction_kernel != nullptr)
+    {
+        GpuProfiler::Scope reductions_scope(profiler, command_buffer, "Reductions");
+        if (m_reduction_fill_pending)
+        {
+            m_reduction_kernel->record_fill(command_buffer);
+            m_reduction_fill_pending = false;
+        }
+        for (uint32_t i = 0; i < COMPUTE_BENCHMARK_REDUCTIONS_PER_FRAME; ++i)
+        {
+            m_reduction_kernel->record_reduce(command_buffer);
+        }
+    }
+    if (m_particles != nullptr)
+    {
+        // long pauses (window is dragged, swapchain is recreated) are not integrated in one step
+        constexpr float MAX_SIMULATION_STEP = 1.0f / 30.0f;
+        auto now = chrono::steady_clock::now();
+        float delta_time = min(chrono::duration<float>(now - m_last_simulation).count(), MAX_SIMULATION_STEP);
+        m_last_simulation = now;
+
+        GpuProfiler::Scope simulation_scope(profiler, command_buffer, "Particle simulation");
+        m_particles->record_simulation(command_buffer, delta_time);
+    }
+
+    // only particles are read by the frame, reduction results are not waited for
+    VkSemaphore compute_finished = m_compute_scheduler.submit(m_current_frame, m_particles != nullptr);
+    if (compute_finished != VK_NULL_HANDLE)
+    {
+        m_wait_semaphores.push_back(compute_finished);
+        m_wait_stages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    }
+}
+
+void HelloTriangleApplication::present_image(uint32_t image_index)
+{
+    VkPresentInfoKHR present_info = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &m_render_finished[image_index];
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &m_swapchain;
+    present_info.pImageIndices = &image_index;
+
+    auto result = vkQueuePresentKHR(m_present_queue, &present_info);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    {
+        m_swapchain_dirty = true;
+    }
+    else if (result != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to present swapchain image!");
+    }
+}
+
+void HelloTriangleApplication::record_command_buffer(FrameResources& frame, uint32_t image_index)
+{
+    VkCommandBuffer command_buffer = frame.m_command_buffer;
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to begin recording command buffer!");
+    }
+
+    m_gpu_profiler.reset_queries(command_buffer);
+    uint32_t frame_scope = m_gpu_profiler.begin_scope(command_buffer, "Frame");
+
+    // bound by every recorder with this offset, so secondary command buffers see the same data
+    FrameUniforms frame_uniforms = {static_cast<float>(m_frame_counter) * 0.02f,
+                                    m_settings.m_animate ? ANIMATION_AMPLITUDE : 0.0f, {0.0f, 0.0f}};
+    m_frame_uniforms_offset = m_uniform_ring.push(frame_uniforms);
+
+    // GPU driven draw list is read by culling compute shader
+    VkPipelineStageFlags upload_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    VkAccessFlags upload_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    if (m_indirect_draws != nullptr)
+    {
+        upload_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        upload_access |= VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    // buffers uploaded on transfer queue are taken over by graphics queue
+    if (m_upload_service != nullptr)
+    {
+        m_upload_service->acquire(command_buffer, m_wait_semaphores, m_wait_stages, upload_stages, upload_access);
+    }
+
+    // uploads of this frame, copies should be outside of render pass
+    if (m_staging_ring.has_pending_copies())
+    {
+        GpuProfiler::Scope uploads_scope(m_gpu_profiler, command_buffer, "Uploads");
+        m_staging_ring.flush(command_buffer, upload_stages, upload_access);
+    }
+
+    bool indirect = m_gpu_driven && m_indirect_draws != nullptr;
+    if (indirect)
+    {
+        // there is no camera, so the view is the whole normalized device coordinates square
+        const float view_min[2] = {-1.0f, -1.0f};
+        const float view_max[2] = {1.0f, 1.0f};
+        GpuProfiler::Scope culling_scope(m_gpu_profiler, command_buffer, "Culling");
+        m_indirect_draws->record_culling(command_buffer, m_descriptors, view_min, view_max);
+    }
+
+    // render passes, their barriers and layout transitions come from the render graph
+    bool inline_scene = m_recording_threads == 0 || indirect;
+    m_render_graph.set_subpass_contents("scene", inline_scene ? VK_SUBPASS_CONTENTS_INLINE
+                                                              : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    uint32_t render_pass_scope = m_gpu_profiler.begin_scope(command_buffer, "Render pass");
+    m_render_graph.execute(command_buffer, image_index);
+    m_gpu_profiler.end_scope(command_buffer, render_pass_scope);
+    m_gpu_profiler.end_scope(command_buffer, frame_scope);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to record command buffer!");
+    }
+}
+
+void HelloTriangleApplication::record_scene(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    bool indirect = m_gpu_driven && m_indirect_draws != nullptr;
+    if (m_recording_threads == 0 || indirect)
+    {
+        {
+            GpuProfiler::Scope draws_scope(m_gpu_profiler, command_buffer, "Draws");
+            if (indirect)
+            {
+                bind_scene(command_buffer);
+                if (m_settings.m_animate)
+                {
+                    // phase of every object is a push constant, as in direct draws
+                    m_indirect_draws->record_draws(command_buffer, m_multi_draw_indirect, m_max_draw_indirect_count,
+                                                   [this, command_buffer](uint32_t object)
+                                                   { push_draw_constants(command_buffer, object); });
+                }
+                else
+                {
+                    m_indirect_draws->record_draws(command_buffer, m_multi_draw_indirect, m_max_draw_indirect_count);
+                }
+            }
+            else
+            {
+                record_draws(command_buffer, 0, m_draw_list.size());
+            }
+        }
+        record_particles(command_buffer);
+    }
+    else
+    {
+        FrameResources& frame = m_frames[m_current_frame];
+        auto record_slice = [this, &frame, image_index](uint32_t worker)
+        {
+            record_secondary_buffer(frame, worker, image_index);
+        };
+        if (m_thread_pool != nullptr)
+        {
+            m_thread_pool->parallel_for(m_recording_threads, record_slice);
+        }
+        else
+        {
+            record_slice(0);
+        }
+        vkCmdExecuteCommands(command_buffer, m_recording_threads, frame.m_secondary_buffers.data());
+    }
+}
+
+void HelloTriangleApplication::record_post_process(VkCommandBuffer command_buffer)
+{
+    GpuProfiler::Scope post_scope(m_gpu_profiler, command_buffer, "Post process");
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_post_pipeline->pipeline());
+    set_viewport_and_scissor(command_buffer);
+
+    // attachment view changes with swapchain recreation, so the set is written every frame
+    VkDescriptorImageInfo scene_color = {VK_NULL_HANDLE, m_render_graph.attachment_view("scene_color"),
+                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkDescriptorSet set = m_descriptors.frame_image_set(m_post_set_layout, {{0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, scene_color}});
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_post_pipeline_layout,
+                            0, 1, &set, 0, nullptr);
+    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+}
+
+void HelloTriangleApplication::record_secondary_buffer(FrameResources& frame, uint32_t worker, uint32_t image_index)
+{
+    // pool of the worker is used only by this call, no locking needed
+    vkResetCommandPool(m_device, frame.m_worker_pools[worker], 0);
+    VkCommandBuffer command_buffer = frame.m_secondary_buffers[worker];
+
+    VkCommandBufferInheritanceInfo inheritance_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance_info.renderPass = m_render_graph.render_pass("scene");
+    inheritance_info.subpass = m_render_graph.subpass("scene");
+    inheritance_info.framebuffer = m_render_graph.framebuffer("scene", image_index);
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to begin recording secondary command buffer!");
+    }
+
+    // contiguous slice of the draw list, so draw order inside render pass is kept
+    size_t begin = m_draw_list.size() * worker / m_recording_threads;
+    size_t end = m_draw_list.size() * (worker + 1) / m_recording_threads;
+    {
+        GpuProfiler::Scope draws_scope(m_gpu_profiler, command_buffer, "Draws, thread " + to_string(worker));
+        record_draws(command_buffer, begin, end);
+    }
+    // particles are drawn over the scene, so by the last slice
+    if (worker + 1 == m_recording_threads)
+    {
+        record_particles(command_buffer);
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to record secondary command buffer!");
+    }
+}
+
+void HelloTriangleApplication::record_draws(VkCommandBuffer command_buffer, size_t begin, size_t end)
+{
+    if (begin == end)
+    {
+        return;
+    }
+
+    bind_scene(command_buffer);
+    for (size_t i = begin; i < end; ++i)
+    {
+        const auto& draw = m_draw_list[i];
+        if (m_settings.m_animate)
+        {
+            push_draw_constants(command_buffer, i);
+        }
+        vkCmdDrawIndexed(command_buffer, draw.m_index_count, draw.m_instances_count, draw.m_first_index, 0, draw.m_first_instance);
+    }
+}
+
+void HelloTriangleApplication::push_draw_constants(VkCommandBuffer command_buffer, size_t draw)
+{
+    DrawConstants constants = {static_cast<float>(draw) * 0.618034f};
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+}
+
+void HelloTriangleApplication::bind_scene(VkCommandBuffer command_buffer)
+{
+    VkPipeline pipeline = (m_instances_count > 0 ? m_instanced_pipeline : m_pipeline)->pipeline();
+    if (m_material_pipelines != nullptr)
+    {
+        // new material either stalls recording while it compiles or is drawn with scene pipeline until it is ready
+        pipeline = m_async_materials ? m_material_pipelines->request(m_material).pipeline(pipeline)
+                                     : m_material_pipelines->get(m_material);
+    }
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    set_viewport_and_scissor(command_buffer);
+
+    VkDescriptorSet frame_set = m_uniform_ring.descriptor_set();
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout,
+                            0, 1, &frame_set, 1, &m_frame_uniforms_offset);
+    // not animated draws keep this phase
+    DrawConstants constants = {0.0f};
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    // binding 0 is per vertex, others are per instance streams of one buffer
+    VkBuffer vertex_buffers[1 + InstanceArrays::BINDINGS_COUNT] = {m_vertex_buffer.m_buffer};
+    VkDeviceSize vertex_offsets[1 + InstanceArrays::BINDINGS_COUNT] = {0};
+    uint32_t bindings_count = 1;
+    if (m_instances_count > 0)
+    {
+        for (uint32_t i = 0; i < InstanceArrays::BINDINGS_COUNT; ++i)
+        {
+            vertex_buffers[bindings_count] = m_instance_buffer.m_buffer;
+            vertex_offsets[bindings_count] = m_instance_stream_offsets[i];
+            ++bindings_count;
+        }
+    }
+    vkCmdBindVertexBuffers(command_buffer, 0, bindings_count, vertex_buffers, vertex_offsets);
+    vkCmdBindIndexBuffer(command_buffer, m_index_buffer.m_buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void HelloTriangleApplication::record_particles(VkCommandBuffer command_buffer)
+{
+    if (m_particles == nullptr)
+    {
+        return;
+    }
+
+    GpuProfiler::Scope particles_scope(m_gpu_profiler, command_buffer, "Particles");
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_particle_pipeline->pipeline());
+    set_viewport_and_scissor(command_buffer);
+    m_particles->record_draw(command_buffer);
+}
+
+void HelloTriangleApplication::set_viewport_and_scissor(VkCommandBuffer command_buffer)
+{
+    // dynamic state is not inherited by secondary command buffers, so it is set by every recorder
+    VkViewport viewport = {};
+    viewport.width = static_cast<float>(m_sch_extent.width);
+    viewport.height = static_cast<float>(m_sch_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {{0, 0}, m_sch_extent};
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+void HelloTriangleApplication::cleanup()
+{
+    m_shader_watcher.reset();
+    m_deletion_queue.flush();
+    for (const auto& semaphore : m_render_finished)
+    {
+        vkDestroySemaphore(m_device, semaphore, nullptr);
+    }
+    for (const auto& frame : m_frames)
+    {
+        vkDestroyFence(m_device, frame.m_in_flight_fence, nullptr);
+        vkDestroySemaphore(m_device, frame.m_image_available, nullptr);
+        vkDestroyCommandPool(m_device, frame.m_command_pool, nullptr);
+        for (const auto& pool : frame.m_worker_pools)
+        {
+            vkDestroyCommandPool(m_device, pool, nullptr);
+        }
+    }
+    m_thread_pool.reset();
+    m_gpu_profiler.destroy();
+    m_compute_scheduler.destroy();
+    m_pipelines.destroy();
+    if (m_post_pipeline_layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_device, m_post_pipeline_layout, nullptr);
+    }
+    if (m_particles != nullptr)
+    {
+        m_particles->destroy(m_descriptors, m_memory_allocator);
+    }
+    if (m_indirect_draws != nullptr)
+    {
+        m_indirect_draws->destroy(m_memory_allocator);
+    }
+    m_uniform_ring.destroy(m_descriptors, m_memory_allocator);
+    m_descriptors.destroy();
+    m_pipeline_cache.save();
+    m_pipeline_cache.destroy();
+    vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+    m_render_graph.destroy(m_memory_allocator);
+    for (const auto& image_view : m_sch_image_views)
+    {
+        vkDestroyImageView(m_device, image_view, nullptr);
+    }
+    if (m_settings.m_headless)
+    {
+        for (size_t i = 0; i < m_sch_images.size(); ++i)
+        {
+            vkDestroyImage(m_device, m_sch_images[i], nullptr);
+            m_memory_allocator.free(m_offscreen_memory[i]);
+        }
+    }
+    else
+    {
+        vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+    }
+    m_memory_allocator.destroy_buffer(m_vertex_buffer);
+    m_memory_allocator.destroy_buffer(m_index_buffer);
+    m_memory_allocator.destroy_buffer(m_instance_buffer);
+    m_staging_ring.destroy(m_memory_allocator);
+    if (m_upload_service != nullptr)
+    {
+        m_upload_service->destroy(m_memory_allocator);
+    }
+    m_memory_allocator.destroy();
+    vkDestroyDevice(m_device, nullptr);
+    if (ENABLE_VALIDATION_LAYERS)
+    {
+        destroy_debug_utils_messenger_EXT(m_instance, m_callback, nullptr);
+    }
+    if (m_surface != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    }
+    vkDestroyInstance(m_instance, nullptr);
+
+    if (m_window != nullptr)
+    {
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
+}
+
+void HelloTriangleApplication::create_VK_instance()
+{
+    if (ENABLE_VALIDATION_LAYERS && !check_validation_layers_support())
+    {
+        throw runtime_error("validation layers requested, but not available!");
+    }
+
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "Hello Triangle";
+    app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    app_info.pEngineName = "No Engine";
+    app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    app_info.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    create_info.pApplicationInfo = &app_info;
 
-    bool swap_chain_good = false;
+    auto extensions = get_required_extensions();
+    create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    create_info.ppEnabledExtensionNames = extensions.data();
+
+    if (ENABLE_VALIDATION_LAYERS) 
+    {
+        create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
+        create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+    }
+    else 
+    {
+        create_info.enabledLayerCount = 0;
+    }
+
+    VkResult result;
+    {
+        ScopedTimer timer(m_startup_timings, "vkCreateInstance");
+        result = vkCreateInstance(&create_info, nullptr, &m_instance);
+    }
+
+    if (result != VK_SUCCESS)
+        throw runtime_error("Failed to create Instance! Stupid...\n");
+}
+
+bool HelloTriangleApplication::check_validation_layers_support()
+{
+    uint32_t layers_count;
+    vkEnumerateInstanceLayerProperties(&layers_count, nullptr);
+
+    vector<VkLayerProperties> available_layers(layers_count);
+
+    vkEnumerateInstanceLayerProperties(&layers_count, available_layers.data());
+
+    for (const char* layer_name : VALIDATION_LAYERS) {
+        bool layer_found = false;
 
-    if (extension_supported)
+        for (const auto& layer_properties : available_layers) {
+            if (strcmp(layer_name, layer_properties.layerName) == 0) {
+                layer_found = true;
+                break;
+            }
+        }
+
+        if (!layer_found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool HelloTriangleApplication::check_device_suitability(VkPhysicalDevice device)
+{
+    auto indeces = find_queue_families(device);
+
+    bool extension_supported = check_device_extensions_support(device);
+
+    bool swap_chain_good = m_settings.m_headless;
+
+    if (extension_supported && !m_settings.m_headless)
     {
         auto details = query_swapchain_support(device);
         swap_chain_good = (!details.m_formats.empty() && !details.m_present_modes.empty());
@@ -676,7 +2337,8 @@ bool HelloTriangleApplication::check_device_extensions_support(VkPhysicalDevice
     vector<VkExtensionProperties> available_extensions(extensions_count);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensions_count, available_extensions.data());
 
-    set<string> required_extensions(DEVICE_EXTENCIONS.begin(), DEVICE_EXTENCIONS.end());
+    auto device_extensions = get_required_device_extensions();
+    set<string> required_extensions(device_extensions.begin(), device_extensions.end());
 
     for (const auto& extension : available_extensions)
     {
@@ -688,8 +2350,11 @@ bool HelloTriangleApplication::check_device_extensions_support(VkPhysicalDevice
 
 vector<const char*> HelloTriangleApplication::get_required_extensions() {
     uint32_t glfw_extensions_count = 0;
-    const char** glfw_extensions;
-    glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extensions_count);
+    const char** glfw_extensions = nullptr;
+    if (!m_settings.m_headless)
+    {
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extensions_count);
+    }
 
     vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extensions_count);
 
@@ -713,6 +2378,16 @@ vector<const char*> HelloTriangleApplication::get_required_extensions() {
     return extensions;
 }
 
+vector<const char*> HelloTriangleApplication::get_required_device_extensions()
+{
+    // offscreen rendering needs no WSI at all
+    if (m_settings.m_headless)
+    {
+        return {};
+    }
+    return DEVICE_EXTENCIONS;
+}
+
 VkResult HelloTriangleApplication::create_debug_utils_messenger_EXT(VkInstance instance,
                                                                     const VkDebugUtilsMessengerCreateInfoEXT *debug_info,
                                                                     const VkAllocationCallbacks *allocator,
@@ -777,6 +2452,12 @@ bool HelloTriangleApplication::compare_extensions(const char** glfw_extensions,
     return result;
 }
 
+void HelloTriangleApplication::framebuffer_resize_callback(GLFWwindow* window, int /*width*/, int /*height*/)
+{
+    auto application = static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+    application->m_swapchain_dirty = true;
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApplication::debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT /*messageSeverity*/,
     VkDebugUtilsMessageTypeFlagsEXT /*messageType*/,
@@ -788,9 +2469,9 @@ VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApplication::debug_callback(
     return VK_FALSE;
 }
 
-int call_HelloTriangleApplication()
+int call_HelloTriangleApplication(const ApplicationSettings& settings)
 {
-    HelloTriangleApplication app;
+    HelloTriangleApplication app(settings);
 
     try {
         app.run();
@@ -0,0 +1,102 @@
+#include "IndirectDrawList.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+void IndirectDrawList::create(VkDevice device, DescriptorAllocator& descriptors)
+{
+    m_device = device;
+    m_set_layout = descriptors.layout(
+    {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}
+    });
+
+    VkPushConstantRange push_constants = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingParameters)};
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &m_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constants;
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create culling pipeline layout!");
+    }
+}
+
+void IndirectDrawList::destroy(DeviceMemoryAllocator& allocator)
+{
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+    allocator.destroy_buffer(m_objects);
+    allocator.destroy_buffer(m_commands);
+
+    m_objects_count = 0;
+    m_pipeline = VK_NULL_HANDLE;
+    m_pipeline_layout = VK_NULL_HANDLE;
+    m_set_layout = VK_NULL_HANDLE;
+}
+
+VkBuffer IndirectDrawList::resize(DeviceMemoryAllocator& allocator, uint32_t objects_count)
+{
+    allocator.destroy_buffer(m_objects);
+    allocator.destroy_buffer(m_commands);
+
+    m_objects_count = objects_count;
+    m_objects = allocator.create_buffer(sizeof(Object) * static_cast<VkDeviceSize>(objects_count),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        MemoryUsage::GpuOnly);
+    m_commands = allocator.create_buffer(sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(objects_count),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                         MemoryUsage::GpuOnly);
+
+    return m_objects.m_buffer;
+}
+
+void IndirectDrawList::record_culling(VkCommandBuffer command_buffer, DescriptorAllocator& descriptors,
+                                      const float view_min[2], const float view_max[2]) const
+{
+    if (m_objects_count == 0)
+    {
+        return;
+    }
+
+    // write-after-read: indirect draws of the previous frame may still read the commands
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    VkDescriptorSet descriptor_set = descriptors.frame_set(m_set_layout,
+    {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {m_objects.m_buffer, 0, VK_WHOLE_SIZE}},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {m_commands.m_buffer, 0, VK_WHOLE_SIZE}}
+    });
+
+    CullingParameters parameters = {{view_min[0], view_min[1]}, {view_max[0], view_max[1]}, m_objects_count};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters), &parameters);
+    vkCmdDispatch(command_buffer, (m_objects_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void IndirectDrawList::record_draws(VkCommandBuffer command_buffer, bool multi_draw, uint32_t max_draw_count,
+                                    const function<void(uint32_t object)>& per_object) const
+{
+    const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    // without multiDrawIndirect drawCount should be 0 or 1
+    uint32_t batch = multi_draw && !per_object ? max(max_draw_count, 1u) : 1;
+    for (uint32_t first = 0; first < m_objects_count; first += batch)
+    {
+        if (per_object)
+        {
+            per_object(first);
+        }
+        uint32_t count = min(batch, m_objects_count - first);
+        vkCmdDrawIndexedIndirect(command_buffer, m_commands.m_buffer, first * stride, count, static_cast<uint32_t>(stride));
+    }
+}
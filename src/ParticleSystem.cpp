@@ -0,0 +1,131 @@
+#include "ParticleSystem.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+void ParticleSystem::create(VkDevice device, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                            uint32_t particles_count, uint32_t frames_count, const vector<uint32_t>& queue_families,
+                            const VkPhysicalDeviceLimits& limits)
+{
+    auto max_particles_count = limits.maxStorageBufferRange / sizeof(Particle);
+    if (particles_count > max_particles_count)
+    {
+        throw runtime_error("Particles count should not exceed " + to_string(max_particles_count) +
+                            " on this device (maxStorageBufferRange " + to_string(limits.maxStorageBufferRange) + ")!");
+    }
+
+    m_device = device;
+    m_particles_count = particles_count;
+    m_current = 0;
+    m_initialized = false;
+
+    uint32_t states_count = max(frames_count, 2u);
+    for (uint32_t i = 0; i < states_count; ++i)
+    {
+        m_states.push_back(allocator.create_buffer(sizeof(Particle) * static_cast<VkDeviceSize>(particles_count),
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                   MemoryUsage::GpuOnly, queue_families));
+        // big state buffers get dedicated memory blocks, they should never be left unbound
+        if (m_states.back().m_memory.m_memory == VK_NULL_HANDLE)
+        {
+            throw runtime_error("Failed to allocate memory for " + to_string(particles_count) + " particles!");
+        }
+    }
+
+    // same bindings as the reduction kernel, so the layout is shared
+    VkDescriptorSetLayout set_layout = descriptors.layout(
+    {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}
+    });
+    for (uint32_t i = 0; i < states_count; ++i)
+    {
+        const auto& source = m_states[(i + states_count - 1) % states_count];
+        m_descriptor_sets.push_back(descriptors.static_set(set_layout,
+        {
+            {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {source.m_buffer, 0, VK_WHOLE_SIZE}},
+            {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {m_states[i].m_buffer, 0, VK_WHOLE_SIZE}}
+        }));
+    }
+
+    VkPushConstantRange push_constants = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SimulationParameters)};
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constants;
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create particles pipeline layout!");
+    }
+}
+
+void ParticleSystem::destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator)
+{
+    vkDestroyPipeline(m_device, m_simulation_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+    for (auto& state : m_states)
+    {
+        descriptors.release_buffer(state.m_buffer);
+        allocator.destroy_buffer(state);
+    }
+
+    m_states.clear();
+    m_descriptor_sets.clear();
+    m_simulation_pipeline = VK_NULL_HANDLE;
+    m_pipeline_layout = VK_NULL_HANDLE;
+}
+
+VkVertexInputBindingDescription ParticleSystem::binding_description()
+{
+    VkVertexInputBindingDescription description = {};
+    description.binding = 0;
+    description.stride = sizeof(Particle);
+    description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return description;
+}
+
+array<VkVertexInputAttributeDescription, 2> ParticleSystem::attribute_descriptions()
+{
+    array<VkVertexInputAttributeDescription, 2> descriptions = {};
+    descriptions[0].binding = 0;
+    descriptions[0].location = 0;
+    descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    descriptions[0].offset = offsetof(Particle, m_position);
+
+    descriptions[1].binding = 0;
+    descriptions[1].location = 1;
+    descriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+    descriptions[1].offset = offsetof(Particle, m_velocity);
+    return descriptions;
+}
+
+void ParticleSystem::record_simulation(VkCommandBuffer command_buffer, float delta_time)
+{
+    uint32_t next = (m_current + 1) % static_cast<uint32_t>(m_states.size());
+
+    // source state was written by the previous step on this queue
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    SimulationParameters parameters = {delta_time, m_particles_count, m_initialized ? 0u : 1u};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_simulation_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout,
+                            0, 1, &m_descriptor_sets[next], 0, nullptr);
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters), &parameters);
+    vkCmdDispatch(command_buffer, (m_particles_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    m_current = next;
+    m_initialized = true;
+}
+
+void ParticleSystem::record_draw(VkCommandBuffer command_buffer) const
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_states[m_current].m_buffer, &offset);
+    vkCmdDraw(command_buffer, m_particles_count, 1, 0, 0);
+}
@@ -0,0 +1,166 @@
+#include "PipelineCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    /**
+      * VK_PIPELINE_CACHE_HEADER_VERSION_ONE layout, all fields are written
+      * least significant byte first:
+      *   0 header length, 4 header version, 8 vendorID, 12 deviceID, 16 pipelineCacheUUID
+      **/
+    constexpr size_t CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+    uint32_t read_uint32_lsb(const vector<char>& data, size_t offset)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+        }
+        return value;
+    }
+}
+
+void PipelineCache::create(VkPhysicalDevice gpu, VkDevice device, const string& file_path)
+{
+    m_device = device;
+    m_file_path = file_path;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+
+    auto data = load_file();
+    m_is_warm = is_compatible(data, properties);
+    if (!data.empty() && !m_is_warm)
+    {
+        cerr << "Pipeline cache " << m_file_path << " was created by another device or driver, ignoring it" << endl;
+    }
+
+    VkPipelineCacheCreateInfo create_info = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    create_info.initialDataSize = m_is_warm ? data.size() : 0;
+    create_info.pInitialData = m_is_warm ? data.data() : nullptr;
+
+    if (vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache) != VK_SUCCESS)
+    {
+        if (!m_is_warm)
+        {
+            throw runtime_error("Failed to create pipeline cache!");
+        }
+
+        // driver rejected the blob despite valid header - start from scratch
+        m_is_warm = false;
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        if (vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create pipeline cache!");
+        }
+    }
+}
+
+void PipelineCache::save() const
+{
+    if (m_cache == VK_NULL_HANDLE || m_file_path.empty())
+    {
+        return;
+    }
+
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0)
+    {
+        return;
+    }
+    vector<char> data(data_size);
+    if (vkGetPipelineCacheData(m_device, m_cache, &data_size, data.data()) != VK_SUCCESS)
+    {
+        cerr << "Failed to read pipeline cache data" << endl;
+        return;
+    }
+
+    /**
+      * Write to temporary file and rename it over the old one, so crash in the
+      * middle of writing can't leave truncated cache for the next run.
+      **/
+    string temporary_path = m_file_path + ".tmp";
+    {
+        ofstream file(temporary_path, ios::binary | ios::trunc);
+        if (file.is_open())
+        {
+            file.write(data.data(), static_cast<streamsize>(data_size));
+            file.flush();
+            // buffered data may fail to reach the disk only at close
+            file.close();
+        }
+        if (!file)
+        {
+            cerr << "Failed to write pipeline cache " << temporary_path << endl;
+            remove(temporary_path.c_str());
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    // rename does not replace existing files on Windows
+    remove(m_file_path.c_str());
+#endif
+    if (rename(temporary_path.c_str(), m_file_path.c_str()) != 0)
+    {
+        cerr << "Failed to replace pipeline cache " << m_file_path << endl;
+        remove(temporary_path.c_str());
+    }
+}
+
+void PipelineCache::destroy()
+{
+    if (m_cache != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineCache(m_device, m_cache, nullptr);
+        m_cache = VK_NULL_HANDLE;
+    }
+}
+
+vector<char> PipelineCache::load_file() const
+{
+    if (m_file_path.empty())
+    {
+        return {};
+    }
+
+    // missing cache is a normal cold start, not an error
+    ifstream file(m_file_path, ios::ate | ios::binary);
+    if (!file.is_open())
+    {
+        return {};
+    }
+
+    vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(data.data(), static_cast<streamsize>(data.size())))
+    {
+        return {};
+    }
+    return data;
+}
+
+bool PipelineCache::is_compatible(const vector<char>& data, const VkPhysicalDeviceProperties& properties) const
+{
+    if (data.size() < CACHE_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    auto header_length = read_uint32_lsb(data, 0);
+    auto header_version = read_uint32_lsb(data, 4);
+    auto vendor_id = read_uint32_lsb(data, 8);
+    auto device_id = read_uint32_lsb(data, 12);
+
+    return header_length >= CACHE_HEADER_SIZE && header_length <= data.size() &&
+           header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vendor_id == properties.vendorID &&
+           device_id == properties.deviceID &&
+           memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,463 @@
+#include "PipelineRegistry.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "utils.hpp"
+
+namespace
+{
+    bool same_bindings(const vector<VkVertexInputBindingDescription>& a, const vector<VkVertexInputBindingDescription>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].binding != b[i].binding || a[i].stride != b[i].stride || a[i].inputRate != b[i].inputRate)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool same_attributes(const vector<VkVertexInputAttributeDescription>& a, const vector<VkVertexInputAttributeDescription>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].location != b[i].location || a[i].binding != b[i].binding ||
+                a[i].format != b[i].format || a[i].offset != b[i].offset)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool PipelineDescription::operator==(const PipelineDescription& other) const
+{
+    return m_vertex_shader == other.m_vertex_shader && m_fragment_shader == other.m_fragment_shader &&
+           same_bindings(m_bindings, other.m_bindings) && same_attributes(m_attributes, other.m_attributes) &&
+           m_topology == other.m_topology && m_polygon_mode == other.m_polygon_mode &&
+           m_cull_mode == other.m_cull_mode && m_front_face == other.m_front_face &&
+           m_alpha_blending == other.m_alpha_blending && m_layout == other.m_layout &&
+           m_render_pass == other.m_render_pass && m_subpass == other.m_subpass;
+}
+
+size_t PipelineDescriptionHash::operator()(const PipelineDescription& description) const
+{
+    size_t seed = hash<string>()(description.m_vertex_shader);
+    hash_combine(seed, hash<string>()(description.m_fragment_shader));
+    for (const auto& binding : description.m_bindings)
+    {
+        hash_combine(seed, binding.binding);
+        hash_combine(seed, binding.stride);
+        hash_combine(seed, binding.inputRate);
+    }
+    for (const auto& attribute : description.m_attributes)
+    {
+        hash_combine(seed, attribute.location);
+        hash_combine(seed, attribute.format);
+        hash_combine(seed, attribute.offset);
+    }
+    hash_combine(seed, description.m_topology);
+    hash_combine(seed, description.m_polygon_mode);
+    hash_combine(seed, description.m_cull_mode);
+    hash_combine(seed, description.m_front_face);
+    hash_combine(seed, description.m_alpha_blending);
+    hash_combine(seed, hash<VkPipelineLayout>()(description.m_layout));
+    hash_combine(seed, hash<VkRenderPass>()(description.m_render_pass));
+    hash_combine(seed, description.m_subpass);
+    return seed;
+}
+
+bool PipelineRegistry::FamilyKey::operator==(const FamilyKey& other) const
+{
+    return m_vertex_shader == other.m_vertex_shader && m_fragment_shader == other.m_fragment_shader &&
+           m_layout == other.m_layout && m_render_pass == other.m_render_pass && m_subpass == other.m_subpass;
+}
+
+size_t PipelineRegistry::FamilyKeyHash::operator()(const FamilyKey& key) const
+{
+    size_t seed = hash<string>()(key.m_vertex_shader);
+    hash_combine(seed, hash<string>()(key.m_fragment_shader));
+    hash_combine(seed, hash<VkPipelineLayout>()(key.m_layout));
+    hash_combine(seed, hash<VkRenderPass>()(key.m_render_pass));
+    hash_combine(seed, key.m_subpass);
+    return seed;
+}
+
+void PipelineRegistry::create(VkDevice device, VkPipelineCache cache, ShaderProvider shaders, bool derivatives)
+{
+    m_device = device;
+    m_cache = cache;
+    m_shaders = move(shaders);
+    m_derivatives = derivatives;
+}
+
+void PipelineRegistry::destroy()
+{
+    // joins workers after queued compilations are done
+    m_compiler.reset();
+
+    lock_guard<mutex> lock(m_mutex);
+    for (const auto& rebuilt : m_rebuilt)
+    {
+        vkDestroyPipeline(m_device, rebuilt.m_pipeline, nullptr);
+    }
+    m_rebuilt.clear();
+    for (const auto& [description, slot] : m_slots)
+    {
+        VkPipeline pipeline = slot->m_pipeline.load();
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_device, pipeline, nullptr);
+        }
+    }
+    m_slots.clear();
+    m_family_bases.clear();
+}
+
+VkPipeline PipelineRegistry::get(const PipelineDescription& description)
+{
+    unique_lock<mutex> lock(m_mutex);
+    ++m_statistics.m_lookups;
+    auto [found, inserted] = m_slots.try_emplace(description);
+    if (inserted)
+    {
+        found->second = make_unique<Slot>();
+    }
+    Slot& slot = *found->second;
+    if (inserted)
+    {
+        // compiled without the lock, so pipelines requested by different threads are created in parallel
+        lock.unlock();
+        compile(description, slot);
+        return slot.m_pipeline.load(memory_order_acquire);
+    }
+
+    // created by another thread or by a worker
+    m_compiled.wait(lock, [&slot]() { return slot.is_ready() || slot.m_failed; });
+    if (slot.m_failed)
+    {
+        throw runtime_error("Failed to create pipeline " + description.m_vertex_shader + "!");
+    }
+    return slot.m_pipeline.load(memory_order_acquire);
+}
+
+const PipelineRegistry::Slot& PipelineRegistry::request(const PipelineDescription& description)
+{
+    lock_guard<mutex> lock(m_mutex);
+    ++m_statistics.m_lookups;
+    auto [found, inserted] = m_slots.try_emplace(description);
+    if (inserted)
+    {
+        found->second = make_unique<Slot>();
+        Slot* slot = found->second.get();
+        ++m_statistics.m_queue_depth;
+        m_statistics.m_max_queue_depth = max(m_statistics.m_max_queue_depth, m_statistics.m_queue_depth);
+        if (m_compiler == nullptr)
+        {
+            m_compiler = make_unique<ThreadPool>(COMPILE_THREADS);
+        }
+        auto requested = chrono::steady_clock::now();
+        m_compiler->submit([this, description, slot, requested]()
+        {
+            try
+            {
+                compile(description, *slot);
+            }
+            catch (const exception& error)
+            {
+                // slot keeps giving the fallback
+                cerr << error.what() << endl;
+            }
+            auto latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - requested).count();
+
+            lock_guard<mutex> relock(m_mutex);
+            --m_statistics.m_queue_depth;
+            ++m_statistics.m_async_compiles;
+            m_statistics.m_latency_ms += latency_ms;
+            m_statistics.m_max_latency_ms = max(m_statistics.m_max_latency_ms, latency_ms);
+        });
+    }
+
+    const Slot& slot = *found->second;
+    if (!slot.is_ready())
+    {
+        ++m_statistics.m_fallbacks;
+    }
+    return slot;
+}
+
+const PipelineRegistry::Slot& PipelineRegistry::slot(const PipelineDescription& description)
+{
+    get(description);
+    lock_guard<mutex> lock(m_mutex);
+    return *m_slots.find(description)->second;
+}
+
+void PipelineRegistry::rebuild(const vector<string>& shaders)
+{
+    lock_guard<mutex> lock(m_mutex);
+    for (const auto& [description, slot] : m_slots)
+    {
+        bool affected = find(shaders.begin(), shaders.end(), description.m_vertex_shader) != shaders.end() ||
+                        find(shaders.begin(), shaders.end(), description.m_fragment_shader) != shaders.end();
+        if (!affected || !slot->is_ready())
+        {
+            continue;
+        }
+
+        if (m_compiler == nullptr)
+        {
+            m_compiler = make_unique<ThreadPool>(COMPILE_THREADS);
+        }
+        ++m_rebuilds_in_flight;
+        Slot* target = slot.get();
+        uint32_t generation = ++target->m_generation;
+        m_compiler->submit([this, description = description, target, generation]()
+        {
+            // no base, family base may be replaced and retired meanwhile
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            try
+            {
+                pipeline = create_pipeline(description, VK_NULL_HANDLE);
+            }
+            catch (const exception& error)
+            {
+                // slot keeps the pipeline of the previous shader version
+                cerr << error.what() << endl;
+            }
+
+            lock_guard<mutex> relock(m_mutex);
+            --m_rebuilds_in_flight;
+            if (pipeline != VK_NULL_HANDLE)
+            {
+                m_rebuilt.push_back({target, generation, pipeline});
+            }
+        });
+    }
+}
+
+bool PipelineRegistry::is_rebuilding() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_rebuilds_in_flight > 0;
+}
+
+uint32_t PipelineRegistry::swap_rebuilt(const function<void(VkPipeline)>& retire)
+{
+    vector<VkPipeline> replaced;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        for (const auto& entry : m_rebuilt)
+        {
+            if (entry.m_generation != entry.m_slot->m_generation)
+            {
+                // shader has changed again and a newer pipeline is coming, this one was never used
+                vkDestroyPipeline(m_device, entry.m_pipeline, nullptr);
+                continue;
+            }
+            VkPipeline old = entry.m_slot->m_pipeline.exchange(entry.m_pipeline, memory_order_acq_rel);
+            for (auto& [family, base] : m_family_bases)
+            {
+                if (base == old)
+                {
+                    base = entry.m_pipeline;
+                }
+            }
+            replaced.push_back(old);
+        }
+        m_rebuilt.clear();
+        m_statistics.m_rebuilt += static_cast<uint32_t>(replaced.size());
+    }
+
+    for (auto pipeline : replaced)
+    {
+        retire(pipeline);
+    }
+    return static_cast<uint32_t>(replaced.size());
+}
+
+void PipelineRegistry::compile(const PipelineDescription& description, Slot& slot)
+{
+    VkPipeline base = VK_NULL_HANDLE;
+    if (m_derivatives)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto family = m_family_bases.find(family_of(description));
+        if (family != m_family_bases.end())
+        {
+            base = family->second;
+        }
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    auto creation_start = chrono::steady_clock::now();
+    try
+    {
+        pipeline = create_pipeline(description, base);
+    }
+    catch (...)
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            slot.m_failed = true;
+        }
+        m_compiled.notify_all();
+        throw;
+    }
+    auto creation_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - creation_start).count();
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        ++m_statistics.m_created;
+        m_statistics.m_creation_ms += creation_ms;
+        if (base != VK_NULL_HANDLE)
+        {
+            ++m_statistics.m_derivatives;
+        }
+        if (m_derivatives)
+        {
+            // the first pipeline of the family stays its base
+            m_family_bases.emplace(family_of(description), pipeline);
+        }
+        // from now on recorders get the pipeline instead of the fallback
+        slot.m_pipeline.store(pipeline, memory_order_release);
+    }
+    m_compiled.notify_all();
+}
+
+PipelineRegistry::Statistics PipelineRegistry::statistics() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void PipelineRegistry::print_statistics(ostream& out) const
+{
+    auto current = statistics();
+    out << "Pipeline registry: " << current.m_created << " pipelines (" << current.m_derivatives
+        << " derivatives) created in " << current.m_creation_ms << " ms, " << current.m_lookups << " lookups" << endl;
+    if (current.m_async_compiles > 0 || current.m_queue_depth > 0)
+    {
+        out << "  background: " << current.m_async_compiles << " compiled, " << current.m_queue_depth << " queued (max "
+            << current.m_max_queue_depth << "), latency avg "
+            << current.m_latency_ms / max(current.m_async_compiles, 1u) << " ms, max " << current.m_max_latency_ms
+            << " ms, " << current.m_fallbacks << " fallback draws" << endl;
+    }
+    if (current.m_rebuilt > 0)
+    {
+        out << "  " << current.m_rebuilt << " pipelines rebuilt after shader changes" << endl;
+    }
+}
+
+PipelineRegistry::FamilyKey PipelineRegistry::family_of(const PipelineDescription& description)
+{
+    return {description.m_vertex_shader, description.m_fragment_shader,
+            description.m_layout, description.m_render_pass, description.m_subpass};
+}
+
+VkPipeline PipelineRegistry::create_pipeline(const PipelineDescription& description, VkPipeline base)
+{
+    VkPipelineShaderStageCreateInfo shader_stages[2] = {};
+    shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shader_stages[0].module = m_shaders(description.m_vertex_shader);
+    shader_stages[0].pName = "main";
+    shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shader_stages[1].module = m_shaders(description.m_fragment_shader);
+    shader_stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(description.m_bindings.size());
+    vertex_input_info.pVertexBindingDescriptions = description.m_bindings.data();
+    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.m_attributes.size());
+    vertex_input_info.pVertexAttributeDescriptions = description.m_attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    input_assembly_info.topology = description.m_topology;
+    input_assembly_info.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissor are dynamic, so pipeline survives swapchain recreation
+    VkPipelineViewportStateCreateInfo viewport_state = {VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = description.m_polygon_mode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = description.m_cull_mode;
+    rasterizer.frontFace = description.m_front_face;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = description.m_alpha_blending ? VK_TRUE : VK_FALSE;
+    color_blend_attachment.srcColorBlendFactor = description.m_alpha_blending ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstColorBlendFactor = description.m_alpha_blending ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.logicOp = VK_LOGIC_OP_COPY;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    VkDynamicState dynamic_states[] =
+    {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamic_state_info = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamic_state_info.dynamicStateCount = 2;
+    dynamic_state_info.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = shader_stages;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly_info;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = nullptr;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state_info;
+    pipeline_info.layout = description.m_layout;
+    pipeline_info.renderPass = description.m_render_pass;
+    pipeline_info.subpass = description.m_subpass;
+    pipeline_info.basePipelineHandle = base;
+    pipeline_info.basePipelineIndex = -1;
+    if (m_derivatives)
+    {
+        pipeline_info.flags = base != VK_NULL_HANDLE ? VK_PIPELINE_CREATE_DERIVATIVE_BIT
+                                                     : VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+    }
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(m_device, m_cache, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create pipeline " + description.m_vertex_shader + "!");
+    }
+    return pipeline;
+}
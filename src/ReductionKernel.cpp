@@ -0,0 +1,114 @@
+#include "ReductionKernel.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // enough values per invocation to hide memory latency, but all compute units busy
+    constexpr uint32_t VALUES_PER_INVOCATION = 16;
+}
+
+void ReductionKernel::create(VkDevice device, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                             uint32_t values_count, const VkPhysicalDeviceLimits& limits)
+{
+    auto max_values_count = limits.maxStorageBufferRange / sizeof(uint32_t);
+    if (values_count > max_values_count)
+    {
+        throw runtime_error("Compute elements should not exceed " + to_string(max_values_count) +
+                            " on this device (maxStorageBufferRange " + to_string(limits.maxStorageBufferRange) + ")!");
+    }
+
+    m_device = device;
+    m_values_count = values_count;
+    uint32_t needed = (values_count + WORKGROUP_SIZE * VALUES_PER_INVOCATION - 1) / (WORKGROUP_SIZE * VALUES_PER_INVOCATION);
+    m_workgroups = max(1u, min(needed, limits.maxComputeWorkGroupCount[0]));
+
+    m_values = allocator.create_buffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(values_count),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       MemoryUsage::GpuOnly);
+    m_result = allocator.create_buffer(sizeof(uint32_t),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       MemoryUsage::GpuToCpu);
+
+    VkDescriptorSetLayout set_layout = descriptors.layout(
+    {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}
+    });
+    m_descriptor_set = descriptors.static_set(set_layout,
+    {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {m_values.m_buffer, 0, VK_WHOLE_SIZE}},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, {m_result.m_buffer, 0, VK_WHOLE_SIZE}}
+    });
+
+    VkPushConstantRange push_constants = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t)};
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constants;
+    if (vkCreatePipelineLayout(m_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create reduction pipeline layout!");
+    }
+}
+
+void ReductionKernel::destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator)
+{
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
+    descriptors.release_buffer(m_values.m_buffer);
+    descriptors.release_buffer(m_result.m_buffer);
+    allocator.destroy_buffer(m_values);
+    allocator.destroy_buffer(m_result);
+
+    m_pipeline = VK_NULL_HANDLE;
+    m_pipeline_layout = VK_NULL_HANDLE;
+    m_descriptor_set = VK_NULL_HANDLE;
+}
+
+void ReductionKernel::record_fill(VkCommandBuffer command_buffer) const
+{
+    vkCmdFillBuffer(command_buffer, m_values.m_buffer, 0, VK_WHOLE_SIZE, VALUE);
+
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ReductionKernel::record_reduce(VkCommandBuffer command_buffer) const
+{
+    // previous reduction may still add to the result: write-after-write
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdFillBuffer(command_buffer, m_result.m_buffer, 0, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_descriptor_set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &m_values_count);
+    vkCmdDispatch(command_buffer, m_workgroups, 1, 1);
+
+    // result is read by host after the fence
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+uint32_t ReductionKernel::read_result(const DeviceMemoryAllocator& allocator) const
+{
+    allocator.invalidate(m_result.m_memory);
+    return *static_cast<const uint32_t*>(m_result.m_memory.m_mapped);
+}
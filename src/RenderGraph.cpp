@@ -0,0 +1,833 @@
+#include "RenderGraph.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+void RenderGraph::add_attachment(const string& name, VkFormat format, bool depth, VkClearValue clear)
+{
+    if (m_resource_indices.count(name) != 0)
+    {
+        throw runtime_error("Render graph attachment " + name + " is declared twice!");
+    }
+    m_resource_indices[name] = static_cast<uint32_t>(m_resources.size());
+    m_resources.push_back({name, format, depth, false, VK_IMAGE_LAYOUT_UNDEFINED, clear});
+}
+
+void RenderGraph::import_attachment(const string& name, VkFormat format, VkImageLayout final_layout, VkClearValue clear)
+{
+    if (m_resource_indices.count(name) != 0)
+    {
+        throw runtime_error("Render graph attachment " + name + " is declared twice!");
+    }
+    m_resource_indices[name] = static_cast<uint32_t>(m_resources.size());
+    m_resources.push_back({name, format, false, true, final_layout, clear});
+}
+
+void RenderGraph::add_pass(PassDescription pass)
+{
+    Pass compiled;
+    compiled.m_description = move(pass);
+    m_passes.push_back(move(compiled));
+}
+
+uint32_t RenderGraph::resource_index(const string& name) const
+{
+    auto found = m_resource_indices.find(name);
+    if (found == m_resource_indices.end())
+    {
+        throw runtime_error("Render graph has no attachment " + name + "!");
+    }
+    return found->second;
+}
+
+uint32_t RenderGraph::pass_index(const string& name) const
+{
+    for (uint32_t i = 0; i < m_passes.size(); ++i)
+    {
+        if (m_passes[i].m_description.m_name == name)
+        {
+            return i;
+        }
+    }
+    throw runtime_error("Render graph has no pass " + name + "!");
+}
+
+RenderGraph::Use RenderGraph::use_of(const Pass& pass, uint32_t resource) const
+{
+    Use use;
+    use.m_write = find(pass.m_color_outputs.begin(), pass.m_color_outputs.end(), resource) != pass.m_color_outputs.end() ||
+                  pass.m_depth_output == static_cast<int32_t>(resource);
+    use.m_input = find(pass.m_input_attachments.begin(), pass.m_input_attachments.end(), resource) != pass.m_input_attachments.end();
+    use.m_sampled = find(pass.m_sampled_inputs.begin(), pass.m_sampled_inputs.end(), resource) != pass.m_sampled_inputs.end();
+    return use;
+}
+
+VkImageLayout RenderGraph::attachment_layout(const Resource& resource, const Use& use) const
+{
+    if (use.m_write && use.m_input)
+    {
+        return VK_IMAGE_LAYOUT_GENERAL; // feedback loop
+    }
+    if (use.m_write)
+    {
+        return resource.m_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    return resource.m_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void RenderGraph::stages_of(const Resource& resource, const Use& use, VkPipelineStageFlags& stages, VkAccessFlags& access) const
+{
+    if (use.m_write && resource.m_depth)
+    {
+        stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+    else if (use.m_write)
+    {
+        stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+    if (use.m_input)
+    {
+        stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        access |= VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    }
+    if (use.m_sampled)
+    {
+        stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        access |= VK_ACCESS_SHADER_READ_BIT;
+    }
+}
+
+void RenderGraph::compile(VkDevice device)
+{
+    m_device = device;
+    m_groups.clear();
+
+    for (auto& pass : m_passes)
+    {
+        const auto& description = pass.m_description;
+        pass.m_color_outputs.clear();
+        pass.m_input_attachments.clear();
+        pass.m_sampled_inputs.clear();
+        for (const auto& name : description.m_color_outputs)
+        {
+            pass.m_color_outputs.push_back(resource_index(name));
+        }
+        pass.m_depth_output = description.m_depth_output.empty()
+                            ? -1 : static_cast<int32_t>(resource_index(description.m_depth_output));
+        for (const auto& name : description.m_input_attachments)
+        {
+            pass.m_input_attachments.push_back(resource_index(name));
+        }
+        for (const auto& name : description.m_sampled_inputs)
+        {
+            pass.m_sampled_inputs.push_back(resource_index(name));
+        }
+    }
+    for (auto& resource : m_resources)
+    {
+        resource.m_first_group = UINT32_MAX;
+        resource.m_last_group = 0;
+        resource.m_input = false;
+        resource.m_sampled = false;
+    }
+
+    /**
+      * Passes keep declaration order. A pass starts a new render pass if it samples
+      * an attachment of the current one or uses as attachment what the current one samples:
+      * both need the whole image in another layout.
+      **/
+    vector<bool> written(m_resources.size(), false);
+    vector<bool> attached_in_group(m_resources.size(), false);
+    vector<bool> sampled_in_group(m_resources.size(), false);
+    for (uint32_t p = 0; p < m_passes.size(); ++p)
+    {
+        Pass& pass = m_passes[p];
+        vector<uint32_t> attachments = pass.m_color_outputs;
+        if (pass.m_depth_output >= 0)
+        {
+            attachments.push_back(static_cast<uint32_t>(pass.m_depth_output));
+        }
+        attachments.insert(attachments.end(), pass.m_input_attachments.begin(), pass.m_input_attachments.end());
+
+        for (auto resource : pass.m_input_attachments)
+        {
+            if (!written[resource])
+            {
+                throw runtime_error("Render graph pass " + pass.m_description.m_name + " reads " +
+                                    m_resources[resource].m_name + " before it is written!");
+            }
+        }
+        for (auto resource : pass.m_sampled_inputs)
+        {
+            if (!written[resource])
+            {
+                throw runtime_error("Render graph pass " + pass.m_description.m_name + " samples " +
+                                    m_resources[resource].m_name + " before it is written!");
+            }
+        }
+
+        bool split = m_groups.empty();
+        for (auto resource : pass.m_sampled_inputs)
+        {
+            split = split || attached_in_group[resource];
+        }
+        for (auto resource : attachments)
+        {
+            split = split || sampled_in_group[resource];
+        }
+        if (split)
+        {
+            m_groups.emplace_back();
+            fill(attached_in_group.begin(), attached_in_group.end(), false);
+            fill(sampled_in_group.begin(), sampled_in_group.end(), false);
+        }
+
+        auto group_index = static_cast<uint32_t>(m_groups.size() - 1);
+        Group& group = m_groups.back();
+        pass.m_group = group_index;
+        pass.m_subpass = static_cast<uint32_t>(group.m_passes.size());
+        group.m_passes.push_back(p);
+
+        for (auto resource : attachments)
+        {
+            attached_in_group[resource] = true;
+            if (find(group.m_attachments.begin(), group.m_attachments.end(), resource) == group.m_attachments.end())
+            {
+                group.m_attachments.push_back(resource);
+            }
+        }
+        for (auto resource : pass.m_sampled_inputs)
+        {
+            sampled_in_group[resource] = true;
+            m_resources[resource].m_sampled = true;
+        }
+        for (auto resource : pass.m_input_attachments)
+        {
+            m_resources[resource].m_input = true;
+        }
+        for (auto resource : pass.m_color_outputs)
+        {
+            written[resource] = true;
+        }
+        if (pass.m_depth_output >= 0)
+        {
+            written[pass.m_depth_output] = true;
+        }
+
+        attachments.insert(attachments.end(), pass.m_sampled_inputs.begin(), pass.m_sampled_inputs.end());
+        for (auto resource : attachments)
+        {
+            auto& lifetime = m_resources[resource];
+            lifetime.m_first_group = min(lifetime.m_first_group, group_index);
+            lifetime.m_last_group = max(lifetime.m_last_group, group_index);
+        }
+    }
+
+    for (auto& resource : m_resources)
+    {
+        resource.m_transient = !resource.m_imported && !resource.m_sampled && resource.m_first_group == resource.m_last_group;
+    }
+
+    // layout and contents of every resource between render passes
+    vector<VkImageLayout> layouts(m_resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+    fill(written.begin(), written.end(), false);
+    for (uint32_t g = 0; g < m_groups.size(); ++g)
+    {
+        create_render_pass(g, layouts, written);
+    }
+}
+
+void RenderGraph::create_render_pass(uint32_t group_index, vector<VkImageLayout>& layouts, vector<bool>& written)
+{
+    Group& group = m_groups[group_index];
+    auto subpasses_count = static_cast<uint32_t>(group.m_passes.size());
+
+    vector<uint32_t> attachment_indices(m_resources.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < group.m_attachments.size(); ++i)
+    {
+        attachment_indices[group.m_attachments[i]] = i;
+    }
+
+    auto pass_of = [this, &group](uint32_t subpass) -> const Pass& { return m_passes[group.m_passes[subpass]]; };
+    auto uses = [this](const Use& use) { return use.m_write || use.m_input || use.m_sampled; };
+
+    vector<VkAttachmentDescription> descriptions;
+    group.m_clear_values.clear();
+    for (auto resource : group.m_attachments)
+    {
+        const Resource& description = m_resources[resource];
+        uint32_t last_use = 0;
+        for (uint32_t s = 0; s < subpasses_count; ++s)
+        {
+            if (uses(use_of(pass_of(s), resource)))
+            {
+                last_use = s;
+            }
+        }
+
+        VkImageLayout final_layout = attachment_layout(description, use_of(pass_of(last_use), resource));
+        if (description.m_imported && description.m_last_group == group_index)
+        {
+            final_layout = description.m_final_layout;
+        }
+        else if (description.m_last_group > group_index)
+        {
+            // the next render pass, which uses the attachment, may sample it
+            for (uint32_t p = group.m_passes.back() + 1; p < m_passes.size(); ++p)
+            {
+                Use next = use_of(m_passes[p], resource);
+                if (uses(next))
+                {
+                    if (next.m_sampled)
+                    {
+                        final_layout = attachment_layout(description, next);
+                    }
+                    break;
+                }
+            }
+        }
+
+        VkAttachmentDescription attachment = {};
+        attachment.format = description.m_format;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = written[resource] ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        // nobody reads the contents after this render pass
+        attachment.storeOp = description.m_imported || description.m_last_group > group_index
+                           ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = written[resource] ? layouts[resource] : VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = final_layout;
+        descriptions.push_back(attachment);
+        group.m_clear_values.push_back(description.m_clear);
+    }
+
+    struct SubpassReferences
+    {
+        vector<VkAttachmentReference> m_colors;
+        VkAttachmentReference m_depth;
+        vector<VkAttachmentReference> m_inputs;
+        vector<uint32_t> m_preserve;
+    };
+    vector<SubpassReferences> references(subpasses_count);
+    vector<VkSubpassDescription> subpasses(subpasses_count);
+    for (uint32_t s = 0; s < subpasses_count; ++s)
+    {
+        const Pass& pass = pass_of(s);
+        auto reference = [&](uint32_t resource) -> VkAttachmentReference
+        {
+            return {attachment_indices[resource], attachment_layout(m_resources[resource], use_of(pass, resource))};
+        };
+
+        SubpassReferences& subpass_references = references[s];
+        for (auto resource : pass.m_color_outputs)
+        {
+            subpass_references.m_colors.push_back(reference(resource));
+        }
+        for (auto resource : pass.m_input_attachments)
+        {
+            subpass_references.m_inputs.push_back(reference(resource));
+        }
+        if (pass.m_depth_output >= 0)
+        {
+            subpass_references.m_depth = reference(static_cast<uint32_t>(pass.m_depth_output));
+        }
+
+        // contents of attachments, which are used before and after this subpass, should survive it
+        for (auto resource : group.m_attachments)
+        {
+            bool before = false;
+            bool after = false;
+            for (uint32_t other = 0; other < subpasses_count; ++other)
+            {
+                if (uses(use_of(pass_of(other), resource)))
+                {
+                    before = before || other < s;
+                    after = after || other > s;
+                }
+            }
+            if (before && after && !uses(use_of(pass, resource)))
+            {
+                subpass_references.m_preserve.push_back(attachment_indices[resource]);
+            }
+        }
+
+        VkSubpassDescription& subpass = subpasses[s];
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(subpass_references.m_colors.size());
+        subpass.pColorAttachments = subpass_references.m_colors.data();
+        subpass.inputAttachmentCount = static_cast<uint32_t>(subpass_references.m_inputs.size());
+        subpass.pInputAttachments = subpass_references.m_inputs.data();
+        subpass.pDepthStencilAttachment = pass.m_depth_output >= 0 ? &subpass_references.m_depth : nullptr;
+        subpass.preserveAttachmentCount = static_cast<uint32_t>(subpass_references.m_preserve.size());
+        subpass.pPreserveAttachments = subpass_references.m_preserve.data();
+    }
+
+    vector<VkSubpassDependency> dependencies;
+
+    /**
+      * Into the render pass: previous render passes of the frame and previous frames,
+      * which used the same images (or memory of aliased images). Image acquire semaphore
+      * is waited at COLOR_ATTACHMENT_OUTPUT stage, so it is always in the source scope.
+      **/
+    for (uint32_t s = 0; s < subpasses_count; ++s)
+    {
+        const Pass& pass = pass_of(s);
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = s;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        vector<uint32_t> resources = group.m_attachments;
+        resources.insert(resources.end(), pass.m_sampled_inputs.begin(), pass.m_sampled_inputs.end());
+        bool needed = false;
+        for (auto resource : resources)
+        {
+            Use use = use_of(pass, resource);
+            bool first_use = use.m_sampled;
+            if (!use.m_sampled && uses(use))
+            {
+                first_use = true;
+                for (uint32_t earlier = 0; earlier < s; ++earlier)
+                {
+                    first_use = first_use && !uses(use_of(pass_of(earlier), resource));
+                }
+            }
+            if (!first_use)
+            {
+                continue;
+            }
+
+            needed = true;
+            const Resource& description = m_resources[resource];
+            stages_of(description, use, dependency.dstStageMask, dependency.dstAccessMask);
+            if (written[resource])
+            {
+                dependency.dstAccessMask |= description.m_depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                                                                : (use.m_write ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+            }
+            dependency.srcStageMask |= description.m_depth ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                                                           : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            // imported images come with their own synchronization, others were written before
+            if (!description.m_imported || written[resource])
+            {
+                dependency.srcAccessMask |= description.m_depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                                                                : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            }
+            if (description.m_input || description.m_sampled)
+            {
+                dependency.srcStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT; // write-after-read
+            }
+        }
+        if (needed)
+        {
+            dependencies.push_back(dependency);
+        }
+    }
+
+    // between subpasses, all accesses are framebuffer local
+    for (uint32_t s = 1; s < subpasses_count; ++s)
+    {
+        for (uint32_t earlier = 0; earlier < s; ++earlier)
+        {
+            VkSubpassDependency dependency = {};
+            dependency.srcSubpass = earlier;
+            dependency.dstSubpass = s;
+            dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+            for (auto resource : group.m_attachments)
+            {
+                Use source = use_of(pass_of(earlier), resource);
+                Use destination = use_of(pass_of(s), resource);
+                if (!uses(source) || !uses(destination) || (!source.m_write && !destination.m_write))
+                {
+                    continue;
+                }
+                VkAccessFlags source_access = 0;
+                stages_of(m_resources[resource], source, dependency.srcStageMask, source_access);
+                if (source.m_write)
+                {
+                    dependency.srcAccessMask |= source_access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+                }
+                stages_of(m_resources[resource], destination, dependency.dstStageMask, dependency.dstAccessMask);
+            }
+            if (dependency.srcStageMask != 0)
+            {
+                dependencies.push_back(dependency);
+            }
+        }
+    }
+
+    // out of the render pass: attachments, which are used by later render passes
+    VkSubpassDependency outgoing = {};
+    outgoing.srcSubpass = subpasses_count - 1;
+    outgoing.dstSubpass = VK_SUBPASS_EXTERNAL;
+    for (auto resource : group.m_attachments)
+    {
+        const Resource& description = m_resources[resource];
+        if (description.m_last_group == group_index)
+        {
+            continue;
+        }
+        outgoing.srcStageMask |= description.m_depth ? VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                                                     : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        outgoing.srcAccessMask |= description.m_depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                                                      : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        outgoing.dstStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        outgoing.dstAccessMask |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        if (description.m_depth)
+        {
+            outgoing.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            outgoing.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        }
+        else
+        {
+            outgoing.dstStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            outgoing.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        }
+    }
+    if (outgoing.srcStageMask != 0)
+    {
+        dependencies.push_back(outgoing);
+    }
+
+    VkRenderPassCreateInfo render_pass_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    render_pass_info.attachmentCount = static_cast<uint32_t>(descriptions.size());
+    render_pass_info.pAttachments = descriptions.data();
+    render_pass_info.subpassCount = subpasses_count;
+    render_pass_info.pSubpasses = subpasses.data();
+    render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    render_pass_info.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(m_device, &render_pass_info, nullptr, &group.m_render_pass) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create render pass of the render graph!");
+    }
+    group.m_dependencies_count = static_cast<uint32_t>(dependencies.size());
+
+    for (uint32_t i = 0; i < group.m_attachments.size(); ++i)
+    {
+        layouts[group.m_attachments[i]] = descriptions[i].finalLayout;
+        written[group.m_attachments[i]] = true;
+    }
+}
+
+uint32_t RenderGraph::find_lazy_memory_type(uint32_t type_bits, const DeviceMemoryAllocator& allocator) const
+{
+    const auto& properties = allocator.memory_properties();
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+    {
+        if ((type_bits & (1u << i)) != 0 &&
+            (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
+        {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+void RenderGraph::create_targets(DeviceMemoryAllocator& allocator, VkExtent2D extent,
+                                 const unordered_map<string, vector<VkImageView>>& imported_views)
+{
+    m_extent = extent;
+    m_memory_report = {};
+    m_targets.m_images.assign(m_resources.size(), VK_NULL_HANDLE);
+    m_targets.m_views.assign(m_resources.size(), VK_NULL_HANDLE);
+
+    vector<VkMemoryRequirements> requirements(m_resources.size());
+    vector<uint32_t> aliased;
+    for (uint32_t r = 0; r < m_resources.size(); ++r)
+    {
+        const Resource& resource = m_resources[r];
+        if (resource.m_imported || resource.m_first_group == UINT32_MAX)
+        {
+            continue;
+        }
+
+        VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = resource.m_format;
+        image_info.extent = {extent.width, extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = resource.m_depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        image_info.usage |= (resource.m_input ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : 0) |
+                            (resource.m_sampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0) |
+                            (resource.m_transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(m_device, &image_info, nullptr, &m_targets.m_images[r]) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create render graph image " + resource.m_name + "!");
+        }
+        vkGetImageMemoryRequirements(m_device, m_targets.m_images[r], &requirements[r]);
+        m_memory_report.m_separate_bytes += requirements[r].size;
+
+        uint32_t lazy_type = resource.m_transient ? find_lazy_memory_type(requirements[r].memoryTypeBits, allocator) : UINT32_MAX;
+        if (lazy_type == UINT32_MAX)
+        {
+            aliased.push_back(r);
+            m_memory_report.m_aliasable_bytes += requirements[r].size;
+            continue;
+        }
+
+        // lazily allocated memory is a separate heap, which the allocator does not manage
+        VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocate_info.allocationSize = requirements[r].size;
+        allocate_info.memoryTypeIndex = lazy_type;
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(m_device, &allocate_info, nullptr, &memory) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to allocate lazily allocated memory for " + resource.m_name + "!");
+        }
+        m_targets.m_lazy_memory.push_back(memory);
+        vkBindImageMemory(m_device, m_targets.m_images[r], memory, 0);
+        m_memory_report.m_lazy_bytes += requirements[r].size;
+    }
+
+    // greedy interval packing: images, which are not alive in the same render pass, share memory
+    struct Slot
+    {
+        uint32_t m_last_group;
+        VkMemoryRequirements m_requirements;
+        vector<uint32_t> m_resources;
+    };
+    sort(aliased.begin(), aliased.end(),
+         [this](uint32_t a, uint32_t b) { return m_resources[a].m_first_group < m_resources[b].m_first_group; });
+    vector<Slot> slots;
+    for (auto r : aliased)
+    {
+        const Resource& resource = m_resources[r];
+        auto slot = find_if(slots.begin(), slots.end(), [&](const Slot& candidate)
+        {
+            return candidate.m_last_group < resource.m_first_group &&
+                   (candidate.m_requirements.memoryTypeBits & requirements[r].memoryTypeBits) != 0;
+        });
+        if (slot == slots.end())
+        {
+            slots.push_back({resource.m_last_group, requirements[r], {r}});
+            continue;
+        }
+        slot->m_last_group = resource.m_last_group;
+        slot->m_requirements.size = max(slot->m_requirements.size, requirements[r].size);
+        slot->m_requirements.alignment = max(slot->m_requirements.alignment, requirements[r].alignment);
+        slot->m_requirements.memoryTypeBits &= requirements[r].memoryTypeBits;
+        slot->m_resources.push_back(r);
+    }
+    for (const auto& slot : slots)
+    {
+        MemoryAllocation allocation = allocator.allocate(slot.m_requirements, MemoryUsage::GpuOnly, ResourceTiling::Optimal);
+        for (auto r : slot.m_resources)
+        {
+            vkBindImageMemory(m_device, m_targets.m_images[r], allocation.m_memory, allocation.m_offset);
+        }
+        m_targets.m_allocations.push_back(allocation);
+        m_memory_report.m_aliased_bytes += slot.m_requirements.size;
+    }
+
+    for (uint32_t r = 0; r < m_resources.size(); ++r)
+    {
+        if (m_targets.m_images[r] == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        view_info.image = m_targets.m_images[r];
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = m_resources[r].m_format;
+        view_info.subresourceRange.aspectMask = m_resources[r].m_depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_device, &view_info, nullptr, &m_targets.m_views[r]) != VK_SUCCESS)
+        {
+            throw runtime_error("Failed to create render graph image view " + m_resources[r].m_name + "!");
+        }
+    }
+
+    // one framebuffer per image index, if the render pass uses imported images
+    size_t images_count = 1;
+    for (const auto& resource : m_resources)
+    {
+        if (!resource.m_imported)
+        {
+            continue;
+        }
+        auto views = imported_views.find(resource.m_name);
+        if (views == imported_views.end() || views->second.empty())
+        {
+            throw runtime_error("Render graph attachment " + resource.m_name + " is not provided!");
+        }
+        images_count = max(images_count, views->second.size());
+    }
+
+    m_targets.m_framebuffers.resize(m_groups.size());
+    for (uint32_t g = 0; g < m_groups.size(); ++g)
+    {
+        const Group& group = m_groups[g];
+        bool imported = any_of(group.m_attachments.begin(), group.m_attachments.end(),
+                               [this](uint32_t resource) { return m_resources[resource].m_imported; });
+        m_targets.m_framebuffers[g].resize(imported ? images_count : 1);
+        for (size_t i = 0; i < m_targets.m_framebuffers[g].size(); ++i)
+        {
+            vector<VkImageView> views;
+            for (auto resource : group.m_attachments)
+            {
+                const auto& name = m_resources[resource].m_name;
+                views.push_back(m_resources[resource].m_imported ? imported_views.at(name).at(i) : m_targets.m_views[resource]);
+            }
+
+            VkFramebufferCreateInfo framebuffer_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+            framebuffer_info.renderPass = group.m_render_pass;
+            framebuffer_info.attachmentCount = static_cast<uint32_t>(views.size());
+            framebuffer_info.pAttachments = views.data();
+            framebuffer_info.width = extent.width;
+            framebuffer_info.height = extent.height;
+            framebuffer_info.layers = 1;
+            if (vkCreateFramebuffer(m_device, &framebuffer_info, nullptr, &m_targets.m_framebuffers[g][i]) != VK_SUCCESS)
+            {
+                throw runtime_error("Failed to create render graph framebuffer!");
+            }
+        }
+    }
+}
+
+function<void()> RenderGraph::release_targets(DeviceMemoryAllocator& allocator)
+{
+    Targets targets;
+    swap(targets, m_targets);
+    VkDevice device = m_device;
+    DeviceMemoryAllocator* memory_allocator = &allocator;
+    return [device, memory_allocator, targets]() mutable
+    {
+        for (const auto& framebuffers : targets.m_framebuffers)
+        {
+            for (auto framebuffer : framebuffers)
+            {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+        }
+        for (auto view : targets.m_views)
+        {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (auto image : targets.m_images)
+        {
+            vkDestroyImage(device, image, nullptr);
+        }
+        for (auto& allocation : targets.m_allocations)
+        {
+            memory_allocator->free(allocation);
+        }
+        for (auto memory : targets.m_lazy_memory)
+        {
+            vkFreeMemory(device, memory, nullptr);
+        }
+    };
+}
+
+void RenderGraph::destroy(DeviceMemoryAllocator& allocator)
+{
+    release_targets(allocator)();
+    for (auto& group : m_groups)
+    {
+        vkDestroyRenderPass(m_device, group.m_render_pass, nullptr);
+    }
+    m_groups.clear();
+    m_passes.clear();
+    m_resources.clear();
+    m_resource_indices.clear();
+}
+
+VkRenderPass RenderGraph::render_pass(const string& pass) const
+{
+    return m_groups[m_passes[pass_index(pass)].m_group].m_render_pass;
+}
+
+uint32_t RenderGraph::subpass(const string& pass) const
+{
+    return m_passes[pass_index(pass)].m_subpass;
+}
+
+VkFramebuffer RenderGraph::framebuffer(const string& pass, uint32_t image_index) const
+{
+    const auto& framebuffers = m_targets.m_framebuffers[m_passes[pass_index(pass)].m_group];
+    return framebuffers[framebuffers.size() == 1 ? 0 : image_index];
+}
+
+VkImageView RenderGraph::attachment_view(const string& attachment) const
+{
+    return m_targets.m_views[resource_index(attachment)];
+}
+
+void RenderGraph::set_subpass_contents(const string& pass, VkSubpassContents contents)
+{
+    m_passes[pass_index(pass)].m_contents = contents;
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, uint32_t image_index) const
+{
+    for (uint32_t g = 0; g < m_groups.size(); ++g)
+    {
+        const Group& group = m_groups[g];
+        const auto& framebuffers = m_targets.m_framebuffers[g];
+
+        VkRenderPassBeginInfo render_pass_info = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        render_pass_info.renderPass = group.m_render_pass;
+        render_pass_info.framebuffer = framebuffers[framebuffers.size() == 1 ? 0 : image_index];
+        render_pass_info.renderArea.offset = {0, 0};
+        render_pass_info.renderArea.extent = m_extent;
+        render_pass_info.clearValueCount = static_cast<uint32_t>(group.m_clear_values.size());
+        render_pass_info.pClearValues = group.m_clear_values.data();
+
+        for (uint32_t s = 0; s < group.m_passes.size(); ++s)
+        {
+            const Pass& pass = m_passes[group.m_passes[s]];
+            if (s == 0)
+            {
+                vkCmdBeginRenderPass(command_buffer, &render_pass_info, pass.m_contents);
+            }
+            else
+            {
+                vkCmdNextSubpass(command_buffer, pass.m_contents);
+            }
+            if (pass.m_description.m_record)
+            {
+                pass.m_description.m_record(command_buffer, image_index);
+            }
+        }
+        vkCmdEndRenderPass(command_buffer);
+    }
+}
+
+void RenderGraph::print_report(ostream& out) const
+{
+    uint32_t dependencies_count = 0;
+    for (const auto& group : m_groups)
+    {
+        dependencies_count += group.m_dependencies_count;
+    }
+    // work recorded outside of the graph (culling, uploads) has its own barriers
+    out << "Render graph: " << m_passes.size() << " pass(es) in " << m_groups.size() << " render pass(es), "
+        << dependencies_count << " subpass dependencies, no pipeline barriers between graph passes" << endl;
+    for (uint32_t g = 0; g < m_groups.size(); ++g)
+    {
+        out << "  render pass " << g << ":";
+        for (auto pass : m_groups[g].m_passes)
+        {
+            out << " " << m_passes[pass].m_description.m_name;
+        }
+        out << " (" << m_groups[g].m_attachments.size() << " attachment(s))" << endl;
+    }
+
+    const auto& report = m_memory_report;
+    out << "  attachments: " << report.m_separate_bytes / 1024 << " KB with own memory each, "
+        << report.m_lazy_bytes / 1024 << " KB of it lazily allocated" << endl
+        << "  aliasing: " << report.m_aliasable_bytes / 1024 << " KB of the other attachments in "
+        << report.m_aliased_bytes / 1024 << " KB allocated, "
+        << (report.m_aliasable_bytes - report.m_aliased_bytes) / 1024 << " KB saved" << endl;
+}
@@ -0,0 +1,241 @@
+#include "StagingRing.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    // keeps memcpy destinations aligned and satisfies optimalBufferCopyOffsetAlignment of common drivers
+    constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+    double elapsed_ms(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+double StagingStatistics::throughput_mb_per_second() const
+{
+    if (m_upload_ms <= 0.0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(m_uploaded_bytes) / (1024.0 * 1024.0) / (m_upload_ms / 1000.0);
+}
+
+void StagingRing::create(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue queue, uint32_t queue_family,
+                         uint32_t frames_count, VkDeviceSize capacity)
+{
+    m_device = device;
+    m_queue = queue;
+    m_allocator = &allocator;
+    m_flushed = 0;
+    m_unsubmitted = false;
+    m_arena.create(allocator, capacity / max(frames_count, 1u), frames_count, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   COPY_ALIGNMENT);
+
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+
+    if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_command_pool) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create staging command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocate_info.commandPool = m_command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(m_device, &allocate_info, &m_command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to allocate staging command buffer!");
+    }
+
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    if (vkCreateFence(m_device, &fence_info, nullptr, &m_fence) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create staging fence!");
+    }
+}
+
+void StagingRing::destroy(DeviceMemoryAllocator& allocator)
+{
+    vkDestroyFence(m_device, m_fence, nullptr);
+    vkDestroyCommandPool(m_device, m_command_pool, nullptr);
+    m_arena.destroy(allocator);
+
+    m_fence = VK_NULL_HANDLE;
+    m_command_pool = VK_NULL_HANDLE;
+    m_command_buffer = VK_NULL_HANDLE;
+    m_pending.clear();
+    m_pending_index.clear();
+}
+
+void StagingRing::upload(VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size)
+{
+    auto start = chrono::steady_clock::now();
+
+    // chunk of the region size always fits into the rewound region
+    const VkDeviceSize max_chunk = m_arena.frame_capacity();
+    auto source = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        VkDeviceSize chunk = min(size, max_chunk);
+        auto allocation = reserve(chunk);
+        memcpy(allocation.m_mapped, source, chunk);
+
+        auto found = m_pending_index.find(destination);
+        if (found == m_pending_index.end())
+        {
+            found = m_pending_index.emplace(destination, m_pending.size()).first;
+            m_pending.push_back({destination, {}});
+        }
+        m_pending[found->second].m_regions.push_back({allocation.m_offset, destination_offset, chunk});
+
+        m_statistics.m_uploaded_bytes += chunk;
+        ++m_statistics.m_copies_count;
+        source += chunk;
+        destination_offset += chunk;
+        size -= chunk;
+    }
+
+    m_statistics.m_upload_ms += elapsed_ms(start);
+}
+
+void StagingRing::flush(VkCommandBuffer command_buffer, VkPipelineStageFlags destination_stages, VkAccessFlags destination_access)
+{
+    if (m_pending.empty())
+    {
+        return;
+    }
+    record_copies(command_buffer, destination_stages, destination_access);
+    m_unsubmitted = true;
+}
+
+void StagingRing::end_frame()
+{
+    m_unsubmitted = false;
+}
+
+void StagingRing::begin_frame(uint32_t frame_index)
+{
+    // copies pending in the region of another frame slot (uploads between frames) would be read by this
+    // frame, but that region is rewound after fence of its own slot, so they are executed right away
+    if (!m_pending.empty() && frame_index != m_arena.current_frame())
+    {
+        auto start = chrono::steady_clock::now();
+        submit_pending_and_wait();
+        ++m_statistics.m_stalls_count;
+        m_statistics.m_stall_ms += elapsed_ms(start);
+    }
+
+    // copies uploaded before the first frame stay in the region and are flushed by it
+    if (m_pending.empty())
+    {
+        m_arena.begin_frame(frame_index);
+        m_flushed = 0;
+    }
+}
+
+LinearArena::Allocation StagingRing::reserve(VkDeviceSize size)
+{
+    LinearArena::Allocation allocation;
+    if (m_arena.allocate(size, allocation))
+    {
+        return allocation;
+    }
+
+    if (m_unsubmitted)
+    {
+        throw runtime_error("Staging ring is full of copies, which are recorded but not submitted!");
+    }
+
+    // fence of the submission also covers frames submitted to the queue before, which read the region
+    auto start = chrono::steady_clock::now();
+    submit_pending_and_wait();
+    m_arena.rewind();
+    m_flushed = 0;
+    ++m_statistics.m_stalls_count;
+    m_statistics.m_stall_ms += elapsed_ms(start);
+
+    if (!m_arena.allocate(size, allocation))
+    {
+        throw runtime_error("Staging upload does not fit into the ring!");
+    }
+    return allocation;
+}
+
+void StagingRing::submit_pending_and_wait()
+{
+    vkResetCommandBuffer(m_command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(m_command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to begin recording staging command buffer!");
+    }
+
+    // barrier in this submission also covers commands submitted later to the queue
+    record_copies(m_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT);
+
+    if (vkEndCommandBuffer(m_command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to record staging command buffer!");
+    }
+
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &m_command_buffer;
+
+    if (vkQueueSubmit(m_queue, 1, &submit_info, m_fence) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to submit staging command buffer!");
+    }
+    vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, numeric_limits<uint64_t>::max());
+    vkResetFences(m_device, 1, &m_fence);
+}
+
+void StagingRing::record_copies(VkCommandBuffer command_buffer, VkPipelineStageFlags destination_stages,
+                                VkAccessFlags destination_access)
+{
+    m_arena.flush(*m_allocator, m_flushed);
+
+    // write-after-read: previous frame may still read the destination buffers
+    vkCmdPipelineBarrier(command_buffer, destination_stages, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    for (const auto& pending : m_pending)
+    {
+        vkCmdCopyBuffer(command_buffer, m_arena.buffer().m_buffer, pending.m_destination,
+                        static_cast<uint32_t>(pending.m_regions.size()), pending.m_regions.data());
+        ++m_statistics.m_batches_count;
+    }
+
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = destination_access;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, destination_stages,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_pending.clear();
+    m_pending_index.clear();
+    m_flushed = m_arena.frame_used();
+}
+
+void StagingRing::print_statistics(ostream& out) const
+{
+    out << fixed << setprecision(3)
+        << "Staging ring (" << capacity() / (1024 * 1024) << " MB):" << endl
+        << "  uploaded:   " << static_cast<double>(m_statistics.m_uploaded_bytes) / (1024.0 * 1024.0) << " MB in "
+        << m_statistics.m_copies_count << " copies, " << m_statistics.m_batches_count << " vkCmdCopyBuffer calls" << endl
+        << "  throughput: " << m_statistics.throughput_mb_per_second() << " MB/s" << endl
+        << "  stalls:     " << m_statistics.m_stalls_count << " (" << m_statistics.m_stall_ms << " ms)" << endl;
+    out << defaultfloat;
+}
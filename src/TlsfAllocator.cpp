@@ -0,0 +1,326 @@
+#include "TlsfAllocator.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    uint32_t most_significant_bit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    uint32_t least_significant_bit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+    }
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity)
+    : m_capacity(capacity)
+{
+    if (capacity == 0)
+    {
+        throw invalid_argument("TLSF allocator capacity should not be zero!");
+    }
+
+    for (auto& free_list : m_free_lists)
+    {
+        fill(begin(free_list), end(free_list), INVALID_ALLOCATION);
+    }
+    insert_free_node(create_node(0, capacity));
+}
+
+void TlsfAllocator::mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < SL_COUNT)
+    {
+        // small sizes are not split into powers of two, every size has its own list
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+    }
+    else
+    {
+        auto msb = most_significant_bit(size);
+        fl = msb - SL_BITS + 1;
+        sl = static_cast<uint32_t>(size >> (msb - SL_BITS)) - SL_COUNT;
+    }
+}
+
+void TlsfAllocator::mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    // round up to the next size class, so any range found there is big enough
+    if (size >= SL_COUNT)
+    {
+        size += (1ull << (most_significant_bit(size) - SL_BITS)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+uint32_t TlsfAllocator::find_suitable_node(uint32_t fl, uint32_t sl) const
+{
+    if (fl >= FL_COUNT)
+    {
+        return INVALID_ALLOCATION;
+    }
+
+    uint32_t sl_map = m_sl_bitmaps[fl] & (~0u << sl);
+    if (sl_map == 0)
+    {
+        uint64_t fl_map = (fl + 1 < FL_COUNT) ? (m_fl_bitmap & (~0ull << (fl + 1))) : 0;
+        if (fl_map == 0)
+        {
+            return INVALID_ALLOCATION;
+        }
+        fl = least_significant_bit(fl_map);
+        sl_map = m_sl_bitmaps[fl];
+    }
+    sl = least_significant_bit(sl_map);
+    return m_free_lists[fl][sl];
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    size = max<uint64_t>(size, 1);
+    alignment = max<uint64_t>(alignment, 1);
+
+    // worst case alignment padding is reserved, so the first range of the class fits
+    uint64_t search_size = size + alignment - 1;
+    if (search_size < size || size > m_capacity)
+    {
+        return INVALID_ALLOCATION;
+    }
+
+    uint32_t fl, sl;
+    mapping_search(search_size, fl, sl);
+    uint32_t node = find_suitable_node(fl, sl);
+    if (node == INVALID_ALLOCATION)
+    {
+        node = find_fitting_node(size, alignment, fl, sl);
+        if (node == INVALID_ALLOCATION)
+        {
+            return INVALID_ALLOCATION;
+        }
+    }
+    remove_free_node(node);
+
+    uint64_t aligned_offset = align_up(m_nodes[node].m_offset, alignment);
+    uint64_t padding = aligned_offset - m_nodes[node].m_offset;
+    if (padding > 0)
+    {
+        // previous physical range can't be free, otherwise it would be merged with this one
+        uint32_t front = create_node(m_nodes[node].m_offset, padding);
+        m_nodes[front].m_prev_physical = m_nodes[node].m_prev_physical;
+        m_nodes[front].m_next_physical = node;
+        if (m_nodes[node].m_prev_physical != INVALID_ALLOCATION)
+        {
+            m_nodes[m_nodes[node].m_prev_physical].m_next_physical = front;
+        }
+        m_nodes[node].m_prev_physical = front;
+        m_nodes[node].m_offset = aligned_offset;
+        m_nodes[node].m_size -= padding;
+        insert_free_node(front);
+    }
+
+    if (m_nodes[node].m_size > size)
+    {
+        uint32_t back = create_node(m_nodes[node].m_offset + size, m_nodes[node].m_size - size);
+        m_nodes[back].m_prev_physical = node;
+        m_nodes[back].m_next_physical = m_nodes[node].m_next_physical;
+        if (m_nodes[node].m_next_physical != INVALID_ALLOCATION)
+        {
+            m_nodes[m_nodes[node].m_next_physical].m_prev_physical = back;
+        }
+        m_nodes[node].m_next_physical = back;
+        m_nodes[node].m_size = size;
+        insert_free_node(back);
+    }
+
+    m_used += size;
+    ++m_allocations_count;
+    return node;
+}
+
+void TlsfAllocator::free(uint32_t allocation)
+{
+    if (allocation >= m_nodes.size() || m_nodes[allocation].m_is_free)
+    {
+        throw invalid_argument("Invalid TLSF allocation is freed!");
+    }
+
+    m_used -= m_nodes[allocation].m_size;
+    --m_allocations_count;
+
+    uint32_t prev = m_nodes[allocation].m_prev_physical;
+    if (prev != INVALID_ALLOCATION && m_nodes[prev].m_is_free)
+    {
+        remove_free_node(prev);
+        m_nodes[allocation].m_offset = m_nodes[prev].m_offset;
+        m_nodes[allocation].m_size += m_nodes[prev].m_size;
+        m_nodes[allocation].m_prev_physical = m_nodes[prev].m_prev_physical;
+        if (m_nodes[prev].m_prev_physical != INVALID_ALLOCATION)
+        {
+            m_nodes[m_nodes[prev].m_prev_physical].m_next_physical = allocation;
+        }
+        release_node(prev);
+    }
+
+    uint32_t next = m_nodes[allocation].m_next_physical;
+    if (next != INVALID_ALLOCATION && m_nodes[next].m_is_free)
+    {
+        remove_free_node(next);
+        m_nodes[allocation].m_size += m_nodes[next].m_size;
+        m_nodes[allocation].m_next_physical = m_nodes[next].m_next_physical;
+        if (m_nodes[next].m_next_physical != INVALID_ALLOCATION)
+        {
+            m_nodes[m_nodes[next].m_next_physical].m_prev_physical = allocation;
+        }
+        release_node(next);
+    }
+
+    insert_free_node(allocation);
+}
+
+uint32_t TlsfAllocator::find_fitting_node(uint64_t size, uint64_t alignment, uint32_t search_fl, uint32_t search_sl) const
+{
+    // classes below the rounded up one may still have a range big enough (e.g. the whole capacity),
+    // their ranges are checked one by one. Classes are numbered in ascending size order
+    uint32_t fl, sl;
+    mapping_insert(size, fl, sl);
+    uint32_t end_class = min(search_fl * SL_COUNT + search_sl, FL_COUNT * SL_COUNT);
+    for (uint32_t size_class = fl * SL_COUNT + sl; size_class < end_class; ++size_class)
+    {
+        if ((m_sl_bitmaps[size_class / SL_COUNT] & (1u << (size_class % SL_COUNT))) == 0)
+        {
+            continue;
+        }
+        for (uint32_t node = m_free_lists[size_class / SL_COUNT][size_class % SL_COUNT]; node != INVALID_ALLOCATION;
+             node = m_nodes[node].m_next_free)
+        {
+            uint64_t padding = align_up(m_nodes[node].m_offset, alignment) - m_nodes[node].m_offset;
+            if (m_nodes[node].m_size >= padding + size)
+            {
+                return node;
+            }
+        }
+    }
+    return INVALID_ALLOCATION;
+}
+
+uint64_t TlsfAllocator::largest_free_range() const
+{
+    if (m_fl_bitmap == 0)
+    {
+        return 0;
+    }
+
+    // ranges of the highest non-empty class are not sorted, check all of them
+    uint32_t fl = most_significant_bit(m_fl_bitmap);
+    uint32_t sl = most_significant_bit(m_sl_bitmaps[fl]);
+    uint64_t largest = 0;
+    for (uint32_t node = m_free_lists[fl][sl]; node != INVALID_ALLOCATION; node = m_nodes[node].m_next_free)
+    {
+        largest = max(largest, m_nodes[node].m_size);
+    }
+    return largest;
+}
+
+void TlsfAllocator::insert_free_node(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping_insert(m_nodes[node].m_size, fl, sl);
+
+    uint32_t head = m_free_lists[fl][sl];
+    m_nodes[node].m_is_free = true;
+    m_nodes[node].m_prev_free = INVALID_ALLOCATION;
+    m_nodes[node].m_next_free = head;
+    if (head != INVALID_ALLOCATION)
+    {
+        m_nodes[head].m_prev_free = node;
+    }
+    m_free_lists[fl][sl] = node;
+
+    m_fl_bitmap |= 1ull << fl;
+    m_sl_bitmaps[fl] |= 1u << sl;
+    ++m_free_ranges_count;
+}
+
+void TlsfAllocator::remove_free_node(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping_insert(m_nodes[node].m_size, fl, sl);
+
+    uint32_t prev = m_nodes[node].m_prev_free;
+    uint32_t next = m_nodes[node].m_next_free;
+    if (prev != INVALID_ALLOCATION)
+    {
+        m_nodes[prev].m_next_free = next;
+    }
+    else
+    {
+        m_free_lists[fl][sl] = next;
+    }
+    if (next != INVALID_ALLOCATION)
+    {
+        m_nodes[next].m_prev_free = prev;
+    }
+
+    if (m_free_lists[fl][sl] == INVALID_ALLOCATION)
+    {
+        m_sl_bitmaps[fl] &= ~(1u << sl);
+        if (m_sl_bitmaps[fl] == 0)
+        {
+            m_fl_bitmap &= ~(1ull << fl);
+        }
+    }
+
+    m_nodes[node].m_is_free = false;
+    m_nodes[node].m_prev_free = INVALID_ALLOCATION;
+    m_nodes[node].m_next_free = INVALID_ALLOCATION;
+    --m_free_ranges_count;
+}
+
+uint32_t TlsfAllocator::create_node(uint64_t offset, uint64_t size)
+{
+    uint32_t node;
+    if (!m_unused_nodes.empty())
+    {
+        node = m_unused_nodes.back();
+        m_unused_nodes.pop_back();
+        m_nodes[node] = Node();
+    }
+    else
+    {
+        node = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    m_nodes[node].m_offset = offset;
+    m_nodes[node].m_size = size;
+    return node;
+}
+
+void TlsfAllocator::release_node(uint32_t node)
+{
+    m_nodes[node] = Node();
+    m_unused_nodes.push_back(node);
+}
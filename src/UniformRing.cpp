@@ -0,0 +1,71 @@
+#include "UniformRing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void UniformRing::create(VkPhysicalDevice gpu, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                         uint32_t frames_count, VkShaderStageFlags stages, VkDeviceSize range,
+                         VkDeviceSize frame_capacity)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+    m_alignment = max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    m_range = range;
+    m_arena.create(allocator, max(frame_capacity, range), frames_count, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, m_alignment);
+
+    m_set_layout = descriptors.layout({{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, stages, nullptr}});
+    for (uint32_t i = 0; i < m_arena.frames_count(); ++i)
+    {
+        m_descriptor_sets.push_back(descriptors.static_set(m_set_layout,
+        {
+            {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, {m_arena.buffer().m_buffer, m_arena.frame_offset(i), m_range}}
+        }));
+    }
+}
+
+void UniformRing::destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator)
+{
+    descriptors.release_buffer(m_arena.buffer().m_buffer);
+    m_arena.destroy(allocator);
+    m_descriptor_sets.clear();
+    m_set_layout = VK_NULL_HANDLE;
+}
+
+void UniformRing::begin_frame(uint32_t frame_index)
+{
+    m_arena.begin_frame(frame_index);
+}
+
+uint32_t UniformRing::push(const void* data, VkDeviceSize size)
+{
+    if (size > m_range)
+    {
+        throw runtime_error("Uniform data is bigger than range of the uniform ring binding!");
+    }
+
+    // dynamic offset is relative to the region of the frame, which is the base of its descriptor set.
+    // Shaders see the whole range after the offset, so it should be inside of the region
+    LinearArena::Allocation allocation;
+    bool allocated = m_arena.allocate(size, allocation);
+    VkDeviceSize offset = allocation.m_offset - m_arena.frame_offset(m_arena.current_frame());
+    if (!allocated || offset + m_range > m_arena.frame_capacity())
+    {
+        throw runtime_error("Uniform ring of the frame is full!");
+    }
+
+    memcpy(allocation.m_mapped, data, static_cast<size_t>(size));
+    ++m_allocations_count;
+    return static_cast<uint32_t>(offset);
+}
+
+void UniformRing::end_frame(const DeviceMemoryAllocator& allocator) const
+{
+    m_arena.flush(allocator);
+}
+
+void UniformRing::print_statistics(ostream& out) const
+{
+    out << "Uniform ring: " << m_arena.frames_count() << " x " << m_arena.frame_capacity() / 1024 << " KB, "
+        << m_allocations_count << " allocation(s), peak " << m_arena.peak_used()
+        << " bytes per frame, alignment " << m_alignment << endl;
+}
@@ -0,0 +1,343 @@
+#include "UploadService.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    double elapsed_ms(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+void UploadService::create(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue transfer_queue,
+                           uint32_t transfer_family, uint32_t graphics_family, VkDeviceSize capacity)
+{
+    m_device = device;
+    m_queue = transfer_queue;
+    m_allocator = &allocator;
+    m_transfer_family = transfer_family;
+    m_graphics_family = graphics_family;
+    m_capacity = align_up(capacity, COPY_ALIGNMENT);
+
+    m_buffer = allocator.create_buffer(m_capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::CpuToGpu);
+    if (m_buffer.m_memory.m_mapped == nullptr)
+    {
+        throw runtime_error("Upload staging memory is not mapped!");
+    }
+
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = m_transfer_family;
+
+    if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_command_pool) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create transfer command pool!");
+    }
+}
+
+void UploadService::destroy(DeviceMemoryAllocator& allocator)
+{
+    auto destroy_batch = [this](const unique_ptr<Batch>& batch)
+    {
+        vkDestroyFence(m_device, batch->m_fence, nullptr);
+        vkDestroySemaphore(m_device, batch->m_semaphore, nullptr);
+    };
+    for_each(m_in_flight.begin(), m_in_flight.end(), destroy_batch);
+    for_each(m_free_batches.begin(), m_free_batches.end(), destroy_batch);
+    m_in_flight.clear();
+    m_free_batches.clear();
+    m_frame_batches.clear();
+    m_pending.clear();
+
+    vkDestroyCommandPool(m_device, m_command_pool, nullptr);
+    m_command_pool = VK_NULL_HANDLE;
+    allocator.destroy_buffer(m_buffer);
+}
+
+void UploadService::upload(VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size)
+{
+    auto start = chrono::steady_clock::now();
+
+    const VkDeviceSize max_chunk = m_capacity / 2;
+    auto source = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        VkDeviceSize chunk = min(size, max_chunk);
+        VkDeviceSize offset = reserve(chunk);
+        memcpy(static_cast<char*>(m_buffer.m_memory.m_mapped) + offset, source, chunk);
+        m_pending.push_back({destination, {offset, destination_offset, chunk}});
+
+        m_statistics.m_uploaded_bytes += chunk;
+        ++m_statistics.m_copies_count;
+        source += chunk;
+        destination_offset += chunk;
+        size -= chunk;
+    }
+
+    m_statistics.m_upload_ms += elapsed_ms(start);
+}
+
+VkDeviceSize UploadService::reserve(VkDeviceSize size)
+{
+    size = align_up(size, COPY_ALIGNMENT);
+
+    VkDeviceSize offset = m_head % m_capacity;
+    VkDeviceSize padding = offset + size > m_capacity ? m_capacity - offset : 0;
+    auto free_space = [this]() { return m_capacity - (m_head - m_tail); };
+
+    if (free_space() < padding + size)
+    {
+        retire_batches(false);
+    }
+    if (free_space() < padding + size)
+    {
+        auto start = chrono::steady_clock::now();
+        while (free_space() < padding + size)
+        {
+            // pending copies are the only thing holding the space
+            if (none_of(m_in_flight.begin(), m_in_flight.end(), [this](const unique_ptr<Batch>& batch) { return batch->m_head > m_tail; }))
+            {
+                submit();
+            }
+            retire_batches(true);
+        }
+        ++m_statistics.m_stalls_count;
+        m_statistics.m_stall_ms += elapsed_ms(start);
+    }
+
+    m_head += padding;
+    offset = m_head % m_capacity;
+    m_head += size;
+    return offset;
+}
+
+bool UploadService::is_signaled(VkFence fence) const
+{
+    return fence != VK_NULL_HANDLE && vkGetFenceStatus(m_device, fence) == VK_SUCCESS;
+}
+
+void UploadService::retire_batches(bool wait)
+{
+    // staging space is free as soon as the copies are done, batches complete in submission order
+    for (const auto& batch : m_in_flight)
+    {
+        if (batch->m_head <= m_tail)
+        {
+            continue;
+        }
+        if (wait)
+        {
+            vkWaitForFences(m_device, 1, &batch->m_fence, VK_TRUE, numeric_limits<uint64_t>::max());
+            wait = false;
+        }
+        else if (!is_signaled(batch->m_fence))
+        {
+            break;
+        }
+        m_tail = batch->m_head;
+    }
+
+    // semaphore may be signaled again only after the graphics submission waited for it
+    while (!m_in_flight.empty() && m_in_flight.front()->m_head <= m_tail && is_signaled(m_in_flight.front()->m_consumer))
+    {
+        auto batch = move(m_in_flight.front());
+        m_in_flight.pop_front();
+        vkResetFences(m_device, 1, &batch->m_fence);
+        batch->m_consumer = VK_NULL_HANDLE;
+        batch->m_buffers.clear();
+        batch->m_acquired = false;
+        m_free_batches.push_back(move(batch));
+    }
+}
+
+UploadService::Batch& UploadService::free_batch()
+{
+    retire_batches(false);
+    if (!m_free_batches.empty())
+    {
+        m_in_flight.push_back(move(m_free_batches.back()));
+        m_free_batches.pop_back();
+        return *m_in_flight.back();
+    }
+
+    auto batch = make_unique<Batch>();
+
+    VkCommandBufferAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocate_info.commandPool = m_command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(m_device, &allocate_info, &batch->m_command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to allocate transfer command buffer!");
+    }
+
+    VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    if (vkCreateFence(m_device, &fence_info, nullptr, &batch->m_fence) != VK_SUCCESS ||
+        vkCreateSemaphore(m_device, &semaphore_info, nullptr, &batch->m_semaphore) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to create transfer synchronization objects!");
+    }
+
+    m_in_flight.push_back(move(batch));
+    return *m_in_flight.back();
+}
+
+void UploadService::submit()
+{
+    if (m_pending.empty())
+    {
+        return;
+    }
+
+    Batch& batch = free_batch();
+    vkResetCommandBuffer(batch.m_command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(batch.m_command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to begin recording transfer command buffer!");
+    }
+
+    // non coherent memory: written range may wrap around the end of the ring
+    VkDeviceSize begin = m_submitted_head % m_capacity;
+    VkDeviceSize written = m_head - m_submitted_head;
+    if (begin + written > m_capacity)
+    {
+        m_allocator->flush(m_buffer.m_memory, begin, m_capacity - begin);
+        m_allocator->flush(m_buffer.m_memory, 0, begin + written - m_capacity);
+    }
+    else
+    {
+        m_allocator->flush(m_buffer.m_memory, begin, written);
+    }
+
+    // consecutive regions of one buffer go into one vkCmdCopyBuffer
+    vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < m_pending.size(); ++i)
+    {
+        regions.push_back(m_pending[i].m_copy);
+        VkBuffer destination = m_pending[i].m_destination;
+        if (i + 1 == m_pending.size() || m_pending[i + 1].m_destination != destination)
+        {
+            vkCmdCopyBuffer(batch.m_command_buffer, m_buffer.m_buffer, destination,
+                            static_cast<uint32_t>(regions.size()), regions.data());
+            ++m_statistics.m_batches_count;
+            regions.clear();
+            if (find(batch.m_buffers.begin(), batch.m_buffers.end(), destination) == batch.m_buffers.end())
+            {
+                batch.m_buffers.push_back(destination);
+            }
+        }
+    }
+
+    // release: ownership goes to graphics family, visibility is made by the acquire barrier
+    vector<VkBufferMemoryBarrier> barriers;
+    for (VkBuffer buffer : batch.m_buffers)
+    {
+        VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = m_transfer_family;
+        barrier.dstQueueFamilyIndex = m_graphics_family;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        barriers.push_back(barrier);
+    }
+    vkCmdPipelineBarrier(batch.m_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+    if (vkEndCommandBuffer(batch.m_command_buffer) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to record transfer command buffer!");
+    }
+
+    VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.m_command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &batch.m_semaphore;
+
+    if (vkQueueSubmit(m_queue, 1, &submit_info, batch.m_fence) != VK_SUCCESS)
+    {
+        throw runtime_error("Failed to submit transfer command buffer!");
+    }
+
+    batch.m_head = m_head;
+    m_submitted_head = m_head;
+    m_pending.clear();
+}
+
+void UploadService::acquire(VkCommandBuffer command_buffer, vector<VkSemaphore>& wait_semaphores,
+                            vector<VkPipelineStageFlags>& wait_stages,
+                            VkPipelineStageFlags destination_stages, VkAccessFlags destination_access)
+{
+    submit();
+
+    vector<VkBufferMemoryBarrier> barriers;
+    for (const auto& batch : m_in_flight)
+    {
+        if (batch->m_acquired)
+        {
+            continue;
+        }
+        for (VkBuffer buffer : batch->m_buffers)
+        {
+            VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = destination_access;
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            barriers.push_back(barrier);
+        }
+        batch->m_acquired = true;
+        wait_semaphores.push_back(batch->m_semaphore);
+        wait_stages.push_back(destination_stages);
+        m_frame_batches.push_back(batch.get());
+    }
+
+    if (!barriers.empty())
+    {
+        // source stage matches semaphore wait stage, so the acquire happens after the wait
+        vkCmdPipelineBarrier(command_buffer, destination_stages, destination_stages,
+                             0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+}
+
+void UploadService::end_frame(VkFence graphics_fence)
+{
+    for (auto batch : m_frame_batches)
+    {
+        batch->m_consumer = graphics_fence;
+    }
+    m_frame_batches.clear();
+}
+
+void UploadService::print_statistics(ostream& out) const
+{
+    out << fixed << setprecision(3)
+        << "Transfer queue uploads (" << m_capacity / (1024 * 1024) << " MB staging):" << endl
+        << "  uploaded:   " << static_cast<double>(m_statistics.m_uploaded_bytes) / (1024.0 * 1024.0) << " MB in "
+        << m_statistics.m_copies_count << " copies, " << m_statistics.m_batches_count << " vkCmdCopyBuffer calls" << endl
+        << "  throughput: " << m_statistics.throughput_mb_per_second() << " MB/s (CPU side)" << endl
+        << "  stalls:     " << m_statistics.m_stalls_count << " (" << m_statistics.m_stall_ms << " ms)" << endl;
+    out << defaultfloat;
+}
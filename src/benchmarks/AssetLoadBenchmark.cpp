@@ -0,0 +1,143 @@
+#include "MappedFile.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <iostream>
+#include <random>
+
+/**
+  * Compares read_file (ifstream + heap copy) with MappedFile on a large file.
+  * Both variants touch every byte, so the work done by consumer is the same.
+  *
+  * AssetLoadBenchmark [file] [iterations]
+  * Without a file, temporary file of GENERATED_FILE_SIZE is created.
+  **/
+
+namespace
+{
+    constexpr size_t GENERATED_FILE_SIZE = 256 * 1024 * 1024;
+    constexpr const char* GENERATED_FILE_NAME = "asset_load_benchmark.bin";
+
+    uint64_t checksum(const char* data, size_t size)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            sum += static_cast<uint8_t>(data[i]);
+        }
+        return sum;
+    }
+
+    void generate_file(const string& path, size_t size)
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        mt19937_64 random;
+        vector<uint64_t> chunk(1024 * 1024 / sizeof(uint64_t));
+        for (size_t written = 0; written < size; written += chunk.size() * sizeof(uint64_t))
+        {
+            generate(chunk.begin(), chunk.end(), random);
+            file.write(reinterpret_cast<const char*>(chunk.data()),
+                       static_cast<streamsize>(min(size - written, chunk.size() * sizeof(uint64_t))));
+        }
+        if (!file)
+        {
+            throw runtime_error("Failed to generate benchmark file!");
+        }
+    }
+
+    // MB/s is measured for used_bytes, which the loader checksums
+    template <typename Loader>
+    void run(const string& title, int iterations, size_t used_bytes, Loader loader)
+    {
+        using clock = chrono::steady_clock;
+
+        double best_ms = numeric_limits<double>::max();
+        double total_ms = 0.0;
+        uint64_t result = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            auto start = clock::now();
+            result += loader();
+            auto time_ms = chrono::duration<double, milli>(clock::now() - start).count();
+            best_ms = min(best_ms, time_ms);
+            total_ms += time_ms;
+        }
+
+        double megabytes = static_cast<double>(used_bytes) / (1024.0 * 1024.0);
+        cout << fixed << setprecision(2)
+             << setw(30) << left << title
+             << " best " << setw(9) << right << best_ms << " ms"
+             << "  average " << setw(9) << total_ms / iterations << " ms"
+             << "  " << setw(9) << megabytes / (best_ms / 1000.0) << " MB/s"
+             << "  (checksum " << result / static_cast<uint64_t>(iterations) << ")" << endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string path = argc > 1 ? argv[1] : GENERATED_FILE_NAME;
+    int iterations = argc > 2 ? max(1, atoi(argv[2])) : 10;
+    bool generated = argc <= 1;
+
+    try
+    {
+        if (generated)
+        {
+            generate_file(path, GENERATED_FILE_SIZE);
+        }
+
+        size_t file_size = MappedFile(path, MappedFile::AccessPattern::Normal).size();
+        cout << "File " << path << ", " << file_size << " bytes, " << iterations << " iterations (warm page cache)" << endl;
+
+        run("read_file (ifstream+copy)", iterations, file_size, [&]()
+        {
+            auto buffer = read_file(path);
+            return checksum(buffer.data(), buffer.size());
+        });
+
+        run("MappedFile sequential", iterations, file_size, [&]()
+        {
+            MappedFile file(path, MappedFile::AccessPattern::Sequential);
+            return checksum(file.data(), file.size());
+        });
+
+        run("MappedFile will need", iterations, file_size, [&]()
+        {
+            MappedFile file(path, MappedFile::AccessPattern::WillNeed);
+            return checksum(file.data(), file.size());
+        });
+
+        // typical asset loader use: only header and a part of the file are needed
+        run("read_file, 1/16 used", iterations, file_size / 16, [&]()
+        {
+            auto buffer = read_file(path);
+            return checksum(buffer.data(), buffer.size() / 16);
+        });
+
+        run("MappedFile random, 1/16 used", iterations, file_size / 16, [&]()
+        {
+            MappedFile file(path, MappedFile::AccessPattern::Random);
+            return checksum(file.data(), file.size() / 16);
+        });
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        if (generated)
+        {
+            remove(path.c_str());
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (generated)
+    {
+        remove(path.c_str());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+enum class BenchmarkMode
+{
+    None,
+    Instancing, // instances count sweep from 1k to 10M
+    Recording,  // command recording time for inline recording and 1..N recording threads
+    Compute,    // reduction throughput and frame time with compute on graphics queue and on async compute queue
+    Indirect,   // recording and frame time vs objects count for direct draws and GPU culled indirect draws
+    Pipelines   // creation time of pipeline variants with and without derivatives vs registry lookup time
+};
+
+constexpr uint32_t MAX_RECORDING_THREADS = 32;
+
+enum class PacingPolicy
+{
+    LowestLatency, // MAILBOX or IMMEDIATE, frames are shown as soon as possible
+    LowestPower,   // FIFO with short swapchain, CPU throttled to DEFAULT_POWER_SAVING_FPS
+    Vsync          // strict FIFO, no tearing and no dropped frames
+};
+
+struct ApplicationSettings
+{
+    /**
+      * How many frames CPU is allowed to record ahead of GPU.
+      * 1 - fully serialized CPU/GPU work, 2-3 - usual values for pipelined rendering.
+      **/
+    uint32_t m_frames_in_flight = 2;
+
+    // 0 - render until window is closed
+    uint64_t m_frame_limit = 0;
+
+    /**
+      * Render into offscreen images instead of window swapchain. Does not need
+      * display or presentation support, so works with software drivers (lavapipe).
+      **/
+    bool m_headless = false;
+
+    // pipeline cache blob, kept between runs. Empty - do not persist cache
+    string m_pipeline_cache_path = "pipeline_cache.bin";
+
+    /**
+      * Directory with <name>.spv files, which replace shaders embedded into binary.
+      * Empty - embedded shaders are used.
+      **/
+    string m_shader_directory;
+
+    /**
+      * Development mode: GLSL sources in this directory are watched and recompiled when
+      * saved, pipelines using them are rebuilt in background and swapped between frames.
+      * Empty - no hot reload.
+      **/
+    string m_hot_reload_directory;
+    // where recompiled SPIR-V goes, empty - HOT_RELOAD_SHADER_DIRECTORY. Never m_shader_directory by default,
+    // it may hold checked in .spv files
+    string m_hot_reload_output_directory;
+
+    /**
+      * Triangles, which are regenerated on CPU and streamed to device local vertex
+      * buffer every frame. 0 - static triangle, uploaded once.
+      **/
+    uint32_t m_streamed_triangles = 0;
+
+    uint64_t m_staging_ring_size = 16 * 1024 * 1024;
+
+    // copies of the triangle drawn with one instanced draw call. 0 - no instancing
+    uint32_t m_instances_count = 0;
+
+    /**
+      * Threads, which record draw list into secondary command buffers.
+      * 0 - draw list is recorded inline into primary command buffer by the main thread.
+      **/
+    uint32_t m_recording_threads = 0;
+
+    /**
+      * Draw calls, which instances (or triangles, if there is no instancing) are split into.
+      * 0 - one draw call, DEFAULT_RECORDING_BENCHMARK_DRAWS for recording benchmark.
+      **/
+    uint32_t m_draws_count = 0;
+
+    PacingPolicy m_pacing_policy = PacingPolicy::LowestLatency;
+
+    // frame start is delayed to keep this frame time. 0 - frames are not throttled
+    double m_target_frame_time_ms = 0.0;
+
+    // benchmarks use m_frame_limit as frames per measurement (default DEFAULT_BENCHMARK_FRAMES)
+    BenchmarkMode m_benchmark = BenchmarkMode::None;
+
+    // Chrome trace JSON with GPU scopes of every frame. Empty - trace is not written
+    string m_gpu_trace_path;
+
+    // JSON with CPU time of every startup stage. Empty - only printed
+    string m_startup_report_path;
+
+    // independent initialization stages run on a thread pool. false - one by one on the main thread
+    bool m_parallel_init = true;
+
+    /**
+      * Physical device name substring, UUID or index. Empty - VULKAN_DEVICE environment
+      * variable, if it is not set either - suitable device with the highest score.
+      **/
+    string m_device;
+
+    // static data is uploaded on a dedicated transfer queue, if device has one
+    bool m_transfer_queue = true;
+
+    // compute work runs on a compute only queue family, if device has one
+    bool m_async_compute = true;
+
+    // values summed by every reduction of compute benchmark
+    uint32_t m_compute_elements = 16 * 1024 * 1024;
+
+    // particles simulated by compute shader and drawn as points. 0 - no particles
+    uint32_t m_particles_count = 0;
+
+    // draw list is culled by compute shader and drawn with indirect draws
+    bool m_gpu_driven = false;
+
+    // vertex shaders move every draw and instance by per frame uniforms and per draw push constants
+    bool m_animate = false;
+
+    // scene is drawn into a transient attachment and post processed into the swapchain image
+    bool m_post_process = false;
+};
+
+// there is no window to close in headless mode
+constexpr uint64_t DEFAULT_HEADLESS_FRAME_LIMIT = 1000;
+constexpr uint64_t DEFAULT_BENCHMARK_FRAMES = 200;
+constexpr uint32_t DEFAULT_RECORDING_BENCHMARK_DRAWS = 50000;
+constexpr uint32_t DEFAULT_POWER_SAVING_FPS = 30;
+constexpr uint32_t COMPUTE_BENCHMARK_REDUCTIONS_PER_FRAME = 8;
+constexpr float ANIMATION_AMPLITUDE = 0.05f; // in normalized device coordinates
+constexpr const char* HOT_RELOAD_SHADER_DIRECTORY = "hot_shaders";
+
+ApplicationSettings parse_application_settings(int argc, char** argv);
+void print_application_usage(const string& program_name);
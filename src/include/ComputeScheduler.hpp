@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "GpuProfiler.hpp"
+
+using namespace std;
+
+/**
+  * Per frame compute submissions. On a device with async compute family work goes
+  * to the compute queue and runs concurrently with graphics, otherwise the same
+  * submissions go to graphics queue. Graphics waits for compute results by the
+  * semaphore returned from submit(). Command buffers have their own GPU profiler,
+  * timestamps of the compute queue are not comparable with graphics ones.
+  **/
+class ComputeScheduler
+{
+public:
+    void create(VkPhysicalDevice gpu, VkDevice device, VkQueue queue, uint32_t queue_family,
+                uint32_t frames_count, bool is_async);
+    void destroy();
+
+    bool is_async() const { return m_is_async; }
+    uint32_t queue_family() const { return m_queue_family; }
+    GpuProfiler& profiler() { return m_profiler; }
+
+    // waits for the previous submission of the frame slot, returns its command buffer in recording state
+    VkCommandBuffer begin_frame(uint32_t frame_index, uint64_t frame_number);
+
+    /**
+      * Submits command buffer of the frame. If signal is true, returned semaphore should
+      * be waited by exactly one later submission (graphics frame), otherwise VK_NULL_HANDLE
+      * is returned. wait_semaphore (e.g. graphics finished reading compute output) is optional.
+      **/
+    VkSemaphore submit(uint32_t frame_index, bool signal = true,
+                       VkSemaphore wait_semaphore = VK_NULL_HANDLE, VkPipelineStageFlags wait_stage = 0);
+
+    void wait_idle();
+
+private:
+    struct FrameSubmission
+    {
+        VkCommandPool m_command_pool = VK_NULL_HANDLE;
+        VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+        VkSemaphore m_semaphore = VK_NULL_HANDLE;
+        bool m_submitted = false;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_queue_family = 0;
+    bool m_is_async = false;
+    vector<FrameSubmission> m_frames;
+    GpuProfiler m_profiler;
+};
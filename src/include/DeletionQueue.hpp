@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+using namespace std;
+
+/**
+  * Destruction of objects, which may still be used by frames in flight.
+  * Deleters are tagged with the frame, which was the last one to use the
+  * object, and executed once that frame is known to be complete, so nothing
+  * has to wait for the whole device to become idle.
+  **/
+class DeletionQueue
+{
+public:
+    void push(uint64_t last_use_frame, function<void()> deleter);
+
+    // executes deleters of frames up to completed_frame inclusive, in push order
+    void retire(uint64_t completed_frame);
+
+    // executes everything, device should be idle
+    void flush();
+
+    size_t size() const { return m_deleters.size(); }
+
+private:
+    struct Deleter
+    {
+        uint64_t m_frame;
+        function<void()> m_deleter;
+    };
+
+    deque<Deleter> m_deleters;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// buffer descriptor of one binding, sets are written from a list of them
+struct BufferBinding
+{
+    uint32_t m_binding;
+    VkDescriptorType m_type;
+    VkDescriptorBufferInfo m_info;
+};
+
+// image descriptor of one binding (input attachments, sampled images)
+struct ImageBinding
+{
+    uint32_t m_binding;
+    VkDescriptorType m_type;
+    VkDescriptorImageInfo m_info;
+};
+
+/**
+  * Descriptor pools, which grow by whole pools and are never freed set by set.
+  * When the current pool is exhausted the next one is taken (or created twice as
+  * big), reset() gives all sets back at once with vkResetDescriptorPool.
+  **/
+class DescriptorPoolAllocator
+{
+public:
+    static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    void create(VkDevice device);
+    void destroy();
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    void reset();
+
+    uint32_t pools_count() const { return static_cast<uint32_t>(m_used_pools.size() + m_free_pools.size()); }
+    uint64_t allocated_sets() const { return m_allocated_sets; }
+
+private:
+    VkDescriptorPool create_pool(uint32_t sets_count);
+    VkDescriptorPool take_pool();
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkDescriptorPool m_current = VK_NULL_HANDLE;
+    vector<VkDescriptorPool> m_used_pools; // current one included
+    vector<VkDescriptorPool> m_free_pools; // reset, ready for reuse
+    uint32_t m_next_pool_sets = INITIAL_SETS_PER_POOL;
+    uint64_t m_allocated_sets = 0;         // since creation, for statistics
+};
+
+/**
+  * Descriptor infrastructure of the device:
+  *  - set layouts are cached by their bindings, equal binding lists share one layout;
+  *  - static sets are cached by layout and buffers, so asking for the same set again
+  *    costs one hash lookup; release_buffer() should be called before the buffer is
+  *    destroyed, sets which refer it are recycled for the following static sets;
+  *  - per frame sets come from pools of the frame slot, which are reset wholesale
+  *    by begin_frame(), when fence of the slot is signaled.
+  *
+  * Layouts and static sets are thread safe, per frame sets are used by the thread,
+  * which records the frame.
+  **/
+class DescriptorAllocator
+{
+public:
+    void create(VkDevice device, uint32_t frames_count);
+    void destroy();
+
+    VkDescriptorSetLayout layout(vector<VkDescriptorSetLayoutBinding> bindings);
+    VkDescriptorSet static_set(VkDescriptorSetLayout layout, const vector<BufferBinding>& bindings);
+    // GPU should not use static sets with the buffer anymore
+    void release_buffer(VkBuffer buffer);
+
+    // GPU is done with the previous use of the frame slot
+    void begin_frame(uint32_t frame_index);
+    // valid until the frame slot is used again
+    VkDescriptorSet frame_set(VkDescriptorSetLayout layout, const vector<BufferBinding>& bindings);
+    // images may be recreated with the swapchain, so their sets are allocated per frame
+    VkDescriptorSet frame_image_set(VkDescriptorSetLayout layout, const vector<ImageBinding>& bindings);
+
+    void print_statistics(ostream& out) const;
+
+private:
+    struct LayoutKey
+    {
+        vector<VkDescriptorSetLayoutBinding> m_bindings; // sorted by binding
+
+        bool operator==(const LayoutKey& other) const;
+    };
+
+    struct LayoutKeyHash
+    {
+        size_t operator()(const LayoutKey& key) const;
+    };
+
+    struct SetKey
+    {
+        VkDescriptorSetLayout m_layout;
+        vector<BufferBinding> m_bindings;
+
+        bool operator==(const SetKey& other) const;
+    };
+
+    struct SetKeyHash
+    {
+        size_t operator()(const SetKey& key) const;
+    };
+
+    void write(VkDescriptorSet set, const vector<BufferBinding>& bindings) const;
+    void write(VkDescriptorSet set, const vector<ImageBinding>& bindings) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+
+    mutable mutex m_mutex; // layouts and static sets
+    unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> m_layouts;
+    unordered_map<SetKey, VkDescriptorSet, SetKeyHash> m_static_sets;
+    DescriptorPoolAllocator m_static_pools;
+    unordered_map<VkDescriptorSetLayout, vector<VkDescriptorSet>> m_recycled_sets;
+    uint64_t m_static_set_hits = 0;
+
+    vector<DescriptorPoolAllocator> m_frame_pools;
+    uint32_t m_current_frame = 0;
+};
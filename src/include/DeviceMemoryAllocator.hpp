@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "TlsfAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Part of a VkDeviceMemory block, given to one buffer or image.
+  * m_mapped points to m_offset, if memory is host visible (blocks are persistently mapped).
+  **/
+struct MemoryAllocation
+{
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkDeviceSize m_offset = 0;
+    VkDeviceSize m_size = 0;
+    void* m_mapped = nullptr;
+    uint32_t m_memory_type = 0;
+
+    // owner block and its TLSF allocation, used by DeviceMemoryAllocator::free.
+    // Dedicated blocks are not sub-allocated, they have no TLSF allocation
+    void* m_block = nullptr;
+    uint32_t m_block_allocation = TlsfAllocator::INVALID_ALLOCATION;
+};
+
+enum class MemoryUsage
+{
+    GpuOnly,  // device local, no CPU access
+    CpuToGpu, // host visible, device local if possible (uploads, per-frame data)
+    GpuToCpu  // host visible, cached if possible (readback)
+};
+
+/**
+  * Linear images share pages with buffers without problems,
+  * optimal tiling images should not share bufferImageGranularity page with them.
+  **/
+enum class ResourceTiling
+{
+    Linear,
+    Optimal
+};
+
+struct GpuBuffer
+{
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    MemoryAllocation m_memory;
+    VkDeviceSize m_size = 0;
+};
+
+struct MemoryStatistics
+{
+    uint32_t m_blocks_count = 0;
+    uint32_t m_allocations_count = 0;
+    uint32_t m_free_ranges_count = 0;
+    VkDeviceSize m_allocated_bytes = 0; // taken from driver with vkAllocateMemory
+    VkDeviceSize m_used_bytes = 0;      // given to resources
+    VkDeviceSize m_largest_free_range = 0;
+
+    // 0 - all free memory is one range, close to 1 - free memory is split into small pieces
+    double fragmentation() const;
+};
+
+/**
+  * Grabs big VkDeviceMemory blocks per memory type and sub-allocates resources
+  * from them with TLSF, so resources count is not limited by maxMemoryAllocationCount
+  * and allocation does not go to the driver. Thread safe.
+  **/
+class DeviceMemoryAllocator
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    void create(VkPhysicalDevice gpu, VkDevice device, VkDeviceSize block_size = DEFAULT_BLOCK_SIZE);
+    void destroy();
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceTiling tiling);
+    void free(MemoryAllocation& allocation);
+
+    // allocate and bind in one call
+    MemoryAllocation allocate_for_buffer(VkBuffer buffer, MemoryUsage usage);
+    MemoryAllocation allocate_for_image(VkImage image, MemoryUsage usage, ResourceTiling tiling = ResourceTiling::Optimal);
+
+    // buffer is shared (VK_SHARING_MODE_CONCURRENT) if more than one queue family is given
+    GpuBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memory_usage,
+                            const vector<uint32_t>& queue_families = {});
+    void destroy_buffer(GpuBuffer& buffer);
+
+    // host visible memory, which is not HOST_COHERENT, needs explicit flush after CPU writes
+    void flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+    // and invalidation before CPU reads GPU writes
+    void invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) const;
+    bool is_host_coherent(uint32_t memory_type) const;
+    const VkPhysicalDeviceMemoryProperties& memory_properties() const { return m_memory_properties; }
+
+    MemoryStatistics statistics() const;
+    void print_statistics(ostream& out) const;
+
+private:
+    struct MemoryBlock
+    {
+        MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void* mapped, bool dedicated)
+            : m_memory(memory)
+            , m_size(size)
+            , m_mapped(mapped)
+            , m_dedicated(dedicated)
+            , m_allocator(size)
+        {
+        }
+
+        VkDeviceMemory m_memory;
+        VkDeviceSize m_size;
+        void* m_mapped;
+        bool m_dedicated;         // whole block is bound to one resource at offset 0, m_allocator is not used
+        TlsfAllocator m_allocator;
+    };
+
+    MemoryBlock* create_block(uint32_t memory_type, VkDeviceSize size, bool dedicated = false);
+    void release_block(MemoryBlock* block, uint32_t memory_type);
+    bool allocate_from_block(MemoryBlock& block, uint32_t memory_type, VkDeviceSize size,
+                             VkDeviceSize alignment, MemoryAllocation& allocation);
+    VkDeviceSize preferred_block_size(uint32_t memory_type) const;
+    // false if memory is coherent, nothing to flush or invalidate
+    bool non_coherent_range(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size,
+                            VkMappedMemoryRange& range) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memory_properties = {};
+    VkDeviceSize m_buffer_image_granularity = 1;
+    VkDeviceSize m_non_coherent_atom_size = 1;
+    VkDeviceSize m_block_size = DEFAULT_BLOCK_SIZE;
+
+    vector<unique_ptr<MemoryBlock>> m_blocks[VK_MAX_MEMORY_TYPES];
+    mutable mutex m_mutex;
+};
+
+/**
+  * Bump allocator for data, which lives one frame: one persistently mapped buffer with
+  * one region per frame in flight, reset as a whole when frame starts (its previous use
+  * is retired by frame fence). Nothing is freed individually, so allocation costs an atomic add.
+  **/
+class LinearArena
+{
+public:
+    struct Allocation
+    {
+        VkDeviceSize m_offset = 0; // in buffer()
+        void* m_mapped = nullptr;
+    };
+
+    // every allocation and region start is aligned to alignment (relative to the buffer)
+    void create(DeviceMemoryAllocator& allocator, VkDeviceSize frame_capacity, uint32_t frames_count,
+                VkBufferUsageFlags usage, VkDeviceSize alignment);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // forget all allocations of the frame, should be called after its fence is signaled
+    void begin_frame(uint32_t frame_index);
+    // forget allocations of the current frame, GPU should be done with them
+    void rewind();
+
+    // thread safe, false if frame region is exhausted
+    bool allocate(VkDeviceSize size, Allocation& allocation);
+
+    // makes CPU writes of the current frame from begin up to frame_used() visible, if memory is not coherent
+    void flush(const DeviceMemoryAllocator& allocator, VkDeviceSize begin = 0) const;
+
+    const GpuBuffer& buffer() const { return m_buffer; }
+    uint32_t current_frame() const { return m_current_frame; }
+    VkDeviceSize frame_offset(uint32_t frame_index) const { return m_frame_capacity * frame_index; }
+    VkDeviceSize frame_capacity() const { return m_frame_capacity; }
+    VkDeviceSize frame_used() const { return min<VkDeviceSize>(m_head, m_frame_capacity); }
+    VkDeviceSize peak_used() const { return max(m_peak, frame_used()); }
+    uint32_t frames_count() const { return m_frames_count; }
+
+private:
+    GpuBuffer m_buffer;
+    VkDeviceSize m_frame_capacity = 0;
+    VkDeviceSize m_alignment = 1;
+    uint32_t m_frames_count = 0;
+    uint32_t m_current_frame = 0;
+    atomic<VkDeviceSize> m_head{0};
+    VkDeviceSize m_peak = 0;
+};
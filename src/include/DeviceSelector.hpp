@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// everything device selection looks at, queried once per physical device
+struct PhysicalDeviceInfo
+{
+    VkPhysicalDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_index = 0; // in vkEnumeratePhysicalDevices order
+    VkPhysicalDeviceProperties m_properties;
+    VkPhysicalDeviceFeatures m_features;
+    VkPhysicalDeviceMemoryProperties m_memory;
+    vector<VkQueueFamilyProperties> m_queue_families;
+    set<string> m_extensions;
+    VkDeviceSize m_device_local_bytes = 0; // sum of device local heaps
+
+    static PhysicalDeviceInfo query(VkPhysicalDevice device, uint32_t index);
+
+    // pipelineCacheUUID: identifies device and driver, available without Vulkan 1.1
+    string uuid() const;
+    bool has_dedicated_transfer_family() const;
+    bool has_async_compute_family() const;
+
+    void print_capabilities(ostream& out) const;
+};
+
+/**
+  * Ranks suitable devices by score: device type first, then device local memory,
+  * limits, queue family layout and optional extensions. Override (device name
+  * substring, UUID or index) picks a device regardless of its score.
+  **/
+class DeviceSelector
+{
+public:
+    static constexpr const char* OVERRIDE_ENVIRONMENT_VARIABLE = "VULKAN_DEVICE";
+
+    static int64_t score(const PhysicalDeviceInfo& info);
+
+    // throws if there are no candidates or override does not match any of them
+    static const PhysicalDeviceInfo& select(const vector<PhysicalDeviceInfo>& candidates, const string& device_override);
+
+    // command line value if set, environment variable otherwise
+    static string device_override(const string& command_line_value);
+
+    static void print_ranking(ostream& out, const vector<PhysicalDeviceInfo>& candidates, const PhysicalDeviceInfo& chosen);
+
+private:
+    static bool matches(const PhysicalDeviceInfo& info, const string& device_override);
+};
+
+const char* physical_device_type_name(VkPhysicalDeviceType type);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/**
+  * SPIR-V of src/shaders, compiled by glslangValidator during build and linked
+  * into binary by cmake/EmbedSpirv.cmake. Name is shader file name with '.'
+  * replaced by '_', e.g. Triangle.vert -> Triangle_vert.
+  **/
+struct EmbeddedShader
+{
+    const char* m_name;
+    const uint32_t* m_code;
+    size_t m_size; // in bytes
+};
+
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+extern const size_t EMBEDDED_SHADERS_COUNT;
+
+// nullptr if there is no such shader
+const EmbeddedShader* find_embedded_shader(const string& name);
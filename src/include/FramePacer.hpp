@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+#include "ApplicationSettings.hpp"
+#include "FrameStatistics.hpp"
+
+using namespace std;
+
+/**
+  * Applies pacing policy: chooses present mode and swapchain length, throttles
+  * frame start to the target frame time and collects latency statistics.
+  *
+  * Frame start is delayed (not the submission of already recorded frame), so
+  * input is sampled as late as possible and does not age in the queue.
+  **/
+class FramePacer
+{
+public:
+    void create(PacingPolicy policy, double target_frame_time_ms);
+
+    static VkPresentModeKHR choose_present_mode(PacingPolicy policy, const vector<VkPresentModeKHR>& available_modes);
+    static uint32_t choose_images_count(PacingPolicy policy, VkPresentModeKHR present_mode,
+                                        const VkSurfaceCapabilitiesKHR& capabilities);
+
+    // sleeps until the next frame slot, should be called before input is sampled
+    void begin_frame();
+    void input_sampled();
+    // called after frame is presented (submitted in headless mode)
+    void end_frame();
+    void add_gpu_frame_time(double frame_time_ms);
+
+    void reset();
+    void print_report(ostream& out) const;
+
+private:
+    using clock = chrono::steady_clock;
+
+    PacingPolicy m_policy = PacingPolicy::LowestLatency;
+    clock::duration m_target_frame_time = clock::duration::zero();
+    clock::time_point m_next_frame_start;
+    clock::time_point m_frame_start;
+    clock::time_point m_input_time;
+
+    FrameStatistics m_cpu_frame_times;
+    FrameStatistics m_gpu_frame_times;
+    FrameStatistics m_input_to_present;
+    FrameStatistics m_throttle_waits;
+};
+
+const char* pacing_policy_name(PacingPolicy policy);
+const char* present_mode_name(VkPresentModeKHR present_mode);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Frame count and average cover all frames, percentiles are taken from the last
+  * MAX_SAMPLES frames, so memory does not grow with run time.
+  **/
+class FrameStatistics
+{
+public:
+    static constexpr size_t MAX_SAMPLES = 64 * 1024;
+
+    void add_frame(double frame_time_ms);
+    void reset();
+
+    uint64_t frames_count() const { return m_frames_count; }
+    double average_ms() const;
+    double percentile_ms(double percentile) const;
+
+    void print_report(ostream& out, const string& title) const;
+
+private:
+    // index of the percentile in sorted samples
+    static size_t rank_index(size_t samples_count, double percentile);
+
+    // ring of the last samples, m_next_sample is the oldest one when the ring is full
+    vector<double> m_frame_times_ms;
+    size_t m_next_sample = 0;
+    uint64_t m_frames_count = 0;
+    double m_total_ms = 0.0;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+  * GPU time of command buffer regions, measured with vkCmdWriteTimestamp pairs.
+  * Every frame in flight has its own query pool, which is read back after the
+  * frame fence is signaled, so results never stall the CPU.
+  *
+  * If queue does not support timestamps (timestampValidBits == 0), profiler is
+  * disabled and all calls do nothing.
+  **/
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+    static constexpr uint32_t DEFAULT_MAX_SCOPES = 64; // per frame
+    static constexpr size_t ROLLING_WINDOW = 256;      // samples kept for min/avg/p99
+
+    void create(VkPhysicalDevice gpu, VkDevice device, uint32_t queue_family,
+                uint32_t frames_count, uint32_t max_scopes = DEFAULT_MAX_SCOPES);
+    void destroy();
+
+    bool is_enabled() const { return !m_frames.empty(); }
+
+    /**
+      * Reads results of the previous use of the frame slot, should be called after its
+      * fence is signaled. Returns false if there was nothing to read.
+      **/
+    bool begin_frame(uint32_t frame_index, uint64_t frame_number);
+    // from the first to the last timestamp of the frame read by begin_frame
+    double last_frame_time_ms() const { return m_last_frame_time_ms; }
+
+    // resets queries of the frame, should be recorded before any scope and outside of render pass
+    void reset_queries(VkCommandBuffer command_buffer);
+
+    // thread safe, scopes may be recorded into secondary command buffers of the frame
+    uint32_t begin_scope(VkCommandBuffer command_buffer, const string& name,
+                         VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    void end_scope(VkCommandBuffer command_buffer, uint32_t scope,
+                   VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    void print_report(ostream& out, const string& title = "GPU scopes") const;
+    // Chrome trace format (chrome://tracing, Perfetto), one complete event per scope
+    void write_chrome_trace(const string& path) const;
+
+    class Scope
+    {
+    public:
+        Scope(GpuProfiler& profiler, VkCommandBuffer command_buffer, const string& name)
+            : m_profiler(profiler)
+            , m_command_buffer(command_buffer)
+            , m_scope(profiler.begin_scope(command_buffer, name))
+        {
+        }
+        ~Scope() { m_profiler.end_scope(m_command_buffer, m_scope); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler& m_profiler;
+        VkCommandBuffer m_command_buffer;
+        uint32_t m_scope;
+    };
+
+private:
+    struct FrameQueries
+    {
+        VkQueryPool m_pool = VK_NULL_HANDLE;
+        vector<string> m_scope_names; // scope i uses queries 2 * i and 2 * i + 1
+        uint64_t m_frame_number = 0;
+    };
+
+    struct RollingStatistics
+    {
+        vector<double> m_samples;
+        size_t m_next = 0;
+        uint64_t m_total_count = 0;
+
+        void add(double sample);
+    };
+
+    struct TraceEvent
+    {
+        string m_name;
+        uint64_t m_frame_number;
+        double m_start_us;
+        double m_duration_us;
+    };
+
+    static constexpr size_t MAX_TRACE_EVENTS = 1000000;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    double m_timestamp_period_ns = 1.0;
+    uint64_t m_timestamp_mask = 0;
+    uint32_t m_max_scopes = 0;
+
+    vector<FrameQueries> m_frames;
+    uint32_t m_recording_frame = 0;
+    mutex m_mutex;
+
+    double m_last_frame_time_ms = 0.0;
+    bool m_has_time_origin = false;
+    uint64_t m_time_origin = 0;
+    uint64_t m_overflows_count = 0;
+
+    map<string, RollingStatistics> m_statistics;
+    vector<TraceEvent> m_trace;
+};
@@ -2,9 +2,40 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "ApplicationSettings.hpp"
+#include "ComputeScheduler.hpp"
+#include "DeletionQueue.hpp"
+#include "DescriptorAllocator.hpp"
+#include "DeviceSelector.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "FramePacer.hpp"
+#include "FrameStatistics.hpp"
+#include "GpuProfiler.hpp"
+#include "IndirectDrawList.hpp"
+#include "InstanceArrays.hpp"
+#include "ParticleSystem.hpp"
+#include "PipelineCache.hpp"
+#include "PipelineRegistry.hpp"
+#include "ReductionKernel.hpp"
+#include "RenderGraph.hpp"
+#include "ScopedTimer.hpp"
+#include "ShaderWatcher.hpp"
+#include "StagingRing.hpp"
+#include "TaskGraph.hpp"
+#include "UniformRing.hpp"
+#include "UploadService.hpp"
+#include "ThreadPool.hpp"
+#include "Vertex.hpp"
+
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
 
@@ -30,7 +61,7 @@ const vector<const char*> DEVICE_EXTENCIONS = {
 class HelloTriangleApplication
 {
 public:
-    HelloTriangleApplication();
+    explicit HelloTriangleApplication(const ApplicationSettings& settings);
 	~HelloTriangleApplication() = default;
 
 	void run();
@@ -40,6 +71,8 @@ private:
     {
         optional<uint32_t> m_graphics_family;
         optional<uint32_t> m_present_family;
+        optional<uint32_t> m_transfer_family; // transfer only family, if device has one
+        optional<uint32_t> m_compute_family;  // compute without graphics (async compute), if device has one
 
         bool is_index_complete()
         {
@@ -54,6 +87,45 @@ private:
         vector<VkPresentModeKHR> m_present_modes;
     };
 
+    /**
+      * Everything CPU needs to record one frame while GPU may still work on
+      * the previous ones. Indexed by m_current_frame.
+      **/
+    struct FrameResources
+    {
+        VkCommandPool m_command_pool = VK_NULL_HANDLE;
+        VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+        VkSemaphore m_image_available = VK_NULL_HANDLE;
+        VkFence m_in_flight_fence = VK_NULL_HANDLE;
+
+        // one pool per recording thread, pools are not thread safe
+        vector<VkCommandPool> m_worker_pools;
+        vector<VkCommandBuffer> m_secondary_buffers;
+    };
+
+    struct DrawItem
+    {
+        uint32_t m_first_index;
+        uint32_t m_index_count;
+        uint32_t m_first_instance;
+        uint32_t m_instances_count;
+    };
+
+    // layout should match FrameUniforms of Triangle.vert and Instanced.vert (std140)
+    struct FrameUniforms
+    {
+        float m_time;
+        float m_amplitude;
+        float m_padding[2];
+    };
+
+    // push constants of scene draws, layout should match DrawConstants of the vertex shaders
+    struct DrawConstants
+    {
+        float m_phase;
+    };
+
+    void init_window_system();
     void init_window();
     void init_vulkan();
     void init_setup_callback();
@@ -64,12 +136,56 @@ private:
     void create_KHR_surface();
     void pick_graphic_card();
     void create_logical_device();
-    void create_swap_chain();
+    void create_swap_chain(VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
+    bool recreate_swapchain();
+    void create_swapchain_semaphores();
+    void create_offscreen_targets();
     void create_image_views();
     void create_graphics_pipeline();
-    void create_render_pass();
-    void create_framebuffers();
+    // scene pipeline layout and subpass of the given render graph pass, default fixed function state
+    PipelineDescription pipeline_description(const string& vertex_shader, const string& fragment_shader,
+                                             const string& pass = "scene") const;
+    PipelineDescription scene_pipeline_description(bool instanced) const;
+    const PipelineRegistry::Slot* create_pipeline(const PipelineDescription& description);
+    VkPipeline create_compute_pipeline(const string& shader, VkPipelineLayout layout);
+    // on async compute queue if requested and device has one, otherwise on graphics queue
+    void create_compute_scheduler(bool async);
+    void create_render_graph();
+    void create_render_targets();
+    void create_frame_resources();
+    void create_geometry_buffers();
+    // on transfer queue if there is one, otherwise through the staging ring
+    void upload_static_data(VkBuffer destination, VkDeviceSize offset, const void* data, VkDeviceSize size);
+    void update_streamed_geometry();
+    // grid of instances covers extent times the viewport
+    void create_instance_buffer(uint32_t instances_count, float extent = 1.0f);
+    void create_particle_system();
+    bool is_instancing_enabled() const;
+    void build_draw_list(uint32_t draws_count);
+    bool is_gpu_driven_enabled() const;
+    void create_indirect_draw_list();
+    void update_indirect_objects(); // bounds of every draw list item, GPU should be idle
     void execute_main_loop();
+    bool render_frames(uint64_t frames_count, FrameStatistics& statistics);
+    void run_instancing_benchmark();
+    void run_recording_benchmark();
+    void run_compute_benchmark();
+    void run_indirect_benchmark();
+    void run_pipeline_benchmark();
+    void draw_frame();
+    void update_hot_reload(); // between frames
+    void submit_compute_work();
+    void present_image(uint32_t image_index);
+    void record_command_buffer(FrameResources& frame, uint32_t image_index);
+    void record_scene(VkCommandBuffer command_buffer, uint32_t image_index);
+    void record_post_process(VkCommandBuffer command_buffer);
+    void record_secondary_buffer(FrameResources& frame, uint32_t worker, uint32_t image_index);
+    void record_draws(VkCommandBuffer command_buffer, size_t begin, size_t end);
+    // animation phase of the draw, same for direct and indirect draws
+    void push_draw_constants(VkCommandBuffer command_buffer, size_t draw);
+    void bind_scene(VkCommandBuffer command_buffer);
+    void record_particles(VkCommandBuffer command_buffer);
+    void set_viewport_and_scissor(VkCommandBuffer command_buffer);
     void cleanup();
 
     bool check_validation_layers_support();
@@ -81,14 +197,21 @@ private:
     VkSurfaceFormatKHR choose_swap_surface_format(const vector<VkSurfaceFormatKHR>& available_formats);
     VkPresentModeKHR   choose_swapchain_present_mode(const vector<VkPresentModeKHR>& available_presend_modes);
     VkExtent2D         choose_swapchain_extent(const VkSurfaceCapabilitiesKHR& capabilities);
-    VkShaderModule     create_shader_module(const string &shader);
+    void               load_shader_modules();
+    VkShaderModule     shader_module(const string& name); // created on first use, kept until destroy_shader_modules(), thread safe
+    void               destroy_shader_modules();
+    VkShaderModule     create_shader_module(const string &name);
+    VkShaderModule     create_shader_module(const uint32_t* code, size_t size);
 
     vector<const char*> get_required_extensions();
+    vector<const char*> get_required_device_extensions();
     VkResult create_debug_utils_messenger_EXT(VkInstance instance,
                                               const VkDebugUtilsMessengerCreateInfoEXT* debug_info,
                                               const VkAllocationCallbacks* allocator,
                                               VkDebugUtilsMessengerEXT* callback_object);
 
+    static void framebuffer_resize_callback(GLFWwindow* window, int width, int height);
+
     static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -98,14 +221,24 @@ private:
  //------------------test
     bool compare_extensions(const char ** glfw_extensions, uint32_t glfw_extensions_count);
 //-----------------------
+    ApplicationSettings m_settings;
+    TimingLog m_startup_timings; // stopped after startup report, runtime scopes are not recorded
+
     VkInstance  m_instance;
     GLFWwindow* m_window;
 
     VkDebugUtilsMessengerEXT m_callback;
     VkPhysicalDevice m_gpu;
     VkDevice m_device;
+    QueueFamilyIndex m_queue_families;
     VkQueue m_graphical_queue;
     VkQueue m_present_queue;
+    VkQueue m_transfer_queue;
+    VkQueue m_compute_queue;
+    DeviceMemoryAllocator m_memory_allocator;
+    DescriptorAllocator m_descriptors;
+    UniformRing m_uniform_ring;
+    uint32_t m_frame_uniforms_offset; // dynamic offset of FrameUniforms of the frame being recorded
 
     VkSurfaceKHR m_surface;
     VkSwapchainKHR m_swapchain;
@@ -114,13 +247,75 @@ private:
     VkExtent2D m_sch_extent;
 
     vector<VkImageView> m_sch_image_views;
+    bool m_swapchain_dirty; // window is resized or swapchain is out of date, recreated before the next frame
+    uint32_t m_swapchain_recreations;
+    vector<MemoryAllocation> m_offscreen_memory; // headless mode owns its render targets
 
-    VkRenderPass m_render_pass;
+    PipelineCache m_pipeline_cache;
+    mutex m_shader_modules_mutex;
+    unordered_map<string, VkShaderModule> m_shader_modules; // only during pipelines creation
+    unordered_set<string> m_hot_shaders; // modules recompiled by hot reload, loaded from m_hot_shader_directory
+    string m_hot_shader_directory;
+    unique_ptr<ShaderWatcher> m_shader_watcher; // nullptr - no hot reload
+    PipelineRegistry m_pipelines; // owns graphics pipelines
+    /**
+      * Pipeline benchmark streams materials (scene pipeline variants) through this registry.
+      * nullptr - scene is drawn with its own pipeline.
+      **/
+    PipelineRegistry* m_material_pipelines;
+    PipelineDescription m_material;
+    bool m_async_materials; // compile new materials on registry workers and draw with scene pipeline meanwhile
+    RenderGraph m_render_graph;
     VkPipelineLayout m_pipeline_layout;
-    VkPipeline m_pipeline;
+    // slots of the registry, hot reload replaces their pipelines between frames
+    const PipelineRegistry::Slot* m_pipeline;
+    const PipelineRegistry::Slot* m_instanced_pipeline;
+    const PipelineRegistry::Slot* m_particle_pipeline;
+    VkDescriptorSetLayout m_post_set_layout; // owned by m_descriptors
+    VkPipelineLayout m_post_pipeline_layout;
+    const PipelineRegistry::Slot* m_post_pipeline;
+
+    StagingRing m_staging_ring;
+    unique_ptr<UploadService> m_upload_service; // nullptr if there is no dedicated transfer queue
+    GpuBuffer m_vertex_buffer;
+    GpuBuffer m_index_buffer;
+    uint32_t m_index_count;
+    vector<Vertex> m_streamed_vertices;
+    GpuBuffer m_instance_buffer;
+    array<VkDeviceSize, InstanceArrays::BINDINGS_COUNT> m_instance_stream_offsets;
+    uint32_t m_instances_count;
+    vector<DrawItem> m_draw_list;
+    float m_mesh_radius; // bounding circle of the mesh around its origin
+    InstanceArrays m_instance_arrays; // CPU copy for draw list bounds, only if GPU driven drawing is enabled
+    unique_ptr<IndirectDrawList> m_indirect_draws;
+    bool m_gpu_driven; // draw list is culled and drawn from GPU buffer
+    bool m_multi_draw_indirect;
+    bool m_draw_indirect_first_instance; // without it GPU driven instanced draws are recorded directly
+    uint32_t m_max_draw_indirect_count;
+
+    ComputeScheduler m_compute_scheduler;
+    ReductionKernel* m_reduction_kernel; // compute work of every frame, only during compute benchmark
+    bool m_reduction_fill_pending; // values are generated by the first compute submission
+    unique_ptr<ParticleSystem> m_particles; // nullptr if there are no particles
+    chrono::steady_clock::time_point m_last_simulation;
+
+    unique_ptr<ThreadPool> m_thread_pool;
+    uint32_t m_max_recording_threads; // command pools are created for this many threads
+    uint32_t m_recording_threads;
+    FrameStatistics m_recording_statistics;
 
-    vector<VkFramebuffer> m_sch_framebuffers;
+    vector<FrameResources> m_frames;
+    vector<VkSemaphore> m_render_finished; // one per swapchain image
+    vector<VkFence> m_images_in_flight;    // fence of the frame, which currently uses swapchain image
+    vector<VkSemaphore> m_wait_semaphores; // waited by the frame submission: image acquire, transfer uploads
+    vector<VkPipelineStageFlags> m_wait_stages;
+    uint32_t m_current_frame;
+    uint64_t m_frame_counter;
+    DeletionQueue m_deletion_queue; // objects, which may be still used by frames in flight
+    FrameStatistics m_frame_statistics;
+    FramePacer m_frame_pacer;
+    GpuProfiler m_gpu_profiler;
 };
 
-int call_HelloTriangleApplication();
+int call_HelloTriangleApplication(const ApplicationSettings& settings);
 
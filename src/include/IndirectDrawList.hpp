@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+
+#include "DescriptorAllocator.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Draw list, which lives in GPU memory. Compute pass (shaders/Cull.comp) tests bounds
+  * of every object against the view rectangle and writes one VkDrawIndexedIndirectCommand
+  * per object, culled objects get zero instances. Frame draws the whole list with one
+  * vkCmdDrawIndexedIndirect if multiDrawIndirect is supported, one call per object otherwise.
+  * Commands keep first instance of the object, so drawIndirectFirstInstance should be enabled
+  * if it is not zero.
+  * Buffers change with objects count, so descriptor set of culling is allocated per frame.
+  **/
+class IndirectDrawList
+{
+public:
+    // layout should match Object of Cull.comp (std430)
+    struct Object
+    {
+        uint32_t m_index_count;
+        uint32_t m_first_index;
+        uint32_t m_first_instance;
+        uint32_t m_instances_count;
+        float m_center[2];
+        float m_radius;
+        float m_padding;
+    };
+
+    void create(VkDevice device, DescriptorAllocator& descriptors);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    VkPipelineLayout pipeline_layout() const { return m_pipeline_layout; }
+    // pipeline is created by the owner of shaders and pipeline cache, draw list destroys it
+    void set_pipeline(VkPipeline pipeline) { m_pipeline = pipeline; }
+
+    /**
+      * Recreates buffers for given objects count, previous buffers should not be used by GPU.
+      * Returns buffer, which objects should be uploaded to before the next culling.
+      **/
+    VkBuffer resize(DeviceMemoryAllocator& allocator, uint32_t objects_count);
+
+    // outside of render pass, commands are visible for indirect draws of the same queue after it
+    void record_culling(VkCommandBuffer command_buffer, DescriptorAllocator& descriptors,
+                        const float view_min[2], const float view_max[2]) const;
+    /**
+      * Inside render pass with pipeline, vertex and index buffers bound. If per_object is given, it records
+      * state of the object (e.g. push constants) before its draw, so objects are drawn one call each.
+      **/
+    void record_draws(VkCommandBuffer command_buffer, bool multi_draw, uint32_t max_draw_count,
+                      const function<void(uint32_t object)>& per_object = nullptr) const;
+
+    uint32_t objects_count() const { return m_objects_count; }
+
+private:
+    struct CullingParameters
+    {
+        float m_view_min[2];
+        float m_view_max[2];
+        uint32_t m_count;
+    };
+
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_objects_count = 0;
+    GpuBuffer m_objects;
+    GpuBuffer m_commands;
+
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE; // owned by descriptor allocator
+    VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
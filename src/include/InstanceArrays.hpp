@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec2.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Per-instance data as structure of arrays. Every attribute is a separate tightly
+  * packed stream with its own VK_VERTEX_INPUT_RATE_INSTANCE binding, so one attribute
+  * can be updated without touching the others. All streams share one buffer:
+  * offsets | scales | colors. Layout should match instance inputs of Instanced.vert.
+  **/
+struct InstanceArrays
+{
+    static constexpr uint32_t FIRST_BINDING = 1; // binding 0 is per vertex data
+    static constexpr uint32_t BINDINGS_COUNT = 3;
+
+    vector<glm::vec2> m_offsets;
+    vector<float> m_scales;
+    vector<uint32_t> m_colors; // RGBA8
+
+    size_t size() const { return m_offsets.size(); }
+
+    void resize(size_t count)
+    {
+        m_offsets.resize(count);
+        m_scales.resize(count);
+        m_colors.resize(count);
+    }
+
+    // start of every stream in the shared buffer
+    array<VkDeviceSize, BINDINGS_COUNT> stream_offsets() const
+    {
+        VkDeviceSize offsets_bytes = sizeof(glm::vec2) * m_offsets.size();
+        VkDeviceSize scales_bytes = sizeof(float) * m_scales.size();
+        return {0, offsets_bytes, offsets_bytes + scales_bytes};
+    }
+
+    VkDeviceSize total_bytes() const
+    {
+        return (sizeof(glm::vec2) + sizeof(float) + sizeof(uint32_t)) * size();
+    }
+
+    static array<VkVertexInputBindingDescription, BINDINGS_COUNT> binding_descriptions()
+    {
+        array<VkVertexInputBindingDescription, BINDINGS_COUNT> descriptions = {};
+        const uint32_t strides[BINDINGS_COUNT] = {sizeof(glm::vec2), sizeof(float), sizeof(uint32_t)};
+
+        for (uint32_t i = 0; i < BINDINGS_COUNT; ++i)
+        {
+            descriptions[i].binding = FIRST_BINDING + i;
+            descriptions[i].stride = strides[i];
+            descriptions[i].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        }
+        return descriptions;
+    }
+
+    static array<VkVertexInputAttributeDescription, BINDINGS_COUNT> attribute_descriptions()
+    {
+        array<VkVertexInputAttributeDescription, BINDINGS_COUNT> descriptions = {};
+        const VkFormat formats[BINDINGS_COUNT] = {VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM};
+
+        // locations 0 and 1 are taken by Vertex
+        for (uint32_t i = 0; i < BINDINGS_COUNT; ++i)
+        {
+            descriptions[i].binding = FIRST_BINDING + i;
+            descriptions[i].location = 2 + i;
+            descriptions[i].format = formats[i];
+            descriptions[i].offset = 0;
+        }
+        return descriptions;
+    }
+};
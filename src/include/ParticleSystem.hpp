@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "DescriptorAllocator.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Particles, which never leave GPU memory: shaders/Particles.comp integrates them
+  * every frame and the same buffer is drawn as a point list (shaders/Particle.vert).
+  * Initial state is generated by the first simulation step.
+  *
+  * Every step reads the previous state buffer and writes the next one. There are
+  * as many state buffers as frames in flight (at least 2), so a step overwrites the
+  * buffer drawn by the frame, whose fence CPU waited for before submitting the step:
+  * compute writes never race with graphics reads, and graphics waits for the step
+  * only through the semaphore of its own frame.
+  **/
+class ParticleSystem
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+    struct Particle
+    {
+        float m_position[2];
+        float m_velocity[2];
+    };
+
+    // queue_families - compute and graphics family, buffers are shared if they differ.
+    // Throws if a state buffer does not fit into one storage buffer binding of the device
+    void create(VkDevice device, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                uint32_t particles_count, uint32_t frames_count, const vector<uint32_t>& queue_families,
+                const VkPhysicalDeviceLimits& limits);
+    void destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator);
+
+    VkPipelineLayout simulation_layout() const { return m_pipeline_layout; }
+    // pipeline is created by the owner of shaders and pipeline cache, particle system destroys it
+    void set_simulation_pipeline(VkPipeline pipeline) { m_simulation_pipeline = pipeline; }
+
+    static VkVertexInputBindingDescription binding_description();
+    static array<VkVertexInputAttributeDescription, 2> attribute_descriptions();
+
+    // simulation step on compute queue, the next draw uses its result
+    void record_simulation(VkCommandBuffer command_buffer, float delta_time);
+    // inside render pass with particle pipeline bound
+    void record_draw(VkCommandBuffer command_buffer) const;
+
+    uint32_t particles_count() const { return m_particles_count; }
+
+private:
+    struct SimulationParameters
+    {
+        float m_delta_time;
+        uint32_t m_count;
+        uint32_t m_initialize;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_particles_count = 0;
+    vector<GpuBuffer> m_states;
+    uint32_t m_current = 0; // state written by the last simulation step
+    bool m_initialized = false;
+
+    vector<VkDescriptorSet> m_descriptor_sets; // set i reads state i - 1 and writes state i
+    VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline m_simulation_pipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+  * VkPipelineCache, which survives application restarts. Blob is loaded from disk
+  * on creation, if it was produced by the same driver for the same device, and is
+  * written back on save(). Feed handle() to every vkCreate*Pipelines call.
+  **/
+class PipelineCache
+{
+public:
+    void create(VkPhysicalDevice gpu, VkDevice device, const string& file_path);
+    void save() const;
+    void destroy();
+
+    VkPipelineCache handle() const { return m_cache; }
+    // true if cache data from previous run was accepted
+    bool is_warm() const { return m_is_warm; }
+
+private:
+    vector<char> load_file() const;
+    bool is_compatible(const vector<char>& data, const VkPhysicalDeviceProperties& properties) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    string m_file_path;
+    bool m_is_warm = false;
+};
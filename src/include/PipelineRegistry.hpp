@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+/**
+  * Everything graphics pipeline depends on. Viewport and scissor are dynamic state,
+  * so they are not part of it. Render pass may be any compatible one.
+  **/
+struct PipelineDescription
+{
+    string m_vertex_shader;   // shader module names, as in EmbeddedShaders
+    string m_fragment_shader;
+    vector<VkVertexInputBindingDescription> m_bindings;
+    vector<VkVertexInputAttributeDescription> m_attributes;
+    VkPrimitiveTopology m_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode m_polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags m_cull_mode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace m_front_face = VK_FRONT_FACE_CLOCKWISE;
+    bool m_alpha_blending = false;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    VkRenderPass m_render_pass = VK_NULL_HANDLE;
+    uint32_t m_subpass = 0;
+
+    bool operator==(const PipelineDescription& other) const;
+};
+
+struct PipelineDescriptionHash
+{
+    size_t operator()(const PipelineDescription& description) const;
+};
+
+/**
+  * Graphics pipelines by description. The first request creates the pipeline, the next
+  * ones are one hash lookup, so pipelines may be requested while recording.
+  *
+  * Pipelines with the same shaders, layout and subpass form a family: the first one is
+  * created with ALLOW_DERIVATIVES and the other variants (topology, rasterization,
+  * blending) derive from it, which lets driver reuse compiled shaders.
+  *
+  * request() does not wait: missing pipeline is compiled by background workers and
+  * the caller draws with its fallback until the pipeline is swapped into the slot.
+  *
+  * rebuild() compiles pipelines of changed shaders again in background, the render
+  * thread puts them into their slots between frames with swap_rebuilt().
+  **/
+class PipelineRegistry
+{
+public:
+    using ShaderProvider = function<VkShaderModule(const string& name)>;
+
+    static constexpr uint32_t COMPILE_THREADS = 2;
+
+    // pipeline of one description, stays valid until the registry is destroyed
+    class Slot
+    {
+    public:
+        VkPipeline pipeline(VkPipeline fallback = VK_NULL_HANDLE) const
+        {
+            VkPipeline ready = m_pipeline.load(memory_order_acquire);
+            return ready != VK_NULL_HANDLE ? ready : fallback;
+        }
+        bool is_ready() const { return m_pipeline.load(memory_order_acquire) != VK_NULL_HANDLE; }
+
+    private:
+        friend class PipelineRegistry;
+
+        atomic<VkPipeline> m_pipeline{VK_NULL_HANDLE}; // stored by the compiling thread, replaced by swap_rebuilt()
+        bool m_failed = false;                         // guarded by registry mutex
+        uint32_t m_generation = 0;                     // rebuilds requested, guarded by registry mutex
+    };
+
+    struct Statistics
+    {
+        uint64_t m_lookups = 0;
+        uint32_t m_created = 0;
+        uint32_t m_derivatives = 0;
+        double m_creation_ms = 0.0;
+
+        // background compilation
+        uint64_t m_fallbacks = 0;       // requests answered with fallback pipeline
+        uint32_t m_async_compiles = 0;
+        uint32_t m_queue_depth = 0;     // requested, not compiled yet
+        uint32_t m_max_queue_depth = 0;
+        double m_latency_ms = 0.0;      // sum of request to ready times
+        double m_max_latency_ms = 0.0;
+
+        uint32_t m_rebuilt = 0;         // pipelines replaced after shader changes
+    };
+
+    // cache may be VK_NULL_HANDLE. Shader provider is called only when pipeline is created, maybe by workers
+    void create(VkDevice device, VkPipelineCache cache, ShaderProvider shaders, bool derivatives = true);
+    // waits for background compilation
+    void destroy();
+
+    // thread safe, pipeline is owned by the registry. Waits if the pipeline is being compiled
+    VkPipeline get(const PipelineDescription& description);
+    // thread safe, never compiles on the calling thread
+    const Slot& request(const PipelineDescription& description);
+    // slot of a pipeline, which may be replaced by rebuild
+    const Slot& slot(const PipelineDescription& description);
+
+    // pipelines, which use any of the shader modules, are compiled again by workers
+    void rebuild(const vector<string>& shaders);
+    bool is_rebuilding() const;
+    /**
+      * Puts rebuilt pipelines into their slots, should be called between frames by
+      * the recording thread. Replaced pipelines are given to retire, frames in flight
+      * may still use them.
+      **/
+    uint32_t swap_rebuilt(const function<void(VkPipeline)>& retire);
+
+    Statistics statistics() const;
+    void print_statistics(ostream& out) const;
+
+private:
+    // key of the pipeline family, which derivatives share
+    struct FamilyKey
+    {
+        string m_vertex_shader;
+        string m_fragment_shader;
+        VkPipelineLayout m_layout;
+        VkRenderPass m_render_pass;
+        uint32_t m_subpass;
+
+        bool operator==(const FamilyKey& other) const;
+    };
+
+    struct FamilyKeyHash
+    {
+        size_t operator()(const FamilyKey& key) const;
+    };
+
+    static FamilyKey family_of(const PipelineDescription& description);
+    // creates pipeline of the slot and wakes up threads waiting for it, slot is failed if creation throws
+    void compile(const PipelineDescription& description, Slot& slot);
+    VkPipeline create_pipeline(const PipelineDescription& description, VkPipeline base);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    ShaderProvider m_shaders;
+    bool m_derivatives = true;
+
+    mutable mutex m_mutex;
+    condition_variable m_compiled;
+    unordered_map<PipelineDescription, unique_ptr<Slot>, PipelineDescriptionHash> m_slots;
+    unordered_map<FamilyKey, VkPipeline, FamilyKeyHash> m_family_bases;
+    Statistics m_statistics;
+    unique_ptr<ThreadPool> m_compiler; // created by the first request() or rebuild()
+
+    struct Rebuilt
+    {
+        Slot* m_slot;
+        uint32_t m_generation;
+        VkPipeline m_pipeline;
+    };
+    vector<Rebuilt> m_rebuilt; // compiled, not swapped yet
+    uint32_t m_rebuilds_in_flight = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "DescriptorAllocator.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Compute benchmark kernel (shaders/Reduce.comp): sum of a big uint buffer. Values
+  * are generated on GPU with vkCmdFillBuffer, so the buffer is only touched by the
+  * queue, which runs the kernel, and result is known in advance.
+  **/
+class ReductionKernel
+{
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 256;
+    static constexpr uint32_t VALUE = 3;
+
+    // throws if values do not fit into one storage buffer binding of the device
+    void create(VkDevice device, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                uint32_t values_count, const VkPhysicalDeviceLimits& limits);
+    void destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator);
+
+    VkPipelineLayout pipeline_layout() const { return m_pipeline_layout; }
+    // pipeline is created by the owner of shaders and pipeline cache, kernel destroys it
+    void set_pipeline(VkPipeline pipeline) { m_pipeline = pipeline; }
+
+    // should be recorded before the first reduction on the queue
+    void record_fill(VkCommandBuffer command_buffer) const;
+    void record_reduce(VkCommandBuffer command_buffer) const;
+
+    // after the last recorded reduction is finished
+    uint32_t read_result(const DeviceMemoryAllocator& allocator) const;
+    uint32_t expected_result() const { return m_values_count * VALUE; } // wraps around as on GPU
+    VkDeviceSize bytes_per_reduction() const { return m_values.m_size; }
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_values_count = 0;
+    uint32_t m_workgroups = 0;
+    GpuBuffer m_values;
+    GpuBuffer m_result;
+
+    VkDescriptorSet m_descriptor_set = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Frame graph of raster passes. Passes declare attachments they write and read,
+  * compile() derives render passes from that:
+  *  - consecutive passes are merged into subpasses of one VkRenderPass, unless a pass
+  *    samples an attachment written in the same render pass;
+  *  - load/store ops, layouts and subpass dependencies come from the uses, so there
+  *    are no hand written barriers. Attachment contents, which nobody reads after the
+  *    render pass, are not stored;
+  *  - attachments, which live inside one render pass and are not sampled, are transient:
+  *    LAZILY_ALLOCATED memory if device has it (tile memory only on tilers). Other
+  *    attachments of the graph share memory if their lifetimes do not overlap.
+  *
+  * Imported attachments (swapchain images) are owned by the caller, one view per image index.
+  **/
+class RenderGraph
+{
+public:
+    using RecordFunction = function<void(VkCommandBuffer command_buffer, uint32_t image_index)>;
+
+    struct PassDescription
+    {
+        string m_name;
+        vector<string> m_color_outputs;
+        string m_depth_output;            // empty - no depth attachment
+        vector<string> m_input_attachments; // read at the same pixel (subpassLoad)
+        vector<string> m_sampled_inputs;  // read anywhere by fragment shader, writer has to finish first
+        RecordFunction m_record;
+    };
+
+    struct MemoryReport
+    {
+        VkDeviceSize m_separate_bytes = 0;  // every attachment with its own memory
+        VkDeviceSize m_lazy_bytes = 0;      // lazily allocated, committed only if tile memory overflows
+        VkDeviceSize m_aliasable_bytes = 0; // the other attachments, each with its own memory
+        VkDeviceSize m_aliased_bytes = 0;   // memory actually allocated for them with aliasing
+    };
+
+    void add_attachment(const string& name, VkFormat format, bool depth, VkClearValue clear);
+    void import_attachment(const string& name, VkFormat format, VkImageLayout final_layout, VkClearValue clear);
+    void add_pass(PassDescription pass);
+
+    // render passes depend on formats and uses only, so they survive target recreation
+    void compile(VkDevice device);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // images of graph attachments and framebuffers, imported_views - views of every imported attachment
+    void create_targets(DeviceMemoryAllocator& allocator, VkExtent2D extent,
+                        const unordered_map<string, vector<VkImageView>>& imported_views);
+    // targets may be used by frames in flight, returned function destroys them
+    function<void()> release_targets(DeviceMemoryAllocator& allocator);
+
+    VkRenderPass render_pass(const string& pass) const;
+    uint32_t subpass(const string& pass) const;
+    VkFramebuffer framebuffer(const string& pass, uint32_t image_index) const;
+    VkImageView attachment_view(const string& attachment) const;
+
+    // INLINE by default, recorder of the pass may switch to secondary command buffers every frame
+    void set_subpass_contents(const string& pass, VkSubpassContents contents);
+
+    // all render passes of the graph in order
+    void execute(VkCommandBuffer command_buffer, uint32_t image_index) const;
+
+    const MemoryReport& memory_report() const { return m_memory_report; }
+    void print_report(ostream& out) const;
+
+private:
+    struct Resource
+    {
+        string m_name;
+        VkFormat m_format;
+        bool m_depth;
+        bool m_imported;
+        VkImageLayout m_final_layout; // imported only
+        VkClearValue m_clear;
+
+        // derived by compile()
+        uint32_t m_first_group = UINT32_MAX;
+        uint32_t m_last_group = 0;
+        bool m_input = false;
+        bool m_sampled = false;
+        bool m_transient = false;
+    };
+
+    struct Pass
+    {
+        PassDescription m_description;
+        vector<uint32_t> m_color_outputs;
+        int32_t m_depth_output = -1;
+        vector<uint32_t> m_input_attachments;
+        vector<uint32_t> m_sampled_inputs;
+        VkSubpassContents m_contents = VK_SUBPASS_CONTENTS_INLINE;
+        uint32_t m_group = 0;
+        uint32_t m_subpass = 0;
+    };
+
+    struct Group
+    {
+        vector<uint32_t> m_passes;
+        vector<uint32_t> m_attachments; // resources in attachment order
+        vector<VkClearValue> m_clear_values;
+        VkRenderPass m_render_pass = VK_NULL_HANDLE;
+        uint32_t m_dependencies_count = 0;
+    };
+
+    struct Targets
+    {
+        vector<VkImage> m_images;
+        vector<VkImageView> m_views;
+        vector<MemoryAllocation> m_allocations;
+        vector<VkDeviceMemory> m_lazy_memory;
+        vector<vector<VkFramebuffer>> m_framebuffers; // per group, per image index
+    };
+
+    // how a pass uses a resource
+    struct Use
+    {
+        bool m_write = false;
+        bool m_input = false;
+        bool m_sampled = false;
+    };
+
+    uint32_t resource_index(const string& name) const;
+    uint32_t pass_index(const string& name) const;
+    Use use_of(const Pass& pass, uint32_t resource) const;
+    VkImageLayout attachment_layout(const Resource& resource, const Use& use) const;
+    void stages_of(const Resource& resource, const Use& use, VkPipelineStageFlags& stages, VkAccessFlags& access) const;
+    void create_render_pass(uint32_t group_index, vector<VkImageLayout>& layouts, vector<bool>& written);
+    uint32_t find_lazy_memory_type(uint32_t type_bits, const DeviceMemoryAllocator& allocator) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    vector<Resource> m_resources;
+    unordered_map<string, uint32_t> m_resource_indices;
+    vector<Pass> m_passes;
+    vector<Group> m_groups;
+    VkExtent2D m_extent = {0, 0};
+    Targets m_targets;
+    MemoryReport m_memory_report;
+};
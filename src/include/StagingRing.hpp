@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+struct StagingStatistics
+{
+    uint64_t m_uploaded_bytes = 0;
+    uint64_t m_copies_count = 0;
+    uint64_t m_batches_count = 0;  // vkCmdCopyBuffer calls
+    uint64_t m_stalls_count = 0;   // uploads, which had to wait for GPU to free ring space
+    double m_upload_ms = 0.0;      // CPU time spent in upload(), stalls included
+    double m_stall_ms = 0.0;
+
+    double throughput_mb_per_second() const;
+};
+
+/**
+  * Upload memory taken from LinearArena, capacity is split between frames in flight.
+  * upload() copies data into the region of the current frame and remembers the copy,
+  * flush() records all remembered copies into a command buffer, batched into one
+  * vkCmdCopyBuffer per destination buffer.
+  *
+  * Region is given back by begin_frame(), after fence of the frame slot. Only if the
+  * region is full, upload submits pending copies itself, waits for them and rewinds it.
+  **/
+class StagingRing
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+    void create(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue queue, uint32_t queue_family,
+                uint32_t frames_count, VkDeviceSize capacity = DEFAULT_CAPACITY);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // copy is executed by the next flush(), destination range should not be used by GPU before that
+    void upload(VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size);
+
+    /**
+      * Records pending copies and a barrier, which makes them visible for destination
+      * stages. Should be called outside of render pass. Copies wait for previous reads of
+      * destination stages, so buffers may be overwritten every frame.
+      **/
+    void flush(VkCommandBuffer command_buffer,
+               VkPipelineStageFlags destination_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+               VkAccessFlags destination_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+
+    // copies flushed since the last call are submitted to the queue
+    void end_frame();
+
+    // GPU is done with the previous use of the frame slot. Copies, which are still pending
+    // in the region of another frame, are submitted and waited for
+    void begin_frame(uint32_t frame_index);
+
+    bool has_pending_copies() const { return !m_pending.empty(); }
+    VkDeviceSize capacity() const { return m_arena.frame_capacity() * m_arena.frames_count(); }
+    const StagingStatistics& statistics() const { return m_statistics; }
+    void print_statistics(ostream& out) const;
+
+private:
+    struct PendingCopies
+    {
+        VkBuffer m_destination;
+        vector<VkBufferCopy> m_regions;
+    };
+
+    LinearArena::Allocation reserve(VkDeviceSize size);
+    void submit_pending_and_wait();
+    void record_copies(VkCommandBuffer command_buffer, VkPipelineStageFlags destination_stages,
+                       VkAccessFlags destination_access);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    const DeviceMemoryAllocator* m_allocator = nullptr;
+    LinearArena m_arena;
+
+    VkDeviceSize m_flushed = 0; // written data of the region below it is already recorded into command buffer
+    bool m_unsubmitted = false; // recorded copies wait for end_frame()
+
+    vector<PendingCopies> m_pending;
+    unordered_map<VkBuffer, size_t> m_pending_index;
+
+    // used only when copies do not fit into the region of the frame
+    VkCommandPool m_command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+    VkFence m_fence = VK_NULL_HANDLE;
+
+    StagingStatistics m_statistics;
+};
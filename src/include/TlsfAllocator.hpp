@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Two-level segregated fit allocator of offsets inside [0, capacity).
+  * Knows nothing about Vulkan, DeviceMemoryAllocator uses one per VkDeviceMemory block.
+  *
+  * Free ranges are kept in FL_COUNT x SL_COUNT size classes: first level is power of two,
+  * second level splits it linearly into SL_COUNT parts. Both levels have bitmaps,
+  * so allocation and free are O(1). Neighbouring free ranges are merged on free.
+  **/
+class TlsfAllocator
+{
+public:
+    static constexpr uint32_t INVALID_ALLOCATION = ~0u;
+
+    explicit TlsfAllocator(uint64_t capacity);
+
+    // returns INVALID_ALLOCATION if there is no free range big enough
+    uint32_t allocate(uint64_t size, uint64_t alignment);
+    void free(uint32_t allocation);
+
+    uint64_t offset(uint32_t allocation) const { return m_nodes[allocation].m_offset; }
+    uint64_t size(uint32_t allocation) const { return m_nodes[allocation].m_size; }
+
+    uint64_t capacity() const { return m_capacity; }
+    uint64_t used() const { return m_used; }
+    uint32_t allocations_count() const { return m_allocations_count; }
+    uint32_t free_ranges_count() const { return m_free_ranges_count; }
+    uint64_t largest_free_range() const;
+    bool empty() const { return m_allocations_count == 0; }
+
+private:
+    static constexpr uint32_t SL_BITS = 5;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64;
+
+    struct Node
+    {
+        uint64_t m_offset = 0;
+        uint64_t m_size = 0;
+        uint32_t m_prev_physical = INVALID_ALLOCATION;
+        uint32_t m_next_physical = INVALID_ALLOCATION;
+        uint32_t m_prev_free = INVALID_ALLOCATION;
+        uint32_t m_next_free = INVALID_ALLOCATION;
+        bool m_is_free = false;
+    };
+
+    static void mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl);
+    static void mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+    uint32_t find_suitable_node(uint32_t fl, uint32_t sl) const;
+    // slow path, when no class above the request has free ranges
+    uint32_t find_fitting_node(uint64_t size, uint64_t alignment, uint32_t search_fl, uint32_t search_sl) const;
+    void insert_free_node(uint32_t node);
+    void remove_free_node(uint32_t node);
+    uint32_t create_node(uint64_t offset, uint64_t size);
+    void release_node(uint32_t node);
+
+    vector<Node> m_nodes;
+    vector<uint32_t> m_unused_nodes;
+
+    uint64_t m_fl_bitmap = 0;
+    uint32_t m_sl_bitmaps[FL_COUNT] = {};
+    uint32_t m_free_lists[FL_COUNT][SL_COUNT];
+
+    uint64_t m_capacity;
+    uint64_t m_used = 0;
+    uint32_t m_allocations_count = 0;
+    uint32_t m_free_ranges_count = 0;
+};
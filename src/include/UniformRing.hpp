@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "DescriptorAllocator.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+using namespace std;
+
+/**
+  * Uniform data, which is written by CPU every frame. Allocations are taken from
+  * LinearArena at minUniformBufferOffsetAlignment and the region of the frame is
+  * rewound by begin_frame(), after fence of the frame slot.
+  *
+  * Every region has one static UNIFORM_BUFFER_DYNAMIC descriptor set (binding 0) with
+  * fixed range, so data is addressed with dynamic offsets and nothing is rewritten.
+  **/
+class UniformRing
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_FRAME_CAPACITY = 64 * 1024;
+
+    // range - the biggest allocation, which is visible to shaders through the set
+    void create(VkPhysicalDevice gpu, DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator,
+                uint32_t frames_count, VkShaderStageFlags stages, VkDeviceSize range,
+                VkDeviceSize frame_capacity = DEFAULT_FRAME_CAPACITY);
+    void destroy(DescriptorAllocator& descriptors, DeviceMemoryAllocator& allocator);
+
+    VkDescriptorSetLayout set_layout() const { return m_set_layout; }
+
+    // GPU is done with the previous use of the frame slot
+    void begin_frame(uint32_t frame_index);
+
+    // thread safe, returns dynamic offset of the data
+    uint32_t push(const void* data, VkDeviceSize size);
+    template<typename T>
+    uint32_t push(const T& data) { return push(&data, sizeof(T)); }
+
+    // set of the current frame, bound with offsets returned by push()
+    VkDescriptorSet descriptor_set() const { return m_descriptor_sets[m_arena.current_frame()]; }
+
+    // before submission of the frame, makes written data visible for non coherent memory
+    void end_frame(const DeviceMemoryAllocator& allocator) const;
+
+    void print_statistics(ostream& out) const;
+
+private:
+    LinearArena m_arena;
+    vector<VkDescriptorSet> m_descriptor_sets;
+    VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE; // owned by descriptor allocator
+    VkDeviceSize m_alignment = 1;
+    VkDeviceSize m_range = 0;
+    atomic<uint64_t> m_allocations_count{0};
+};
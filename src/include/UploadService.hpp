@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "DeviceMemoryAllocator.hpp"
+#include "StagingRing.hpp"
+
+using namespace std;
+
+/**
+  * Uploads executed on a dedicated transfer queue, so big copies overlap rendering
+  * instead of occupying the graphics queue. Copies are submitted in batches, every
+  * batch releases destination buffers from the transfer queue family and signals a
+  * semaphore. Graphics frame waits for the semaphores and acquires the buffers.
+  *
+  * Destination buffers should not be used by GPU, while their upload is in flight
+  * (new buffers or buffers, which are known to be idle).
+  **/
+class UploadService
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+    void create(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue transfer_queue,
+                uint32_t transfer_family, uint32_t graphics_family, VkDeviceSize capacity = DEFAULT_CAPACITY);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // copy is submitted by the next submit() or earlier, if staging buffer is full
+    void upload(VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size);
+
+    // submits pending copies to the transfer queue, never waits for GPU
+    void submit();
+
+    /**
+      * Submits pending copies and records acquire barriers of all submitted batches into
+      * graphics command buffer. Semaphores of the batches are appended to waits of the
+      * graphics submission, which should be passed to end_frame().
+      **/
+    void acquire(VkCommandBuffer command_buffer, vector<VkSemaphore>& wait_semaphores,
+                 vector<VkPipelineStageFlags>& wait_stages,
+                 VkPipelineStageFlags destination_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                 VkAccessFlags destination_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+
+    // graphics submission, which waited for semaphores given by acquire()
+    void end_frame(VkFence graphics_fence);
+
+    const StagingStatistics& statistics() const { return m_statistics; }
+    void print_statistics(ostream& out) const;
+
+private:
+    struct Region
+    {
+        VkBuffer m_destination;
+        VkBufferCopy m_copy;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer m_command_buffer = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;         // transfer submission
+        VkSemaphore m_semaphore = VK_NULL_HANDLE;
+        VkFence m_consumer = VK_NULL_HANDLE;      // graphics submission, which waited for the semaphore
+        vector<VkBuffer> m_buffers;               // released by the batch
+        uint64_t m_head = 0;                      // staging position freed by the batch
+        bool m_acquired = false;
+    };
+
+    VkDeviceSize reserve(VkDeviceSize size);
+    void retire_batches(bool wait);
+    Batch& free_batch();
+    bool is_signaled(VkFence fence) const;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    const DeviceMemoryAllocator* m_allocator = nullptr;
+    uint32_t m_transfer_family = 0;
+    uint32_t m_graphics_family = 0;
+    GpuBuffer m_buffer;
+    VkDeviceSize m_capacity = 0;
+    VkCommandPool m_command_pool = VK_NULL_HANDLE;
+
+    // ever growing positions, ring offset is position % capacity
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    uint64_t m_submitted_head = 0;
+    vector<Region> m_pending;
+
+    deque<unique_ptr<Batch>> m_in_flight; // submission order
+    vector<unique_ptr<Batch>> m_free_batches;
+    vector<Batch*> m_frame_batches;       // acquired by the frame, which is being recorded
+
+    StagingStatistics m_statistics;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <cstddef>
+
+using namespace std;
+
+// layout should match inputs of Triangle.vert
+struct Vertex
+{
+    glm::vec2 m_position;
+    glm::vec3 m_color;
+
+    static VkVertexInputBindingDescription binding_description()
+    {
+        VkVertexInputBindingDescription description = {};
+        description.binding = 0;
+        description.stride = sizeof(Vertex);
+        description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return description;
+    }
+
+    static array<VkVertexInputAttributeDescription, 2> attribute_descriptions()
+    {
+        array<VkVertexInputAttributeDescription, 2> descriptions = {};
+
+        descriptions[0].binding = 0;
+        descriptions[0].location = 0;
+        descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        descriptions[0].offset = offsetof(Vertex, m_position);
+
+        descriptions[1].binding = 0;
+        descriptions[1].location = 1;
+        descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        descriptions[1].offset = offsetof(Vertex, m_color);
+
+        return descriptions;
+    }
+};
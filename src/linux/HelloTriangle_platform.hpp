@@ -1,8 +1,6 @@
 #pragma once
 
 #include "HelloTriangleApplication.hpp"
-//PC at work has only integrated GPU inside Intel i7
-#define GPU_NAME "Intel(R) HD Graphics"
 
 void HelloTriangleApplication::create_KHR_surface()
 {
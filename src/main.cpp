@@ -1,7 +1,21 @@
 #include "Getting_started.hpp"
 #include "HelloTriangleApplication.hpp"
+#include <cstdlib>
+#include <iostream>
 
-int main() 
+int main(int argc, char** argv)
 {
-    return call_HelloTriangleApplication();
+    ApplicationSettings settings;
+    try
+    {
+        settings = parse_application_settings(argc, argv);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        print_application_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return call_HelloTriangleApplication(settings);
 }
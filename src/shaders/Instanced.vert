@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// per instance streams, see InstanceArrays.hpp
+layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in float instanceScale;
+layout(location = 4) in vec4 instanceColor;
+
+// per frame data of the uniform ring, bound with dynamic offset
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    float time;
+    float amplitude;
+} frame;
+
+// per draw data
+layout(push_constant) uniform DrawConstants {
+    float phase;
+} draw;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    float phase = frame.time + draw.phase + float(gl_InstanceIndex) * 0.37;
+    vec2 animation = frame.amplitude * vec2(sin(phase), cos(phase));
+    gl_Position = vec4(inPosition * instanceScale + instanceOffset + animation, 0.0, 1.0);
+    // point list pipeline variants need it, it is ignored by other topologies
+    gl_PointSize = 1.0;
+    fragColor = inColor * instanceColor.rgb;
+}
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// particle buffer written by Particles.comp is bound as vertex buffer
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inVelocity;
+
+layout(location = 0) out vec3 fragColor;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_PointSize;
+};
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    gl_PointSize = 1.0;
+
+    // slow particles are blue, fast ones are orange
+    float speed = clamp(length(inVelocity) * 1.5, 0.0, 1.0);
+    fragColor = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.6, 0.2), speed);
+}
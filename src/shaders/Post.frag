@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput sceneColor;
+
+layout(location = 0) in vec2 fragPosition;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 color = subpassLoad(sceneColor).rgb;
+    float vignette = 1.0 - 0.25 * dot(fragPosition, fragPosition);
+    outColor = vec4(color * clamp(vignette, 0.0, 1.0), 1.0);
+}
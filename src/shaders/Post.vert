@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) out vec2 fragPosition;
+
+// one triangle covers the viewport, vertices (-1,-1), (3,-1), (-1,3)
+void main() {
+    vec2 position = vec2(float((gl_VertexIndex << 1) & 2), float(gl_VertexIndex & 2)) * 2.0 - 1.0;
+    fragPosition = position;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
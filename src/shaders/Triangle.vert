@@ -1,21 +1,27 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// per frame data of the uniform ring, bound with dynamic offset
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    float time;
+    float amplitude;
+} frame;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// per draw data
+layout(push_constant) uniform DrawConstants {
+    float phase;
+} draw;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    float phase = frame.time + draw.phase + float(gl_InstanceIndex) * 0.37;
+    vec2 animation = frame.amplitude * vec2(sin(phase), cos(phase));
+    gl_Position = vec4(inPosition + animation, 0.0, 1.0);
+    // point list pipeline variants need it, it is ignored by other topologies
+    gl_PointSize = 1.0;
+    fragColor = inColor;
 }
@@ -0,0 +1,380 @@
+#include "DeviceMemoryAllocator.hpp"
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+  * DeviceMemoryAllocator and LinearArena on a real device. Lavapipe (Mesa CPU driver) is used,
+  * so the test runs without GPU; if it is not installed, the test is skipped.
+  * Exit code is the number of failed checks.
+  **/
+
+namespace
+{
+    // ctest SKIP_RETURN_CODE
+    constexpr int SKIPPED = 77;
+    constexpr VkDeviceSize BLOCK_SIZE = 1024 * 1024;
+
+    int g_failed_checks = 0;
+
+    void check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            cerr << "FAILED: " << description << endl;
+            ++g_failed_checks;
+        }
+    }
+
+    struct TestDevice
+    {
+        VkInstance m_instance = VK_NULL_HANDLE;
+        VkPhysicalDevice m_gpu = VK_NULL_HANDLE;
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkQueue m_queue = VK_NULL_HANDLE;
+        uint32_t m_queue_family = 0;
+        VkPhysicalDeviceLimits m_limits = {};
+    };
+
+    bool create_device(TestDevice& test_device)
+    {
+        VkApplicationInfo app_info = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
+        app_info.pApplicationName = "DeviceMemoryAllocatorTest";
+        app_info.apiVersion = VK_API_VERSION_1_0;
+
+        VkInstanceCreateInfo instance_info = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+        instance_info.pApplicationInfo = &app_info;
+        if (vkCreateInstance(&instance_info, nullptr, &test_device.m_instance) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        uint32_t gpus_count = 0;
+        vkEnumeratePhysicalDevices(test_device.m_instance, &gpus_count, nullptr);
+        vector<VkPhysicalDevice> gpus(gpus_count);
+        vkEnumeratePhysicalDevices(test_device.m_instance, &gpus_count, gpus.data());
+
+        for (auto gpu : gpus)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(gpu, &properties);
+            if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU || string(properties.deviceName).find("llvmpipe") != string::npos)
+            {
+                test_device.m_gpu = gpu;
+                test_device.m_limits = properties.limits;
+                break;
+            }
+        }
+        if (test_device.m_gpu == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        // graphics and compute queues support transfers too
+        uint32_t families_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(test_device.m_gpu, &families_count, nullptr);
+        vector<VkQueueFamilyProperties> families(families_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(test_device.m_gpu, &families_count, families.data());
+        for (uint32_t i = 0; i < families_count; ++i)
+        {
+            if (families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT))
+            {
+                test_device.m_queue_family = i;
+                break;
+            }
+        }
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queue_info = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        queue_info.queueFamilyIndex = test_device.m_queue_family;
+        queue_info.queueCount = 1;
+        queue_info.pQueuePriorities = &priority;
+
+        VkDeviceCreateInfo device_info = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+        device_info.queueCreateInfoCount = 1;
+        device_info.pQueueCreateInfos = &queue_info;
+        if (vkCreateDevice(test_device.m_gpu, &device_info, nullptr, &test_device.m_device) != VK_SUCCESS)
+        {
+            return false;
+        }
+        vkGetDeviceQueue(test_device.m_device, test_device.m_queue_family, 0, &test_device.m_queue);
+        return true;
+    }
+
+    void destroy_device(TestDevice& test_device)
+    {
+        if (test_device.m_device != VK_NULL_HANDLE)
+        {
+            vkDestroyDevice(test_device.m_device, nullptr);
+        }
+        if (test_device.m_instance != VK_NULL_HANDLE)
+        {
+            vkDestroyInstance(test_device.m_instance, nullptr);
+        }
+    }
+
+    bool overlap(const MemoryAllocation& first, const MemoryAllocation& second)
+    {
+        return first.m_memory == second.m_memory &&
+               first.m_offset < second.m_offset + second.m_size && second.m_offset < first.m_offset + first.m_size;
+    }
+
+    void test_allocate_free(const TestDevice& test_device)
+    {
+        DeviceMemoryAllocator allocator;
+        allocator.create(test_device.m_gpu, test_device.m_device, BLOCK_SIZE);
+
+        vector<GpuBuffer> buffers;
+        for (VkDeviceSize size : {256, 1000, 4096, 100, 65536})
+        {
+            buffers.push_back(allocator.create_buffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly));
+            check(buffers.back().m_memory.m_memory != VK_NULL_HANDLE, "buffer is bound to memory");
+        }
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            for (size_t j = i + 1; j < buffers.size(); ++j)
+            {
+                check(!overlap(buffers[i].m_memory, buffers[j].m_memory), "buffers do not overlap");
+            }
+        }
+
+        auto statistics = allocator.statistics();
+        check(statistics.m_blocks_count == 1, "small buffers share one block");
+        check(statistics.m_allocations_count == buffers.size(), "every buffer is counted as allocation");
+        check(statistics.m_allocated_bytes == BLOCK_SIZE, "block size is allocated from driver");
+        check(statistics.m_used_bytes >= 256 + 1000 + 4096 + 100 + 65536, "used bytes cover buffer sizes");
+
+        // freed range in the middle can not be merged with the free end of the block
+        allocator.destroy_buffer(buffers[2]);
+        check(buffers[2].m_buffer == VK_NULL_HANDLE, "destroyed buffer is reset");
+        check(allocator.statistics().m_free_ranges_count == 2, "freed range in the middle stays separate");
+        check(allocator.statistics().m_allocations_count == buffers.size() - 1, "freed allocation is not counted");
+
+        for (auto& buffer : buffers)
+        {
+            allocator.destroy_buffer(buffer);
+        }
+        statistics = allocator.statistics();
+        check(statistics.m_blocks_count == 1, "one empty shared block is kept");
+        check(statistics.m_allocations_count == 0 && statistics.m_used_bytes == 0, "nothing is used after free");
+        check(statistics.m_free_ranges_count == 1 && statistics.m_largest_free_range == BLOCK_SIZE,
+              "freed ranges are merged back");
+        check(statistics.fragmentation() == 0.0, "empty block is not fragmented");
+
+        allocator.destroy();
+    }
+
+    void test_dedicated_blocks(const TestDevice& test_device)
+    {
+        DeviceMemoryAllocator allocator;
+        allocator.create(test_device.m_gpu, test_device.m_device, BLOCK_SIZE);
+
+        auto small = allocator.create_buffer(1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
+        // more than half of the block gets own block
+        auto big = allocator.create_buffer(BLOCK_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
+        check(big.m_memory.m_memory != VK_NULL_HANDLE && big.m_memory.m_offset == 0, "dedicated block is bound at offset 0");
+        check(big.m_memory.m_memory != small.m_memory.m_memory, "dedicated block is not shared");
+
+        auto statistics = allocator.statistics();
+        check(statistics.m_blocks_count == 2, "dedicated block is counted");
+        check(statistics.m_allocations_count == 2, "dedicated block is one allocation");
+        check(statistics.m_used_bytes >= 1024 + BLOCK_SIZE, "dedicated block is used as a whole");
+
+        // small allocations never go into dedicated block
+        auto second_small = allocator.create_buffer(1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
+        check(second_small.m_memory.m_memory == small.m_memory.m_memory, "shared block is used for small buffer");
+
+        allocator.destroy_buffer(big);
+        statistics = allocator.statistics();
+        check(statistics.m_blocks_count == 1, "dedicated block is released by free");
+        check(statistics.m_allocations_count == 2, "shared allocations stay");
+
+        allocator.destroy_buffer(small);
+        allocator.destroy_buffer(second_small);
+        allocator.destroy();
+    }
+
+    void test_buffer_image_granularity(const TestDevice& test_device)
+    {
+        DeviceMemoryAllocator allocator;
+        allocator.create(test_device.m_gpu, test_device.m_device, BLOCK_SIZE);
+        const VkDeviceSize granularity = max<VkDeviceSize>(test_device.m_limits.bufferImageGranularity, 1);
+
+        auto before = allocator.create_buffer(100, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
+
+        VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image_info.extent = {64, 64, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image;
+        if (vkCreateImage(test_device.m_device, &image_info, nullptr, &image) != VK_SUCCESS)
+        {
+            check(false, "image is created");
+            allocator.destroy_buffer(before);
+            allocator.destroy();
+            return;
+        }
+        auto image_memory = allocator.allocate_for_image(image, MemoryUsage::GpuOnly);
+        auto after = allocator.create_buffer(100, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::GpuOnly);
+
+        // optimal image owns whole pages, linear resources in the same block stay on other pages
+        auto first_page = [granularity](const MemoryAllocation& allocation) { return allocation.m_offset / granularity; };
+        auto last_page = [granularity](const MemoryAllocation& allocation)
+        {
+            return (allocation.m_offset + allocation.m_size - 1) / granularity;
+        };
+        check(image_memory.m_offset % granularity == 0, "image starts at granularity page");
+        for (const auto* buffer : {&before, &after})
+        {
+            if (buffer->m_memory.m_memory == image_memory.m_memory)
+            {
+                check(last_page(buffer->m_memory) < first_page(image_memory) ||
+                      last_page(image_memory) < first_page(buffer->m_memory),
+                      "buffer does not share granularity page with image");
+            }
+        }
+
+        vkDestroyImage(test_device.m_device, image, nullptr);
+        allocator.free(image_memory);
+        check(image_memory.m_memory == VK_NULL_HANDLE, "freed allocation is reset");
+        allocator.destroy_buffer(before);
+        allocator.destroy_buffer(after);
+        allocator.destroy();
+    }
+
+    // CPU writes are flushed, GPU copies them into readback buffer, which is invalidated before CPU reads
+    void test_flush_invalidate(const TestDevice& test_device)
+    {
+        DeviceMemoryAllocator allocator;
+        allocator.create(test_device.m_gpu, test_device.m_device, BLOCK_SIZE);
+
+        const VkDeviceSize size = 4096;
+        auto upload = allocator.create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::CpuToGpu);
+        auto readback = allocator.create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuToCpu);
+        check(upload.m_memory.m_mapped != nullptr && readback.m_memory.m_mapped != nullptr, "host visible memory is mapped");
+
+        vector<uint32_t> data(size / sizeof(uint32_t));
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<uint32_t>(i * 2654435761u);
+        }
+        memcpy(upload.m_memory.m_mapped, data.data(), size);
+        allocator.flush(upload.m_memory);
+
+        VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        pool_info.queueFamilyIndex = test_device.m_queue_family;
+        VkCommandPool command_pool;
+        vkCreateCommandPool(test_device.m_device, &pool_info, nullptr, &command_pool);
+
+        VkCommandBufferAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocate_info.commandPool = command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        VkCommandBuffer command_buffer;
+        vkAllocateCommandBuffers(test_device.m_device, &allocate_info, &command_buffer);
+
+        VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+        VkBufferCopy region = {0, 0, size};
+        vkCmdCopyBuffer(command_buffer, upload.m_buffer, readback.m_buffer, 1, &region);
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(command_buffer);
+
+        VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkFence fence;
+        vkCreateFence(test_device.m_device, &fence_info, nullptr, &fence);
+
+        VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer;
+        check(vkQueueSubmit(test_device.m_queue, 1, &submit_info, fence) == VK_SUCCESS, "copy is submitted");
+        vkWaitForFences(test_device.m_device, 1, &fence, VK_TRUE, numeric_limits<uint64_t>::max());
+
+        allocator.invalidate(readback.m_memory);
+        check(memcmp(readback.m_memory.m_mapped, data.data(), size) == 0, "GPU sees flushed data, CPU sees GPU writes");
+
+        // partial ranges at unaligned offsets are widened to nonCoherentAtomSize
+        allocator.flush(upload.m_memory, 3, 5);
+        allocator.invalidate(readback.m_memory, size - 7, VK_WHOLE_SIZE);
+
+        vkDestroyFence(test_device.m_device, fence, nullptr);
+        vkDestroyCommandPool(test_device.m_device, command_pool, nullptr);
+        allocator.destroy_buffer(upload);
+        allocator.destroy_buffer(readback);
+        allocator.destroy();
+    }
+
+    void test_linear_arena(const TestDevice& test_device)
+    {
+        DeviceMemoryAllocator allocator;
+        allocator.create(test_device.m_gpu, test_device.m_device, BLOCK_SIZE);
+
+        LinearArena arena;
+        arena.create(allocator, 1000, 3, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 256);
+        check(arena.frame_capacity() == 1024, "frame capacity is aligned");
+        check(arena.buffer().m_size == 3 * 1024, "buffer holds region of every frame");
+
+        arena.begin_frame(1);
+        LinearArena::Allocation first;
+        LinearArena::Allocation second;
+        check(arena.allocate(10, first) && arena.allocate(300, second), "allocations fit into the region");
+        check(first.m_offset == arena.frame_offset(1), "first allocation starts the region of the frame");
+        check(second.m_offset == arena.frame_offset(1) + 256, "allocations are aligned");
+        check(static_cast<char*>(second.m_mapped) - static_cast<char*>(first.m_mapped) == 256, "mapped pointers follow offsets");
+
+        LinearArena::Allocation rest;
+        check(arena.allocate(256, rest), "remaining space is given away");
+        check(!arena.allocate(1, rest), "full region fails allocation");
+        check(arena.frame_used() == arena.frame_capacity(), "whole region is used");
+
+        arena.begin_frame(2);
+        check(arena.frame_used() == 0 && arena.allocate(1024, rest), "next frame starts empty");
+        check(rest.m_offset == arena.frame_offset(2), "next frame has own region");
+        arena.rewind();
+        check(arena.frame_used() == 0 && arena.peak_used() == 1024, "rewind keeps peak");
+        arena.flush(allocator);
+
+        arena.destroy(allocator);
+        check(allocator.statistics().m_used_bytes == 0, "arena buffer is freed");
+        allocator.destroy();
+    }
+}
+
+int main()
+{
+    TestDevice test_device;
+    if (!create_device(test_device))
+    {
+        cout << "DeviceMemoryAllocator: lavapipe device is not found, skipped" << endl;
+        destroy_device(test_device);
+        return SKIPPED;
+    }
+
+    test_allocate_free(test_device);
+    test_dedicated_blocks(test_device);
+    test_buffer_image_granularity(test_device);
+    test_flush_invalidate(test_device);
+    test_linear_arena(test_device);
+
+    destroy_device(test_device);
+    if (g_failed_checks == 0)
+    {
+        cout << "DeviceMemoryAllocator: all checks passed" << endl;
+    }
+    return g_failed_checks;
+}
@@ -0,0 +1,117 @@
+#include "TlsfAllocator.hpp"
+#include <iostream>
+#include <vector>
+
+/**
+  * TlsfAllocator does not need Vulkan, so it is tested on plain offsets.
+  * Exit code is the number of failed checks.
+  **/
+
+namespace
+{
+    int g_failed_checks = 0;
+
+    void check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            cerr << "FAILED: " << description << endl;
+            ++g_failed_checks;
+        }
+    }
+
+    void test_alignment()
+    {
+        TlsfAllocator allocator(4096);
+
+        // shifts the next allocation away from aligned offset
+        auto first = allocator.allocate(3, 1);
+        check(first != TlsfAllocator::INVALID_ALLOCATION, "unaligned allocation succeeds");
+
+        for (uint64_t alignment : {16, 256, 1024})
+        {
+            auto allocation = allocator.allocate(100, alignment);
+            check(allocation != TlsfAllocator::INVALID_ALLOCATION, "aligned allocation succeeds");
+            check(allocator.offset(allocation) % alignment == 0, "allocation offset is aligned");
+            check(allocator.size(allocation) == 100, "aligned allocation has requested size");
+        }
+
+        // padding in front of aligned allocations is free again
+        check(allocator.used() == 3 + 3 * 100, "padding is not counted as used");
+    }
+
+    void test_class_rounding()
+    {
+        // 595 and 600 are in the same size class, so ranges of the class may be smaller than the request
+        TlsfAllocator allocator(2048);
+        auto small = allocator.allocate(595, 1);
+        auto separator = allocator.allocate(1, 1);
+        check(small != TlsfAllocator::INVALID_ALLOCATION && separator != TlsfAllocator::INVALID_ALLOCATION,
+              "setup allocations succeed");
+        allocator.free(small);
+
+        auto allocation = allocator.allocate(600, 1);
+        check(allocation != TlsfAllocator::INVALID_ALLOCATION, "allocation from rounded up class succeeds");
+        check(allocator.offset(allocation) >= 596, "too small range of the same class is not used");
+        check(allocator.size(allocation) == 600, "allocation has requested size");
+
+        // every allocation fits into its range and ranges do not overlap
+        TlsfAllocator filled(1 << 20);
+        vector<uint32_t> allocations;
+        uint64_t end = 0;
+        for (uint64_t size = 1; size < 5000; size = size * 3 / 2 + 1)
+        {
+            auto next = filled.allocate(size, 1);
+            check(next != TlsfAllocator::INVALID_ALLOCATION, "allocation of growing size succeeds");
+            check(filled.offset(next) >= end, "allocations do not overlap");
+            end = filled.offset(next) + filled.size(next);
+            allocations.push_back(next);
+        }
+        for (auto next : allocations)
+        {
+            filled.free(next);
+        }
+        check(filled.empty() && filled.free_ranges_count() == 1, "freed ranges are merged back");
+        check(filled.largest_free_range() == filled.capacity(), "whole capacity is free again");
+    }
+
+    void test_exact_capacity_fit()
+    {
+        // capacities at and between class boundaries, alignment padding at offset 0 is not needed
+        for (uint64_t capacity : {1024ull, 1000ull, 64ull * 1024 * 1024 + 4096, 100ull * 1000 * 1000})
+        {
+            for (uint64_t alignment : {1ull, 256ull, 65536ull})
+            {
+                TlsfAllocator allocator(capacity);
+                auto allocation = allocator.allocate(capacity, alignment);
+                check(allocation != TlsfAllocator::INVALID_ALLOCATION, "allocation of whole capacity succeeds");
+                check(allocation != TlsfAllocator::INVALID_ALLOCATION && allocator.offset(allocation) == 0,
+                      "whole capacity allocation starts at 0");
+                check(allocator.allocate(1, 1) == TlsfAllocator::INVALID_ALLOCATION, "full allocator has no space");
+                check(allocator.allocate(capacity + 1, 1) == TlsfAllocator::INVALID_ALLOCATION,
+                      "allocation above capacity fails");
+            }
+        }
+
+        // last range of exactly the remaining size
+        TlsfAllocator allocator(1000);
+        auto first = allocator.allocate(333, 1);
+        auto rest = allocator.allocate(667, 1);
+        check(first != TlsfAllocator::INVALID_ALLOCATION && rest != TlsfAllocator::INVALID_ALLOCATION,
+              "remaining range is given away completely");
+        check(allocator.used() == allocator.capacity(), "allocator is full");
+    }
+}
+
+int main()
+{
+    test_alignment();
+    test_class_rounding();
+    test_exact_capacity_fit();
+
+    if (g_failed_checks == 0)
+    {
+        cout << "TlsfAllocator: all checks passed" << endl;
+    }
+    return g_failed_checks;
+}
@@ -0,0 +1,198 @@
+#include "MappedFile.hpp"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& path, AccessPattern pattern)
+{
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (pattern == AccessPattern::Sequential)
+    {
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    }
+    else if (pattern == AccessPattern::Random)
+    {
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    }
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw runtime_error("Failed to open file " + path + "!");
+    }
+    m_file = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        unmap();
+        throw runtime_error("Failed to get size of file " + path + "!");
+    }
+    m_size = static_cast<size_t>(file_size.QuadPart);
+
+    // empty file can't be mapped, it is just an empty view
+    if (m_size == 0)
+    {
+        return;
+    }
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr)
+    {
+        unmap();
+        throw runtime_error("Failed to map file " + path + "!");
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        unmap();
+        throw runtime_error("Failed to map file " + path + "!");
+    }
+}
+
+void MappedFile::advise(AccessPattern /*pattern*/, size_t /*offset*/, size_t /*length*/) const
+{
+    // Windows takes access hints only when file is opened
+}
+
+void MappedFile::unmap()
+{
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != nullptr)
+    {
+        CloseHandle(m_file);
+    }
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+}
+
+#else
+
+namespace
+{
+    int to_madvise(MappedFile::AccessPattern pattern)
+    {
+        switch (pattern)
+        {
+        case MappedFile::AccessPattern::Sequential:
+            return MADV_SEQUENTIAL;
+        case MappedFile::AccessPattern::Random:
+            return MADV_RANDOM;
+        case MappedFile::AccessPattern::WillNeed:
+            return MADV_WILLNEED;
+        default:
+            return MADV_NORMAL;
+        }
+    }
+}
+
+MappedFile::MappedFile(const string& path, AccessPattern pattern)
+{
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        throw runtime_error("Failed to open file " + path + "!");
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0)
+    {
+        close(file);
+        throw runtime_error("Failed to get size of file " + path + "!");
+    }
+    m_size = static_cast<size_t>(file_stat.st_size);
+
+    // empty file can't be mapped, it is just an empty view
+    if (m_size != 0)
+    {
+        void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(file);
+            m_size = 0;
+            throw runtime_error("Failed to map file " + path + "!");
+        }
+        m_data = static_cast<const char*>(mapping);
+    }
+
+    // mapping keeps its own reference to the file
+    close(file);
+
+    if (pattern != AccessPattern::Normal)
+    {
+        advise(pattern);
+    }
+}
+
+void MappedFile::advise(AccessPattern pattern, size_t offset, size_t length) const
+{
+    if (m_data == nullptr || offset >= m_size)
+    {
+        return;
+    }
+
+    // madvise wants page aligned address
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t aligned_offset = offset - offset % page_size;
+    size_t end = (length == 0 || length > m_size - offset) ? m_size : offset + length;
+
+    // hint is only an optimization, failure is not an error
+    madvise(const_cast<char*>(m_data) + aligned_offset, end - aligned_offset, to_madvise(pattern));
+}
+
+void MappedFile::unmap()
+{
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        swap(m_data, other.m_data);
+        swap(m_size, other.m_size);
+#ifdef _WIN32
+        swap(m_file, other.m_file);
+        swap(m_mapping, other.m_mapping);
+#endif
+    }
+    return *this;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/**
+  * Read-only memory mapped view of a whole file. Pages are brought in by the OS
+  * on first access, so consumers read file content in place without buffer
+  * allocation and copying. Mapping is page aligned, so it can be passed directly
+  * to APIs requiring aligned data (SPIR-V words, vertex data, ...).
+  **/
+class MappedFile
+{
+public:
+    // matches madvise hints, used by OS read-ahead
+    enum class AccessPattern
+    {
+        Normal,
+        Sequential,
+        Random,
+        WillNeed
+    };
+
+    MappedFile() = default;
+    explicit MappedFile(const string& path, AccessPattern pattern = AccessPattern::Sequential);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    template <typename T>
+    const T* as() const { return reinterpret_cast<const T*>(m_data); }
+
+    // hint for part of the file, length 0 - till the end of file
+    void advise(AccessPattern pattern, size_t offset = 0, size_t length = 0) const;
+
+private:
+    void unmap();
+
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
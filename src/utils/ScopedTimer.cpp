@@ -0,0 +1,125 @@
+#include "ScopedTimer.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include "utils.hpp"
+
+namespace
+{
+    // open scopes of the current thread, only depth is needed
+    thread_local uint32_t t_depth = 0;
+}
+
+TimingLog::TimingLog()
+    : m_origin(chrono::steady_clock::now())
+{
+}
+
+uint32_t TimingLog::begin(const string& name)
+{
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(m_mutex);
+    if (m_stopped)
+    {
+        return NOT_RECORDED;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(m_entries.size());
+    m_entries.push_back({name, t_depth++, thread_index(this_thread::get_id()),
+                         chrono::duration<double, milli>(now - m_origin).count(), -1.0});
+    return scope;
+}
+
+void TimingLog::end(uint32_t scope)
+{
+    if (scope == NOT_RECORDED)
+    {
+        return;
+    }
+
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(m_mutex);
+
+    auto& entry = m_entries[scope];
+    entry.m_duration_ms = chrono::duration<double, milli>(now - m_origin).count() - entry.m_start_ms;
+    --t_depth;
+}
+
+void TimingLog::stop()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_stopped = true;
+}
+
+uint32_t TimingLog::thread_index(thread::id id)
+{
+    auto found = find(m_threads.begin(), m_threads.end(), id);
+    if (found != m_threads.end())
+    {
+        return static_cast<uint32_t>(found - m_threads.begin());
+    }
+    m_threads.push_back(id);
+    return static_cast<uint32_t>(m_threads.size() - 1);
+}
+
+double TimingLog::total_ms() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_entries.empty())
+    {
+        return 0.0;
+    }
+
+    double begin = m_entries.front().m_start_ms;
+    double end = begin;
+    for (const auto& entry : m_entries)
+    {
+        end = max(end, entry.m_start_ms + max(entry.m_duration_ms, 0.0));
+    }
+    return end - begin;
+}
+
+void TimingLog::print_report(ostream& out, const string& title) const
+{
+    double total = total_ms();
+    lock_guard<mutex> lock(m_mutex);
+
+    out << fixed << setprecision(3) << title << ": " << total << " ms" << endl;
+    for (const auto& entry : m_entries)
+    {
+        string name = string(2 * (entry.m_depth + 1), ' ') + entry.m_name;
+        out << left << setw(48) << name << right << setw(10) << entry.m_duration_ms << " ms"
+            << setw(8) << setprecision(1) << (total > 0.0 ? 100.0 * entry.m_duration_ms / total : 0.0) << " %";
+        if (entry.m_thread != 0)
+        {
+            out << "  (thread " << entry.m_thread << ")";
+        }
+        out << setprecision(3) << endl;
+    }
+    out << defaultfloat;
+}
+
+void TimingLog::write_json(const string& path) const
+{
+    double total = total_ms();
+    lock_guard<mutex> lock(m_mutex);
+
+    ofstream file(path);
+    if (!file)
+    {
+        throw runtime_error("Failed to open timing report file " + path + "!");
+    }
+
+    file << fixed << setprecision(3) << "{" << endl
+         << "  \"total_ms\": " << total << "," << endl
+         << "  \"scopes\": [" << endl;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        const auto& entry = m_entries[i];
+        file << "    {\"name\": \"" << escape_json(entry.m_name) << "\", \"depth\": " << entry.m_depth
+             << ", \"thread\": " << entry.m_thread << ", \"start_ms\": " << entry.m_start_ms
+             << ", \"duration_ms\": " << entry.m_duration_ms << "}" << (i + 1 < m_entries.size() ? "," : "") << endl;
+    }
+    file << "  ]" << endl << "}" << endl;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+  * CPU time of named nested scopes, kept in begin order. Used to break down
+  * startup time. Thread safe, nesting depth is tracked per thread.
+  **/
+class TimingLog
+{
+public:
+    static constexpr uint32_t NOT_RECORDED = UINT32_MAX;
+
+    TimingLog();
+
+    // NOT_RECORDED after stop()
+    uint32_t begin(const string& name);
+    void end(uint32_t scope);
+
+    template <typename Function>
+    void measure(const string& name, Function&& function)
+    {
+        uint32_t scope = begin(name);
+        try
+        {
+            function();
+        }
+        catch (...)
+        {
+            end(scope);
+            throw;
+        }
+        end(scope);
+    }
+
+    // scopes begun later are not recorded, so the log does not grow after the reported period
+    void stop();
+
+    // from the first begin to the last end
+    double total_ms() const;
+
+    void print_report(ostream& out, const string& title) const;
+    void write_json(const string& path) const;
+
+private:
+    struct Entry
+    {
+        string m_name;
+        uint32_t m_depth;
+        uint32_t m_thread;     // in order of the first scope of the thread, 0 - the first thread
+        double m_start_ms;     // since log creation
+        double m_duration_ms;  // negative while scope is open
+    };
+
+    uint32_t thread_index(thread::id id);
+
+    chrono::steady_clock::time_point m_origin;
+    mutable mutex m_mutex;
+    vector<Entry> m_entries;
+    vector<thread::id> m_threads;
+    bool m_stopped = false;
+};
+
+class ScopedTimer
+{
+public:
+    ScopedTimer(TimingLog& log, const string& name)
+        : m_log(log)
+        , m_scope(log.begin(name))
+    {
+    }
+    ~ScopedTimer() { m_log.end(m_scope); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    TimingLog& m_log;
+    uint32_t m_scope;
+};
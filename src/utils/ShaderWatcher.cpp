@@ -0,0 +1,226 @@
+#include "ShaderWatcher.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace
+{
+    const char* const SHADER_EXTENSIONS[] = {".vert", ".frag", ".comp"};
+
+    // editors save a file in several writes or as a rename, events of this period form one batch
+    constexpr int SETTLE_TIME_MS = 50;
+    constexpr int POLL_TIMEOUT_MS = 100;
+
+    bool is_shader_source(const string& file_name)
+    {
+        auto extension = filesystem::path(file_name).extension().string();
+        return find(begin(SHADER_EXTENSIONS), end(SHADER_EXTENSIONS), extension) != end(SHADER_EXTENSIONS);
+    }
+
+    // same naming as embedded shaders: Triangle.frag -> Triangle_frag
+    string module_name_of(const string& file_name)
+    {
+        string name = file_name;
+        replace(name.begin(), name.end(), '.', '_');
+        return name;
+    }
+
+#ifdef __linux__
+    // arguments are passed to the program as they are, no shell parses file names
+    bool run_process(vector<string> arguments)
+    {
+        vector<char*> argv;
+        for (auto& argument : arguments)
+        {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+
+        pid_t process;
+        if (posix_spawnp(&process, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        {
+            return false;
+        }
+
+        int status = 0;
+        while (waitpid(process, &status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                return false;
+            }
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    stop();
+}
+
+#ifdef __linux__
+
+void ShaderWatcher::start(const string& source_directory, const string& output_directory, const string& compiler)
+{
+    m_source_directory = source_directory;
+    m_output_directory = output_directory;
+    m_compiler = compiler;
+    filesystem::create_directories(m_output_directory);
+
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+    {
+        throw runtime_error("Failed to initialize inotify!");
+    }
+    // editors either rewrite the file or replace it with a renamed temporary one
+    if (inotify_add_watch(m_inotify, m_source_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(m_inotify);
+        m_inotify = -1;
+        throw runtime_error("Failed to watch shader directory " + m_source_directory + "!");
+    }
+
+    m_stopping = false;
+    m_thread = thread(&ShaderWatcher::watch_loop, this);
+}
+
+void ShaderWatcher::stop()
+{
+    if (m_thread.joinable())
+    {
+        m_stopping = true;
+        m_thread.join();
+    }
+    if (m_inotify >= 0)
+    {
+        close(m_inotify);
+        m_inotify = -1;
+    }
+}
+
+void ShaderWatcher::watch_loop()
+{
+    alignas(inotify_event) char buffer[4096];
+    vector<string> changed;
+    while (!m_stopping)
+    {
+        pollfd descriptor = {m_inotify, POLLIN, 0};
+        if (poll(&descriptor, 1, changed.empty() ? POLL_TIMEOUT_MS : SETTLE_TIME_MS) <= 0)
+        {
+            // quiet period after the last event, batch is complete
+            for (const auto& file_name : changed)
+            {
+                auto module_name = module_name_of(file_name);
+                if (compile(file_name, module_name))
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    if (find(m_compiled.begin(), m_compiled.end(), module_name) == m_compiled.end())
+                    {
+                        m_compiled.push_back(module_name);
+                    }
+                }
+            }
+            changed.clear();
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* position = buffer; position < buffer + length;)
+            {
+                auto event = reinterpret_cast<const inotify_event*>(position);
+                if (event->len > 0)
+                {
+                    string file_name = event->name;
+                    if (is_shader_source(file_name) && find(changed.begin(), changed.end(), file_name) == changed.end())
+                    {
+                        changed.push_back(file_name);
+                    }
+                }
+                position += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+}
+
+bool ShaderWatcher::compile(const string& file_name, const string& module_name)
+{
+    auto source = filesystem::path(m_source_directory) / file_name;
+    auto output = filesystem::path(m_output_directory) / (module_name + ".spv");
+    // readers never see a partially written file, rename replaces it at once
+    auto temporary = filesystem::path(m_output_directory) / (module_name + ".spv.tmp");
+
+    auto compile_start = chrono::steady_clock::now();
+    if (!run_process({m_compiler, "-V", source.string(), "-o", temporary.string()}))
+    {
+        ++m_failed_count;
+        error_code error;
+        filesystem::remove(temporary, error);
+        cerr << "Shader " << file_name << " failed to compile, previous version is kept" << endl;
+        return false;
+    }
+
+    // throwing overload would terminate the watcher thread
+    error_code rename_error;
+    filesystem::rename(temporary, output, rename_error);
+    if (rename_error)
+    {
+        ++m_failed_count;
+        error_code error;
+        filesystem::remove(temporary, error);
+        cerr << "Shader " << file_name << " can not replace " << output.string() << " (" << rename_error.message()
+             << "), previous version is kept" << endl;
+        return false;
+    }
+    ++m_compiled_count;
+
+    auto compile_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - compile_start).count();
+    cout << "Shader " << file_name << " recompiled in " << compile_ms << " ms" << endl;
+    return true;
+}
+
+#else
+
+void ShaderWatcher::start(const string&, const string&, const string&)
+{
+    throw runtime_error("Shader hot reload needs inotify, it is supported only on Linux!");
+}
+
+void ShaderWatcher::stop()
+{
+}
+
+void ShaderWatcher::watch_loop()
+{
+}
+
+bool ShaderWatcher::compile(const string&, const string&)
+{
+    return false;
+}
+
+#endif
+
+vector<string> ShaderWatcher::take_compiled()
+{
+    lock_guard<mutex> lock(m_mutex);
+    vector<string> compiled;
+    compiled.swap(m_compiled);
+    return compiled;
+}
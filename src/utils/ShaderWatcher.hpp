@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Watches a directory with GLSL sources (inotify) and compiles changed .vert, .frag
+  * and .comp files to <output>/<name>_<stage>.spv on its own thread, so compiler
+  * never runs on the render thread. Shader which does not compile is reported and
+  * keeps its previous SPIR-V. Linux only, start() throws on other platforms.
+  **/
+class ShaderWatcher
+{
+public:
+    ShaderWatcher() = default;
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // compiler - glslangValidator executable
+    void start(const string& source_directory, const string& output_directory, const string& compiler);
+    void stop();
+
+    // module names ("Triangle_frag") compiled since the previous call
+    vector<string> take_compiled();
+
+    uint32_t compiled_count() const { return m_compiled_count; }
+    uint32_t failed_count() const { return m_failed_count; }
+
+private:
+    void watch_loop();
+    // false if compiler reported errors
+    bool compile(const string& file_name, const string& module_name);
+
+    string m_source_directory;
+    string m_output_directory;
+    string m_compiler;
+    int m_inotify = -1;
+    atomic<bool> m_stopping{false};
+    thread m_thread;
+
+    mutex m_mutex;
+    vector<string> m_compiled;
+    atomic<uint32_t> m_compiled_count{0};
+    atomic<uint32_t> m_failed_count{0};
+};
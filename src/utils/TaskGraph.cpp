@@ -0,0 +1,170 @@
+#include "TaskGraph.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+// state of one run(), shared with pool tasks, so they never touch run() locals
+struct TaskGraph::Execution
+{
+    const vector<Task>& m_tasks;
+    ThreadPool* m_pool;
+    TimingLog* m_timings;
+
+    vector<uint32_t> m_waiting_for; // unfinished dependencies of every task
+    deque<TaskId> m_main_thread_ready;
+    size_t m_finished = 0;
+    exception_ptr m_error;
+    mutex m_mutex;
+    condition_variable m_changed;
+
+    Execution(const vector<Task>& tasks, ThreadPool* pool, TimingLog* timings)
+        : m_tasks(tasks)
+        , m_pool(pool)
+        , m_timings(timings)
+    {
+        for (const auto& task : m_tasks)
+        {
+            m_waiting_for.push_back(task.m_dependencies_count);
+        }
+    }
+
+    // main thread tasks are queued, others are collected to be started on the pool. Called under the lock
+    void schedule(TaskId id, vector<TaskId>& pool_tasks)
+    {
+        if (m_pool == nullptr || m_tasks[id].m_main_thread)
+        {
+            m_main_thread_ready.push_back(id);
+            m_changed.notify_all();
+        }
+        else
+        {
+            pool_tasks.push_back(id);
+        }
+    }
+
+    static void start_on_pool(const shared_ptr<Execution>& execution, const vector<TaskId>& pool_tasks)
+    {
+        for (TaskId id : pool_tasks)
+        {
+            execution->m_pool->submit([execution, id]() { execute(execution, id); });
+        }
+    }
+
+    static void execute(const shared_ptr<Execution>& execution, TaskId id)
+    {
+        const auto& task = execution->m_tasks[id];
+        bool skip;
+        {
+            lock_guard<mutex> lock(execution->m_mutex);
+            skip = execution->m_error != nullptr;
+        }
+
+        exception_ptr error;
+        if (!skip)
+        {
+            try
+            {
+                if (execution->m_timings != nullptr)
+                {
+                    execution->m_timings->measure(task.m_name, task.m_function);
+                }
+                else
+                {
+                    task.m_function();
+                }
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+        }
+
+        vector<TaskId> pool_tasks;
+        {
+            lock_guard<mutex> lock(execution->m_mutex);
+            if (error && !execution->m_error)
+            {
+                execution->m_error = error;
+            }
+            for (TaskId dependent : task.m_dependents)
+            {
+                if (--execution->m_waiting_for[dependent] == 0)
+                {
+                    execution->schedule(dependent, pool_tasks);
+                }
+            }
+            ++execution->m_finished;
+            execution->m_changed.notify_all();
+        }
+        // not empty only if some tasks are unfinished, so the graph is still alive
+        start_on_pool(execution, pool_tasks);
+    }
+};
+
+TaskGraph::TaskId TaskGraph::add(const string& name, function<void()> function, const vector<TaskId>& dependencies)
+{
+    return add_task(name, move(function), dependencies, false);
+}
+
+TaskGraph::TaskId TaskGraph::add_main_thread(const string& name, function<void()> function, const vector<TaskId>& dependencies)
+{
+    return add_task(name, move(function), dependencies, true);
+}
+
+TaskGraph::TaskId TaskGraph::add_task(const string& name, function<void()> function,
+                                      const vector<TaskId>& dependencies, bool main_thread)
+{
+    TaskId id = static_cast<TaskId>(m_tasks.size());
+    for (TaskId dependency : dependencies)
+    {
+        if (dependency >= id)
+        {
+            throw runtime_error("Task " + name + " depends on a task, which is not added yet!");
+        }
+        m_tasks[dependency].m_dependents.push_back(id);
+    }
+    m_tasks.push_back({name, move(function), main_thread, static_cast<uint32_t>(dependencies.size()), {}});
+    return id;
+}
+
+void TaskGraph::run(ThreadPool* pool, TimingLog* timings)
+{
+    auto execution = make_shared<Execution>(m_tasks, pool, timings);
+
+    vector<TaskId> pool_tasks;
+    {
+        lock_guard<mutex> lock(execution->m_mutex);
+        for (TaskId id = 0; id < m_tasks.size(); ++id)
+        {
+            if (m_tasks[id].m_dependencies_count == 0)
+            {
+                execution->schedule(id, pool_tasks);
+            }
+        }
+    }
+    Execution::start_on_pool(execution, pool_tasks);
+
+    unique_lock<mutex> lock(execution->m_mutex);
+    while (execution->m_finished < m_tasks.size())
+    {
+        if (execution->m_main_thread_ready.empty())
+        {
+            execution->m_changed.wait(lock);
+            continue;
+        }
+        TaskId id = execution->m_main_thread_ready.front();
+        execution->m_main_thread_ready.pop_front();
+
+        lock.unlock();
+        Execution::execute(execution, id);
+        lock.lock();
+    }
+
+    if (execution->m_error)
+    {
+        rethrow_exception(execution->m_error);
+    }
+}
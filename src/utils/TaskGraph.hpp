@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ScopedTimer.hpp"
+#include "ThreadPool.hpp"
+
+using namespace std;
+
+/**
+  * Tasks with explicit dependencies, executed once by run(). Task is started
+  * on thread pool as soon as all its dependencies are done, tasks bound to
+  * the main thread (window system calls) are executed by the thread, which
+  * calls run(). Dependencies should be added before the task, so the graph
+  * can not have cycles.
+  **/
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+
+    TaskId add(const string& name, function<void()> function, const vector<TaskId>& dependencies = {});
+    TaskId add_main_thread(const string& name, function<void()> function, const vector<TaskId>& dependencies = {});
+
+    /**
+      * Returns when all tasks are done. After the first exception tasks, which are not
+      * started yet, are skipped, and the exception is rethrown when running ones finish.
+      * Without pool all tasks are executed serially by the calling thread.
+      **/
+    void run(ThreadPool* pool, TimingLog* timings = nullptr);
+
+private:
+    struct Task
+    {
+        string m_name;
+        function<void()> m_function;
+        bool m_main_thread;
+        uint32_t m_dependencies_count;
+        vector<TaskId> m_dependents;
+    };
+
+    struct Execution;
+
+    TaskId add_task(const string& name, function<void()> function, const vector<TaskId>& dependencies, bool main_thread);
+
+    vector<Task> m_tasks;
+};
@@ -0,0 +1,124 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(uint32_t threads_count)
+{
+    if (threads_count == 0)
+    {
+        threads_count = hardware_threads();
+    }
+
+    m_workers.reserve(threads_count);
+    for (uint32_t i = 0; i < threads_count; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(uint32_t count, const function<void(uint32_t)>& task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    struct SharedState
+    {
+        atomic<uint32_t> m_next_index{0};
+        uint32_t m_finished = 0;
+        exception_ptr m_error;
+        mutex m_mutex;
+        condition_variable m_done;
+    };
+    auto state = make_shared<SharedState>();
+
+    // indices are taken dynamically, so fast threads take more of them
+    auto run = [state, count, &task]()
+    {
+        for (uint32_t index = state->m_next_index++; index < count; index = state->m_next_index++)
+        {
+            exception_ptr error;
+            try
+            {
+                task(index);
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+
+            lock_guard<mutex> lock(state->m_mutex);
+            if (error && !state->m_error)
+            {
+                state->m_error = error;
+            }
+            if (++state->m_finished == count)
+            {
+                state->m_done.notify_one();
+            }
+        }
+    };
+
+    uint32_t helpers = min(count - 1, threads_count());
+    for (uint32_t i = 0; i < helpers; ++i)
+    {
+        enqueue(run);
+    }
+    run();
+
+    unique_lock<mutex> lock(state->m_mutex);
+    state->m_done.wait(lock, [&state, count]() { return state->m_finished == count; });
+    if (state->m_error)
+    {
+        rethrow_exception(state->m_error);
+    }
+}
+
+uint32_t ThreadPool::hardware_threads()
+{
+    return max(thread::hardware_concurrency(), 1u);
+}
+
+void ThreadPool::enqueue(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_tasks.push_back(move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+            task = move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Fixed set of worker threads, which execute submitted tasks in FIFO order.
+  * Workers are joined by destructor after all queued tasks are done.
+  **/
+class ThreadPool
+{
+public:
+    // 0 - one worker per hardware thread
+    explicit ThreadPool(uint32_t threads_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t threads_count() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    template <typename Function>
+    auto submit(Function&& function) -> future<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto task = make_shared<packaged_task<Result()>>(forward<Function>(function));
+        auto result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    /**
+      * Calls task(0) ... task(count - 1) and returns when all of them are done.
+      * Calling thread executes tasks too, so it never just sleeps. Every index is
+      * executed by one thread, so task may use resources owned by the index
+      * (command pools etc.) without locking. First exception is rethrown.
+      **/
+    void parallel_for(uint32_t count, const function<void(uint32_t)>& task);
+
+    static uint32_t hardware_threads();
+
+private:
+    void enqueue(function<void()> task);
+    void worker_loop();
+
+    vector<thread> m_workers;
+    deque<function<void()>> m_tasks;
+    mutex m_mutex;
+    condition_variable m_condition;
+    bool m_stopping = false;
+};
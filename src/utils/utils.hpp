@@ -1,11 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdio>
 #include <vector>
 #include <fstream>
+#include <stdexcept>
+#include <string>
 
 using namespace std;
 
-vector<char> read_file(const string& file_name)
+/**
+  * Copies whole file into heap buffer. For large assets prefer MappedFile,
+  * which gives the same content without allocation and copy.
+  **/
+inline vector<char> read_file(const string& file_name)
 {
     ifstream file(file_name, ios::ate | ios::binary);
 
@@ -22,3 +30,34 @@ vector<char> read_file(const string& file_name)
     file.close();
     return file_buffer;
 }
+
+// value, which is written between quotes of a JSON string
+inline string escape_json(const string& value)
+{
+    string escaped;
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char control[8];
+            snprintf(control, sizeof(control), "\\u%04x", static_cast<unsigned>(c));
+            escaped += control;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// mixes value into seed, for hashes of structures
+inline void hash_combine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
@@ -1,8 +1,6 @@
 #pragma once
 
 #include "HelloTriangleApplication.hpp"
-//my laptor has 2 GPUs. I will use the discrete one
-#define GPU_NAME "GeForce"
 
 void HelloTriangleApplication::create_KHR_surface()
 {